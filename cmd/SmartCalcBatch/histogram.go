@@ -0,0 +1,69 @@
+package main
+
+import (
+	"math/bits"
+	"time"
+)
+
+// Latencies are kept in log-linear buckets, 16 per power of two, so the
+// memory used does not grow with the number of expressions and every
+// quantile is within 1/16 of the real value.
+const (
+	histSubBits = 4
+	histBuckets = (64 - histSubBits + 1) << histSubBits
+)
+
+type histogram struct {
+	buckets [histBuckets]uint64
+	count   uint64
+	max     time.Duration
+}
+
+func bucketOf(v uint64) int {
+	if v < 1<<histSubBits {
+		return int(v)
+	}
+	shift := bits.Len64(v) - histSubBits - 1
+	return (shift+1)<<histSubBits + int(v>>shift) - 1<<histSubBits
+}
+
+func bucketStart(b int) uint64 {
+	if b < 1<<histSubBits {
+		return uint64(b)
+	}
+	shift := b>>histSubBits - 1
+	return uint64(b&(1<<histSubBits-1)+1<<histSubBits) << shift
+}
+
+func (h *histogram) record(d time.Duration) {
+	if d < 0 {
+		d = 0
+	}
+	h.buckets[bucketOf(uint64(d))]++
+	h.count++
+	if d > h.max {
+		h.max = d
+	}
+}
+
+func (h *histogram) merge(other *histogram) {
+	for i, n := range other.buckets {
+		h.buckets[i] += n
+	}
+	h.count += other.count
+	if other.max > h.max {
+		h.max = other.max
+	}
+}
+
+func (h *histogram) quantile(q float64) time.Duration {
+	rank := uint64(q * float64(h.count))
+	var seen uint64
+	for b, n := range h.buckets {
+		seen += n
+		if seen > rank {
+			return time.Duration(bucketStart(b))
+		}
+	}
+	return h.max
+}
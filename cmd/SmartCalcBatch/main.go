@@ -0,0 +1,328 @@
+// SmartCalcBatch evaluates newline-delimited expressions from stdin or a
+// file. A line is either an expression or an expression and an x value
+// separated by a tab. Results are written to stdout in input order, one
+// per line, and a summary is written to stderr. With -stats the counters
+// of the library follow the summary, in the Prometheus text format.
+package main
+
+import (
+	"bufio"
+	"bytes"
+	"flag"
+	"fmt"
+	"io"
+	"os"
+	"runtime"
+	"strconv"
+	"sync"
+	"time"
+
+	"github.com/pancakeswya/GoSmartCalc/internal/calc/basic"
+	"github.com/pancakeswya/GoSmartCalc/internal/calc/stats"
+	"github.com/pancakeswya/GoSmartCalc/pkg/dll"
+)
+
+const (
+	chunkSize     = 512
+	maxLineSize   = 16 << 20
+	chunksPerWork = 4
+)
+
+type job struct {
+	expr string
+	x    float64
+	hasX bool
+	badX bool
+}
+
+type result struct {
+	val float64
+	err error
+}
+
+// chunk is the unit passed between the stages, seq restores input order.
+type chunk struct {
+	seq     int
+	jobs    []job
+	results []result
+}
+
+type lineReader interface {
+	next() ([]byte, bool)
+	err() error
+}
+
+// trimCR drops the \r of a CRLF line ending, so both readers give the
+// same lines for the same input.
+func trimCR(line []byte) []byte {
+	return bytes.TrimSuffix(line, []byte{'\r'})
+}
+
+type scanReader struct {
+	scanner *bufio.Scanner
+}
+
+func (r *scanReader) next() ([]byte, bool) {
+	if !r.scanner.Scan() {
+		return nil, false
+	}
+	return trimCR(r.scanner.Bytes()), true
+}
+
+func (r *scanReader) err() error {
+	return r.scanner.Err()
+}
+
+type mappedReader struct {
+	data []byte
+}
+
+func (r *mappedReader) next() ([]byte, bool) {
+	if len(r.data) == 0 {
+		return nil, false
+	}
+	line := r.data
+	if i := bytes.IndexByte(r.data, '\n'); i >= 0 {
+		line, r.data = r.data[:i], r.data[i+1:]
+	} else {
+		r.data = nil
+	}
+	return trimCR(line), true
+}
+
+func (r *mappedReader) err() error {
+	return nil
+}
+
+func parseJob(line []byte) job {
+	expr, xStr, hasX := bytes.Cut(line, []byte{'\t'})
+	j := job{expr: string(expr), hasX: hasX}
+	if hasX {
+		x, err := strconv.ParseFloat(string(bytes.TrimSpace(xStr)), 64)
+		j.x, j.badX = x, err != nil
+	}
+	return j
+}
+
+func read(r lineReader, jobs chan<- *chunk, window chan struct{}) error {
+	defer close(jobs)
+	seq := 0
+	for {
+		c := &chunk{seq: seq, jobs: make([]job, 0, chunkSize)}
+		for len(c.jobs) < chunkSize {
+			line, ok := r.next()
+			if !ok {
+				break
+			}
+			c.jobs = append(c.jobs, parseJob(line))
+		}
+		if len(c.jobs) == 0 {
+			return r.err()
+		}
+		// Blocks while the writer is window chunks behind, so memory
+		// stays bounded however far ahead the reader could get.
+		window <- struct{}{}
+		jobs <- c
+		seq++
+	}
+}
+
+func work(bc *basiccalc.Calc, jobs <-chan *chunk, done chan<- *chunk, hist *histogram) {
+	for c := range jobs {
+		c.results = make([]result, len(c.jobs))
+		for i, j := range c.jobs {
+			if j.expr == "" {
+				continue
+			}
+			start := time.Now()
+			var res result
+			switch {
+			case j.badX:
+				res.err = basiccalc.ErrInvalidEquation
+			case j.hasX:
+				res.val, res.err = bc.CalculateEquation(j.expr, j.x)
+			default:
+				res.val, res.err = bc.CalculateExpr(j.expr)
+			}
+			hist.record(time.Since(start))
+			c.results[i] = res
+		}
+		done <- c
+	}
+}
+
+type summary struct {
+	lines  int
+	errors map[int]int
+	names  map[int]string
+}
+
+func write(w *bufio.Writer, done <-chan *chunk, window <-chan struct{}, sum *summary) error {
+	pending := make(map[int]*chunk)
+	next := 0
+	buf := make([]byte, 0, 64)
+	// After a failed write the rest is still drained, so the
+	// reader and the workers never block on a dead writer.
+	var writeErr error
+	for c := range done {
+		pending[c.seq] = c
+		for c, ok := pending[next]; ok; c, ok = pending[next] {
+			for i, res := range c.results {
+				buf = buf[:0]
+				switch {
+				case c.jobs[i].expr == "":
+				case res.err != nil:
+					code := basiccalc.ErrorCode(res.err)
+					sum.errors[code]++
+					sum.names[code] = res.err.Error()
+					buf = append(buf, "error: "...)
+					buf = append(buf, res.err.Error()...)
+				default:
+					buf = strconv.AppendFloat(buf, res.val, 'g', -1, 64)
+				}
+				buf = append(buf, '\n')
+				if writeErr == nil {
+					_, writeErr = w.Write(buf)
+				}
+			}
+			sum.lines += len(c.results)
+			delete(pending, next)
+			<-window
+			next++
+		}
+	}
+	if writeErr != nil {
+		return writeErr
+	}
+	return w.Flush()
+}
+
+func openInput(path string) (lineReader, func(), error) {
+	if path == "" || path == "-" {
+		scanner := bufio.NewScanner(os.Stdin)
+		scanner.Buffer(make([]byte, 64<<10), maxLineSize)
+		return &scanReader{scanner: scanner}, func() {}, nil
+	}
+	f, err := os.Open(path)
+	if err != nil {
+		return nil, nil, err
+	}
+	data, unmap, err := mapFile(f)
+	if err != nil {
+		f.Close()
+		return nil, nil, err
+	}
+	return &mappedReader{data: data}, func() {
+		unmap()
+		f.Close()
+	}, nil
+}
+
+func printSummary(out io.Writer, sum *summary, hist *histogram, elapsed time.Duration) {
+	fmt.Fprintf(out, "lines: %d\n", sum.lines)
+	fmt.Fprintf(out, "evaluated: %d\n", hist.count)
+	fmt.Fprintf(out, "elapsed: %v\n", elapsed)
+	fmt.Fprintf(out, "throughput: %.0f expr/s\n", float64(hist.count)/elapsed.Seconds())
+	for code := 0; code < 64; code++ {
+		if n, ok := sum.errors[code]; ok {
+			fmt.Fprintf(out, "error %d (%s): %d\n", code, sum.names[code], n)
+		}
+	}
+	if n, ok := sum.errors[-1]; ok {
+		fmt.Fprintf(out, "error other: %d\n", n)
+	}
+	if hist.count == 0 {
+		return
+	}
+	for _, q := range []float64{0.5, 0.9, 0.99, 0.999} {
+		fmt.Fprintf(out, "latency p%g: %v\n", q*100, hist.quantile(q))
+	}
+	fmt.Fprintf(out, "latency max: %v\n", hist.max)
+}
+
+func main() {
+	os.Exit(run())
+}
+
+// run returns the exit code, so the deferred closes run before main exits.
+func run() int {
+	libPath := flag.String("lib", "internal/calc/cc/build/libcalc.so", "path to the calc library")
+	inPath := flag.String("in", "", "input file, memory-mapped, stdin when empty")
+	workers := flag.Int("workers", runtime.NumCPU(), "number of evaluating goroutines")
+	withStats := flag.Bool("stats", false, "count inside the library and print the counters")
+	flag.Parse()
+	if *workers < 1 {
+		*workers = 1
+	}
+
+	dl, err := dll.New(*libPath)
+	if err != nil {
+		fmt.Fprintln(os.Stderr, err)
+		return 1
+	}
+	if err := dl.Open(); err != nil {
+		fmt.Fprintln(os.Stderr, err)
+		return 1
+	}
+	defer dl.Close()
+	bc, err := basiccalc.New(dl)
+	if err != nil {
+		fmt.Fprintln(os.Stderr, err)
+		return 1
+	}
+	var cs *calcstats.Stats
+	if *withStats {
+		if cs, err = calcstats.New(dl); err != nil {
+			fmt.Fprintln(os.Stderr, err)
+			return 1
+		}
+		cs.Enable(true)
+	}
+	r, closeInput, err := openInput(*inPath)
+	if err != nil {
+		fmt.Fprintln(os.Stderr, err)
+		return 1
+	}
+	defer closeInput()
+
+	start := time.Now()
+	jobs := make(chan *chunk, *workers)
+	done := make(chan *chunk, *workers)
+	window := make(chan struct{}, *workers*chunksPerWork)
+	hists := make([]histogram, *workers)
+	var wg sync.WaitGroup
+	for i := 0; i < *workers; i++ {
+		wg.Add(1)
+		go func(hist *histogram) {
+			defer wg.Done()
+			work(bc, jobs, done, hist)
+		}(&hists[i])
+	}
+	readErr := make(chan error, 1)
+	go func() {
+		readErr <- read(r, jobs, window)
+	}()
+	go func() {
+		wg.Wait()
+		close(done)
+	}()
+	sum := &summary{errors: make(map[int]int), names: make(map[int]string)}
+	writeErr := write(bufio.NewWriterSize(os.Stdout, 1<<20), done, window, sum)
+	elapsed := time.Since(start)
+
+	var hist histogram
+	for i := range hists {
+		hist.merge(&hists[i])
+	}
+	printSummary(os.Stderr, sum, &hist, elapsed)
+	if cs != nil {
+		cs.Snapshot().WritePrometheus(os.Stderr, "smartcalc")
+	}
+	for _, err := range []error{<-readErr, writeErr} {
+		if err != nil {
+			fmt.Fprintln(os.Stderr, err)
+			return 1
+		}
+	}
+	return 0
+}
@@ -0,0 +1,17 @@
+//go:build !unix
+
+package main
+
+import (
+	"io"
+	"os"
+)
+
+// Without mmap the file is read whole.
+func mapFile(f *os.File) ([]byte, func(), error) {
+	data, err := io.ReadAll(f)
+	if err != nil {
+		return nil, nil, err
+	}
+	return data, func() {}, nil
+}
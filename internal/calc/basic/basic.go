@@ -3,8 +3,28 @@ package basiccalc
 /*
   #include "../cc/basic_calc.h"
 
+  #include <stdlib.h>
+
   typedef typeof(&BasicCalculateExpr) BasicCalcExprFnPtr;
   typedef typeof(&BasicCalculateEquation) BasicCalcEquationFnPtr;
+  typedef typeof(&BasicCalculateBatch) BasicCalcBatchFnPtr;
+  typedef typeof(&BasicSetBatchThreads) BasicSetBatchThreadsFnPtr;
+  typedef typeof(&BasicCompileExpr) BasicCompileExprFnPtr;
+  typedef typeof(&BasicProgramEval) BasicProgramEvalFnPtr;
+  typedef typeof(&BasicCompileVars) BasicCompileVarsFnPtr;
+  typedef typeof(&BasicProgramEvalVars) BasicProgramEvalVarsFnPtr;
+  typedef typeof(&BasicProgramFree) BasicProgramFreeFnPtr;
+  typedef typeof(&BasicProgramOptimize) BasicProgramOptimizeFnPtr;
+  typedef typeof(&BasicSetJitThreshold) BasicSetJitThresholdFnPtr;
+  typedef typeof(&BasicCacheConfigure) BasicCacheConfigureFnPtr;
+  typedef typeof(&BasicCacheGetStats) BasicCacheGetStatsFnPtr;
+  typedef typeof(&BasicSolveEquation) BasicSolveEquationFnPtr;
+  typedef typeof(&BasicSampleCurve) BasicSampleCurveFnPtr;
+  typedef typeof(&BasicEvaluateRange) BasicEvaluateRangeFnPtr;
+  typedef typeof(&BasicEvaluateLinspace) BasicEvaluateLinspaceFnPtr;
+  typedef typeof(&BasicEditorNew) BasicEditorNewFnPtr;
+  typedef typeof(&BasicEditorReplace) BasicEditorReplaceFnPtr;
+  typedef typeof(&BasicEditorFree) BasicEditorFreeFnPtr;
 
   static inline BasicCalcError CallBasicCalcExprPtr(BasicCalcExprFnPtr fn_ptr, const char* expr, double* res) {
 	 return fn_ptr(expr, res);
@@ -13,27 +33,202 @@ package basiccalc
   static inline BasicCalcError CallBasicCalcEquationPtr(BasicCalcEquationFnPtr fn_ptr, const char* expr, const char* x, double* res) {
 	 return fn_ptr(expr, x, res);
   }
+
+  static inline BasicCalcError CallBasicCalcBatchPtr(BasicCalcBatchFnPtr fn_ptr, const char* const* exprs, const double* x, size_t size, double* res, BasicCalcError* errors) {
+	 return fn_ptr(exprs, x, size, res, errors);
+  }
+
+  static inline void CallBasicSetBatchThreadsPtr(BasicSetBatchThreadsFnPtr fn_ptr, size_t threads) {
+	 fn_ptr(threads);
+  }
+
+  static inline BasicCalcError CallBasicCompileExprPtr(BasicCompileExprFnPtr fn_ptr, const char* expr, BasicProgram** program) {
+	 return fn_ptr(expr, program);
+  }
+
+  static inline BasicCalcError CallBasicProgramEvalPtr(BasicProgramEvalFnPtr fn_ptr, const BasicProgram* program, double x, double* res) {
+	 return fn_ptr(program, x, res);
+  }
+
+  static inline BasicCalcError CallBasicCompileVarsPtr(BasicCompileVarsFnPtr fn_ptr, const char* expr, const char* const* names, size_t size, BasicProgram** program) {
+	 return fn_ptr(expr, names, size, program);
+  }
+
+  static inline BasicCalcError CallBasicProgramEvalVarsPtr(BasicProgramEvalVarsFnPtr fn_ptr, const BasicProgram* program, const double* values, double* res) {
+	 return fn_ptr(program, values, res);
+  }
+
+  static inline void CallBasicProgramFreePtr(BasicProgramFreeFnPtr fn_ptr, BasicProgram* program) {
+	 fn_ptr(program);
+  }
+
+  static inline BasicCalcError CallBasicProgramOptimizePtr(BasicProgramOptimizeFnPtr fn_ptr, BasicProgram* program, size_t* removed) {
+	 return fn_ptr(program, removed);
+  }
+
+  static inline void CallBasicSetJitThresholdPtr(BasicSetJitThresholdFnPtr fn_ptr, size_t threshold) {
+	 fn_ptr(threshold);
+  }
+
+  static inline BasicCalcError CallBasicCacheConfigurePtr(BasicCacheConfigureFnPtr fn_ptr, bool enabled, size_t capacity) {
+	 return fn_ptr(enabled, capacity);
+  }
+
+  static inline void CallBasicCacheGetStatsPtr(BasicCacheGetStatsFnPtr fn_ptr, BasicCacheStats* stats) {
+	 fn_ptr(stats);
+  }
+
+  static inline BasicCalcError CallBasicSolveEquationPtr(BasicSolveEquationFnPtr fn_ptr, const char* expr, double x_min, double x_max, double tolerance, double* roots, size_t max_roots, size_t* count) {
+	 return fn_ptr(expr, x_min, x_max, tolerance, roots, max_roots, count);
+  }
+
+  static inline BasicCalcError CallBasicSampleCurvePtr(BasicSampleCurveFnPtr fn_ptr, const char* expr, double x_min, double x_max, double y_min, double y_max, size_t pixel_width, BasicPoint* points, size_t max_points, size_t* count) {
+	 return fn_ptr(expr, x_min, x_max, y_min, y_max, pixel_width, points, max_points, count);
+  }
+
+  static inline BasicCalcError CallBasicEvaluateRangePtr(BasicEvaluateRangeFnPtr fn_ptr, const char* expr, const double* x, size_t size, double* res) {
+	 return fn_ptr(expr, x, size, res, NULL);
+  }
+
+  static inline BasicCalcError CallBasicEvaluateLinspacePtr(BasicEvaluateLinspaceFnPtr fn_ptr, const char* expr, double x_start, double x_step, size_t size, double* res) {
+	 return fn_ptr(expr, x_start, x_step, size, res, NULL);
+  }
+
+  static inline BasicCalcError CallBasicEditorNewPtr(BasicEditorNewFnPtr fn_ptr, BasicEditor** editor) {
+	 return fn_ptr(editor);
+  }
+
+  static inline BasicCalcError CallBasicEditorReplacePtr(BasicEditorReplaceFnPtr fn_ptr, BasicEditor* editor, size_t pos, size_t removed, const char* text, size_t size, double* res) {
+	 return fn_ptr(editor, pos, removed, text, size, res);
+  }
+
+  static inline void CallBasicEditorFreePtr(BasicEditorFreeFnPtr fn_ptr, BasicEditor* editor) {
+	 fn_ptr(editor);
+  }
 */
 import "C"
 import (
 	"errors"
 	"github.com/pancakeswya/GoSmartCalc/pkg/dll"
+	"math"
 	"strconv"
+	"unsafe"
 )
 
 type (
 	CalcExprFn     func(string) (float64, error)
 	CalcEquationFn func(string, float64) (float64, error)
+	CalcBatchFn    func([]string, []float64) ([]float64, []error, error)
+	SetThreadsFn   func(int)
+	CompileFn      func(string) (*Program, error)
+	CompileVarsFn  func(string, ...string) (*Program, error)
+	ProgramEvalFn  func(float64) (float64, error)
+	EvalVarsFn     func([]float64) (float64, error)
+	ProgramFreeFn  func()
+	ProgramOptFn   func() (int, error)
+	SetJitFn       func(int)
+	CacheConfFn    func(bool, int) error
+	CacheStatsFn   func() CacheStats
+	SolveFn        func(string, float64, float64, float64, int) ([]float64, error)
+	SampleCurveFn  func(string, float64, float64, float64, float64, int) ([][]Point, error)
+	EvalRangeFn    func(string, []float64) ([]float64, error)
+	EvalLinspaceFn func(string, float64, float64, int) ([]float64, error)
+	NewEditorFn    func() (*Editor, error)
+	EditorRepFn    func(int, int, string) (float64, error)
+	EditorFreeFn   func()
 )
 
+// Program is an expression parsed once by Compile that
+// can be evaluated for any number of x values.
+// EvalVars takes one value per variable name given to CompileVars,
+// in the same order, or just x for programs made by Compile.
+// Optimize folds constants and merges repeated subexpressions,
+// returning the number of operations removed.
+// Free must be called once the program is no longer needed.
+type Program struct {
+	Eval     ProgramEvalFn
+	EvalVars EvalVarsFn
+	Optimize ProgramOptFn
+	Free     ProgramFreeFn
+}
+
+// Editor keeps an expression that is being typed together with
+// its parse, Replace swaps removed bytes at pos for text and
+// returns what the whole text evaluates to, reading again only
+// the tokens around the edit.
+// Free must be called once the editor is no longer needed.
+type Editor struct {
+	Replace EditorRepFn
+	Free    EditorFreeFn
+}
+
+// Point is a vertex of a sampled curve.
+type Point struct {
+	X, Y float64
+}
+
+// CacheStats is a snapshot of the expression cache used by
+// CalculateExpr and CalculateEquation.
+type CacheStats struct {
+	Enabled   bool
+	Capacity  int
+	Size      int
+	Hits      int
+	Misses    int
+	Evictions int
+}
+
 type Calc struct {
 	CalculateExpr     CalcExprFn
 	CalculateEquation CalcEquationFn
+	// CalculateBatch evaluates every expression on the library's
+	// thread pool, with xs[i] as x unless xs is nil. A failed
+	// expression has its error at the same index.
+	CalculateBatch CalcBatchFn
+	// SetBatchThreads sets the threads used by CalculateBatch,
+	// 0 uses every processor.
+	SetBatchThreads  SetThreadsFn
+	Compile          CompileFn
+	CompileVars      CompileVarsFn
+	EvaluateRange    EvalRangeFn
+	EvaluateLinspace EvalLinspaceFn
+	NewEditor        NewEditorFn
+	// SetJitThreshold sets after how many evaluations a compiled
+	// Program switches to native code, 0 disables the switch.
+	SetJitThreshold SetJitFn
+	// ConfigureCache turns the expression cache on or off and sets
+	// the number of expressions it keeps, it is off by default.
+	ConfigureCache CacheConfFn
+	CacheStats     CacheStatsFn
+	// Solve returns up to maxRoots roots of expr = 0 between
+	// xMin and xMax, found to within tolerance.
+	Solve SolveFn
+	// SampleCurve samples expr for a plot pixelWidth pixels wide,
+	// returning polylines split at discontinuities.
+	SampleCurve SampleCurveFn
 }
 
 const (
 	calculateExprFuncName     = "BasicCalculateExpr"
 	calculateEquationFuncName = "BasicCalculateEquation"
+	calculateBatchFuncName    = "BasicCalculateBatch"
+	setBatchThreadsFuncName   = "BasicSetBatchThreads"
+	compileExprFuncName       = "BasicCompileExpr"
+	programEvalFuncName       = "BasicProgramEval"
+	compileVarsFuncName       = "BasicCompileVars"
+	programEvalVarsFuncName   = "BasicProgramEvalVars"
+	programFreeFuncName       = "BasicProgramFree"
+	programOptimizeFuncName   = "BasicProgramOptimize"
+	setJitThresholdFuncName   = "BasicSetJitThreshold"
+	cacheConfigureFuncName    = "BasicCacheConfigure"
+	cacheGetStatsFuncName     = "BasicCacheGetStats"
+	solveEquationFuncName     = "BasicSolveEquation"
+	sampleCurveFuncName       = "BasicSampleCurve"
+	evaluateRangeFuncName     = "BasicEvaluateRange"
+	evaluateLinspaceFuncName  = "BasicEvaluateLinspace"
+	editorNewFuncName         = "BasicEditorNew"
+	editorReplaceFuncName     = "BasicEditorReplace"
+	editorFreeFuncName        = "BasicEditorFree"
 )
 
 var (
@@ -46,6 +241,7 @@ var (
 	ErrIncorrectFunctionUsage = errors.New("incorrect function usage")
 	ErrInvalidEquation        = errors.New("invalid equation")
 	ErrInvalidExpression      = errors.New("invalid expression")
+	ErrInvalidArgument        = errors.New("invalid argument")
 
 	errBasicCalcErrs = [...]error{
 		ErrSuccess,
@@ -57,9 +253,21 @@ var (
 		ErrIncorrectFunctionUsage,
 		ErrInvalidEquation,
 		ErrInvalidExpression,
+		ErrInvalidArgument,
 	}
 )
 
+// ErrorCode returns the BasicCalcError code behind an error
+// returned by Calc, or -1 for any other error.
+func ErrorCode(err error) int {
+	for code, calcErr := range errBasicCalcErrs {
+		if errors.Is(err, calcErr) {
+			return code
+		}
+	}
+	return -1
+}
+
 func New(dl dll.Dll) (*Calc, error) {
 	ptr, err := dl.GetSymbolPtr(calculateExprFuncName)
 	if err != nil {
@@ -73,23 +281,378 @@ func New(dl dll.Dll) (*Calc, error) {
 	}
 	calcEquationFnPtr := C.BasicCalcEquationFnPtr(ptr)
 
+	ptr, err = dl.GetSymbolPtr(calculateBatchFuncName)
+	if err != nil {
+		return nil, err
+	}
+	calcBatchFnPtr := C.BasicCalcBatchFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(setBatchThreadsFuncName)
+	if err != nil {
+		return nil, err
+	}
+	setBatchThreadsFnPtr := C.BasicSetBatchThreadsFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(compileExprFuncName)
+	if err != nil {
+		return nil, err
+	}
+	compileExprFnPtr := C.BasicCompileExprFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(programEvalFuncName)
+	if err != nil {
+		return nil, err
+	}
+	programEvalFnPtr := C.BasicProgramEvalFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(compileVarsFuncName)
+	if err != nil {
+		return nil, err
+	}
+	compileVarsFnPtr := C.BasicCompileVarsFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(programEvalVarsFuncName)
+	if err != nil {
+		return nil, err
+	}
+	programEvalVarsFnPtr := C.BasicProgramEvalVarsFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(programFreeFuncName)
+	if err != nil {
+		return nil, err
+	}
+	programFreeFnPtr := C.BasicProgramFreeFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(programOptimizeFuncName)
+	if err != nil {
+		return nil, err
+	}
+	programOptimizeFnPtr := C.BasicProgramOptimizeFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(setJitThresholdFuncName)
+	if err != nil {
+		return nil, err
+	}
+	setJitThresholdFnPtr := C.BasicSetJitThresholdFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(cacheConfigureFuncName)
+	if err != nil {
+		return nil, err
+	}
+	cacheConfigureFnPtr := C.BasicCacheConfigureFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(cacheGetStatsFuncName)
+	if err != nil {
+		return nil, err
+	}
+	cacheGetStatsFnPtr := C.BasicCacheGetStatsFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(solveEquationFuncName)
+	if err != nil {
+		return nil, err
+	}
+	solveEquationFnPtr := C.BasicSolveEquationFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(sampleCurveFuncName)
+	if err != nil {
+		return nil, err
+	}
+	sampleCurveFnPtr := C.BasicSampleCurveFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(evaluateRangeFuncName)
+	if err != nil {
+		return nil, err
+	}
+	evaluateRangeFnPtr := C.BasicEvaluateRangeFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(evaluateLinspaceFuncName)
+	if err != nil {
+		return nil, err
+	}
+	evaluateLinspaceFnPtr := C.BasicEvaluateLinspaceFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(editorNewFuncName)
+	if err != nil {
+		return nil, err
+	}
+	editorNewFnPtr := C.BasicEditorNewFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(editorReplaceFuncName)
+	if err != nil {
+		return nil, err
+	}
+	editorReplaceFnPtr := C.BasicEditorReplaceFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(editorFreeFuncName)
+	if err != nil {
+		return nil, err
+	}
+	editorFreeFnPtr := C.BasicEditorFreeFnPtr(ptr)
+
 	bc := &Calc{}
 	bc.CalculateExpr = func(expr string) (float64, error) {
+		cExpr := C.CString(expr)
+		defer C.free(unsafe.Pointer(cExpr))
 		var res C.double
-		errCode := C.CallBasicCalcExprPtr(calcExprFnPtr, C.CString(expr), &res)
+		errCode := C.CallBasicCalcExprPtr(calcExprFnPtr, cExpr, &res)
 		if errCode != C.kBasicCalcErrorSuccess {
 			return 0, errBasicCalcErrs[errCode]
 		}
 		return float64(res), nil
 	}
 	bc.CalculateEquation = func(expr string, x float64) (float64, error) {
+		cExpr := C.CString(expr)
+		defer C.free(unsafe.Pointer(cExpr))
+		// The shortest form that parses back to exactly x.
+		cX := C.CString(strconv.FormatFloat(x, 'g', -1, 64))
+		defer C.free(unsafe.Pointer(cX))
 		var res C.double
-		xStr := strconv.FormatFloat(x, 'f', 10, 64)
-		errCode := C.CallBasicCalcEquationPtr(calcEquationFnPtr, C.CString(expr), C.CString(xStr), &res)
+		errCode := C.CallBasicCalcEquationPtr(calcEquationFnPtr, cExpr, cX, &res)
 		if errCode != C.kBasicCalcErrorSuccess {
 			return 0, errBasicCalcErrs[errCode]
 		}
 		return float64(res), nil
 	}
+	bc.CalculateBatch = func(exprs []string, xs []float64) ([]float64, []error, error) {
+		if xs != nil && len(xs) != len(exprs) {
+			return nil, nil, ErrInvalidArgument
+		}
+		res := make([]float64, len(exprs))
+		errs := make([]error, len(exprs))
+		if len(exprs) == 0 {
+			return res, errs, nil
+		}
+		// Same as in CompileVars, the string pointers live in C memory.
+		cExprs := (**C.char)(C.malloc(C.size_t(len(exprs)) * C.size_t(unsafe.Sizeof((*C.char)(nil)))))
+		defer C.free(unsafe.Pointer(cExprs))
+		exprSlice := unsafe.Slice(cExprs, len(exprs))
+		for i, expr := range exprs {
+			exprSlice[i] = C.CString(expr)
+		}
+		defer func() {
+			for _, cExpr := range exprSlice {
+				C.free(unsafe.Pointer(cExpr))
+			}
+		}()
+		var cXs *C.double
+		if xs != nil {
+			cXs = (*C.double)(unsafe.Pointer(&xs[0]))
+		}
+		codes := make([]C.BasicCalcError, len(exprs))
+		errCode := C.CallBasicCalcBatchPtr(calcBatchFnPtr, cExprs, cXs, C.size_t(len(exprs)),
+			(*C.double)(unsafe.Pointer(&res[0])), &codes[0])
+		if errCode != C.kBasicCalcErrorSuccess {
+			return nil, nil, errBasicCalcErrs[errCode]
+		}
+		for i, code := range codes {
+			if code != C.kBasicCalcErrorSuccess {
+				res[i], errs[i] = 0, errBasicCalcErrs[code]
+			}
+		}
+		return res, errs, nil
+	}
+	bc.SetBatchThreads = func(threads int) {
+		C.CallBasicSetBatchThreadsPtr(setBatchThreadsFnPtr, C.size_t(threads))
+	}
+	newProgram := func(program *C.BasicProgram, vars int) *Program {
+		return &Program{
+			Eval: func(x float64) (float64, error) {
+				var res C.double
+				errCode := C.CallBasicProgramEvalPtr(programEvalFnPtr, program, C.double(x), &res)
+				if errCode != C.kBasicCalcErrorSuccess {
+					return 0, errBasicCalcErrs[errCode]
+				}
+				return float64(res), nil
+			},
+			EvalVars: func(values []float64) (float64, error) {
+				if len(values) != vars {
+					return 0, ErrInvalidArgument
+				}
+				var cValues *C.double
+				if vars != 0 {
+					cValues = (*C.double)(unsafe.Pointer(&values[0]))
+				}
+				var res C.double
+				errCode := C.CallBasicProgramEvalVarsPtr(programEvalVarsFnPtr, program, cValues, &res)
+				if errCode != C.kBasicCalcErrorSuccess {
+					return 0, errBasicCalcErrs[errCode]
+				}
+				return float64(res), nil
+			},
+			Optimize: func() (int, error) {
+				var removed C.size_t
+				errCode := C.CallBasicProgramOptimizePtr(programOptimizeFnPtr, program, &removed)
+				if errCode != C.kBasicCalcErrorSuccess {
+					return 0, errBasicCalcErrs[errCode]
+				}
+				return int(removed), nil
+			},
+			Free: func() {
+				C.CallBasicProgramFreePtr(programFreeFnPtr, program)
+				program = nil
+			},
+		}
+	}
+	bc.Compile = func(expr string) (*Program, error) {
+		cExpr := C.CString(expr)
+		defer C.free(unsafe.Pointer(cExpr))
+		var program *C.BasicProgram
+		errCode := C.CallBasicCompileExprPtr(compileExprFnPtr, cExpr, &program)
+		if errCode != C.kBasicCalcErrorSuccess {
+			return nil, errBasicCalcErrs[errCode]
+		}
+		return newProgram(program, 1), nil
+	}
+	bc.CompileVars = func(expr string, names ...string) (*Program, error) {
+		cExpr := C.CString(expr)
+		defer C.free(unsafe.Pointer(cExpr))
+		// The names array is read by C, so it lives in C memory
+		// as cgo does not allow passing Go pointers to Go pointers.
+		cNames := (**C.char)(C.malloc(C.size_t(len(names)+1) * C.size_t(unsafe.Sizeof((*C.char)(nil)))))
+		defer C.free(unsafe.Pointer(cNames))
+		nameSlice := unsafe.Slice(cNames, len(names))
+		for i, name := range names {
+			nameSlice[i] = C.CString(name)
+			defer C.free(unsafe.Pointer(nameSlice[i]))
+		}
+		var program *C.BasicProgram
+		errCode := C.CallBasicCompileVarsPtr(compileVarsFnPtr, cExpr, cNames, C.size_t(len(names)), &program)
+		if errCode != C.kBasicCalcErrorSuccess {
+			return nil, errBasicCalcErrs[errCode]
+		}
+		return newProgram(program, len(names)), nil
+	}
+	bc.SetJitThreshold = func(threshold int) {
+		C.CallBasicSetJitThresholdPtr(setJitThresholdFnPtr, C.size_t(threshold))
+	}
+	bc.ConfigureCache = func(enabled bool, capacity int) error {
+		errCode := C.CallBasicCacheConfigurePtr(cacheConfigureFnPtr, C.bool(enabled), C.size_t(capacity))
+		if errCode != C.kBasicCalcErrorSuccess {
+			return errBasicCalcErrs[errCode]
+		}
+		return nil
+	}
+	bc.CacheStats = func() CacheStats {
+		var stats C.BasicCacheStats
+		C.CallBasicCacheGetStatsPtr(cacheGetStatsFnPtr, &stats)
+		return CacheStats{
+			Enabled:   bool(stats.enabled),
+			Capacity:  int(stats.capacity),
+			Size:      int(stats.size),
+			Hits:      int(stats.hits),
+			Misses:    int(stats.misses),
+			Evictions: int(stats.evictions),
+		}
+	}
+	bc.Solve = func(expr string, xMin, xMax, tolerance float64, maxRoots int) ([]float64, error) {
+		roots := make([]float64, maxRoots)
+		if maxRoots == 0 {
+			return roots, nil
+		}
+		cExpr := C.CString(expr)
+		defer C.free(unsafe.Pointer(cExpr))
+		var count C.size_t
+		errCode := C.CallBasicSolveEquationPtr(solveEquationFnPtr, cExpr,
+			C.double(xMin), C.double(xMax), C.double(tolerance),
+			(*C.double)(unsafe.Pointer(&roots[0])), C.size_t(maxRoots), &count)
+		if errCode != C.kBasicCalcErrorSuccess {
+			return nil, errBasicCalcErrs[errCode]
+		}
+		return roots[:count], nil
+	}
+	bc.SampleCurve = func(expr string, xMin, xMax, yMin, yMax float64, pixelWidth int) ([][]Point, error) {
+		if pixelWidth <= 0 {
+			return nil, ErrInvalidArgument
+		}
+		cExpr := C.CString(expr)
+		defer C.free(unsafe.Pointer(cExpr))
+		// Enough for most curves, the call is repeated with
+		// the exact size when it is not.
+		points := make([]Point, 2*pixelWidth+64)
+		for {
+			var count C.size_t
+			errCode := C.CallBasicSampleCurvePtr(sampleCurveFnPtr, cExpr,
+				C.double(xMin), C.double(xMax), C.double(yMin), C.double(yMax), C.size_t(pixelWidth),
+				(*C.BasicPoint)(unsafe.Pointer(&points[0])), C.size_t(len(points)), &count)
+			if errCode != C.kBasicCalcErrorSuccess {
+				return nil, errBasicCalcErrs[errCode]
+			}
+			if int(count) <= len(points) {
+				points = points[:count]
+				break
+			}
+			points = make([]Point, count)
+		}
+		var lines [][]Point
+		start := 0
+		for i, point := range points {
+			if math.IsNaN(point.X) {
+				lines = append(lines, points[start:i])
+				start = i + 1
+			}
+		}
+		if start < len(points) {
+			lines = append(lines, points[start:])
+		}
+		return lines, nil
+	}
+	bc.EvaluateRange = func(expr string, xs []float64) ([]float64, error) {
+		res := make([]float64, len(xs))
+		if len(xs) == 0 {
+			return res, nil
+		}
+		cExpr := C.CString(expr)
+		defer C.free(unsafe.Pointer(cExpr))
+		errCode := C.CallBasicEvaluateRangePtr(evaluateRangeFnPtr, cExpr,
+			(*C.double)(unsafe.Pointer(&xs[0])), C.size_t(len(xs)),
+			(*C.double)(unsafe.Pointer(&res[0])))
+		if errCode != C.kBasicCalcErrorSuccess {
+			return nil, errBasicCalcErrs[errCode]
+		}
+		return res, nil
+	}
+	bc.EvaluateLinspace = func(expr string, xStart, xStep float64, size int) ([]float64, error) {
+		res := make([]float64, size)
+		if size == 0 {
+			return res, nil
+		}
+		cExpr := C.CString(expr)
+		defer C.free(unsafe.Pointer(cExpr))
+		errCode := C.CallBasicEvaluateLinspacePtr(evaluateLinspaceFnPtr, cExpr,
+			C.double(xStart), C.double(xStep), C.size_t(size),
+			(*C.double)(unsafe.Pointer(&res[0])))
+		if errCode != C.kBasicCalcErrorSuccess {
+			return nil, errBasicCalcErrs[errCode]
+		}
+		return res, nil
+	}
+	bc.NewEditor = func() (*Editor, error) {
+		var editor *C.BasicEditor
+		errCode := C.CallBasicEditorNewPtr(editorNewFnPtr, &editor)
+		if errCode != C.kBasicCalcErrorSuccess {
+			return nil, errBasicCalcErrs[errCode]
+		}
+		return &Editor{
+			Replace: func(pos, removed int, text string) (float64, error) {
+				if pos < 0 || removed < 0 {
+					return 0, ErrInvalidArgument
+				}
+				// Not a C string, the size is passed along with it.
+				cText := (*C.char)(C.CBytes([]byte(text)))
+				defer C.free(unsafe.Pointer(cText))
+				var res C.double
+				errCode := C.CallBasicEditorReplacePtr(editorReplaceFnPtr, editor,
+					C.size_t(pos), C.size_t(removed), cText, C.size_t(len(text)), &res)
+				if errCode != C.kBasicCalcErrorSuccess {
+					return 0, errBasicCalcErrs[errCode]
+				}
+				return float64(res), nil
+			},
+			Free: func() {
+				C.CallBasicEditorFreePtr(editorFreeFnPtr, editor)
+				editor = nil
+			},
+		}, nil
+	}
 	return bc, nil
 }
@@ -0,0 +1,45 @@
+#include "basic_calc.h"
+#include "basic_program.h"
+#include "calc_pool.h"
+
+enum {
+  kBatchChunk = 16,
+  // Below this many expressions waking the pool costs more than it saves.
+  kBatchMinParallel = 4 * kBatchChunk
+};
+
+typedef struct {
+  const char* const* exprs;
+  const double* x;
+  double* res;
+  BasicCalcError* errors;
+} BatchJob;
+
+static void BatchEval(void* arg, size_t worker, size_t begin, size_t end) {
+  const BatchJob* job = (const BatchJob*)arg;
+  (void)worker;
+  for (size_t i = begin; i < end; ++i) {
+    double res = 0.0;
+    BasicCalcError error = BasicCalculate(job->exprs[i], job->x != NULL, job->x ? job->x[i] : 0.0, &res);
+    job->res[i] = res;
+    if (job->errors) {
+      job->errors[i] = error;
+    }
+  }
+}
+
+BasicCalcError CALL_CONV BasicCalculateBatch(const char* const* math_exprs,
+                                             const double* x,
+                                             size_t size,
+                                             double* res,
+                                             BasicCalcError* errors) {
+  BatchJob job = {.exprs = math_exprs, .x = x, .res = res, .errors = errors};
+  size_t workers = CalcPoolAcquire(size >= kBatchMinParallel);
+  CalcPoolRun(workers, BatchEval, &job, size, kBatchChunk);
+  CalcPoolRelease(workers);
+  return kBasicCalcErrorSuccess;
+}
+
+void CALL_CONV BasicSetBatchThreads(size_t threads) {
+  CalcPoolSetThreads(threads);
+}
@@ -0,0 +1,381 @@
+#include "basic_cache.h"
+#include "basic_program.h"
+#include "util/counters.h"
+#include "util/thread.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  kCacheShards = 16,
+  kCacheDefaultCapacity = 1024,
+  kCacheKeyBufSize = 256
+};
+
+typedef struct CacheEntry {
+  // Recency list of the shard, head is the most recently used.
+  struct CacheEntry* prev;
+  struct CacheEntry* next;
+  struct CacheEntry* chain;
+  uint64_t hash;
+  // The shard holds one reference, every evaluation in flight holds another.
+  atomic_size_t refs;
+  BasicProgram* program;
+  bool has_x;
+  // Final value, only set for expressions without x.
+  double value;
+  size_t key_size;
+  char key[];
+} CacheEntry;
+
+typedef struct {
+  Mutex mutex;
+  CacheEntry** buckets;
+  size_t bucket_count;
+  CacheEntry* head;
+  CacheEntry* tail;
+  size_t size;
+  size_t capacity;
+  size_t hits;
+  size_t misses;
+  size_t evictions;
+} CacheShard;
+
+static CacheShard shards[kCacheShards];
+static Once cache_once = ONCE_INIT;
+static atomic_bool cache_enabled = false;
+
+static void CacheInit(void) {
+  for (size_t i = 0; i < kCacheShards; ++i) {
+    MutexInit(&shards[i].mutex);
+    shards[i].capacity = kCacheDefaultCapacity / kCacheShards;
+  }
+}
+
+static inline bool IsBlank(char c) {
+  return c == ' ' || c == '\n' || c == '\t';
+}
+
+// ParseDouble reads a sign right after e or p as part of the exponent.
+static inline bool IsExponentMark(char c) {
+  return c == 'e' || c == 'E' || c == 'p' || c == 'P';
+}
+
+// Whitespace is dropped only where it can't change how the expression is
+// read, "1 2", "sin (1)" and "1e- 5" keep a single blank.
+static bool DropsBlank(const char* out, size_t size, char next) {
+  if (size == 0 || next == '\0' || strchr("*/^)", next)) {
+    return true;
+  }
+  char prev = out[size - 1];
+  if (strchr("*/^()", prev)) {
+    return true;
+  }
+  if (prev == '+' || prev == '-') {
+    return size == 1 || !IsExponentMark(out[size - 2]);
+  }
+  return (next == '+' || next == '-') && !IsExponentMark(prev);
+}
+
+static size_t NormalizeExpr(const char* expr, char* out) {
+  size_t size = 0;
+  while (*expr) {
+    if (!IsBlank(*expr)) {
+      out[size++] = *expr++;
+      continue;
+    }
+    while (IsBlank(*expr)) {
+      ++expr;
+    }
+    if (!DropsBlank(out, size, *expr)) {
+      out[size++] = ' ';
+    }
+  }
+  out[size] = '\0';
+  return size;
+}
+
+// FNV-1a
+static uint64_t HashKey(const char* key, size_t size) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= (unsigned char)key[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static inline CacheShard* ShardOf(uint64_t hash) {
+  return shards + (hash & (kCacheShards - 1));
+}
+
+static inline CacheEntry** BucketOf(CacheShard* shard, uint64_t hash) {
+  return shard->buckets + ((hash >> 4) & (shard->bucket_count - 1));
+}
+
+static void EntryRelease(CacheEntry* entry) {
+  if (atomic_fetch_sub_explicit(&entry->refs, 1, memory_order_acq_rel) == 1) {
+    BasicProgramFree(entry->program);
+    free(entry);
+  }
+}
+
+static void ListUnlink(CacheShard* shard, CacheEntry* entry) {
+  if (entry->prev) {
+    entry->prev->next = entry->next;
+  } else {
+    shard->head = entry->next;
+  }
+  if (entry->next) {
+    entry->next->prev = entry->prev;
+  } else {
+    shard->tail = entry->prev;
+  }
+}
+
+static void ListPushFront(CacheShard* shard, CacheEntry* entry) {
+  entry->prev = NULL;
+  entry->next = shard->head;
+  if (shard->head) {
+    shard->head->prev = entry;
+  } else {
+    shard->tail = entry;
+  }
+  shard->head = entry;
+}
+
+static void ShardRemove(CacheShard* shard, CacheEntry* entry) {
+  CacheEntry** link = BucketOf(shard, entry->hash);
+  while (*link != entry) {
+    link = &(*link)->chain;
+  }
+  *link = entry->chain;
+  ListUnlink(shard, entry);
+  --shard->size;
+  EntryRelease(entry);
+}
+
+static void ShardTrim(CacheShard* shard, size_t capacity) {
+  while (shard->size > capacity) {
+    ShardRemove(shard, shard->tail);
+    ++shard->evictions;
+  }
+}
+
+static CacheEntry* ShardFind(CacheShard* shard, uint64_t hash, const char* key, size_t key_size) {
+  if (!shard->buckets) {
+    return NULL;
+  }
+  for (CacheEntry* entry = *BucketOf(shard, hash); entry; entry = entry->chain) {
+    if (entry->hash == hash && entry->key_size == key_size && memcmp(entry->key, key, key_size) == 0) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+static size_t BucketCount(size_t capacity) {
+  size_t count = 1;
+  while (count < capacity) {
+    count <<= 1;
+  }
+  return count;
+}
+
+// Resizes the bucket array to the shard capacity, entries are rehashed.
+static bool ShardRehash(CacheShard* shard) {
+  size_t count = BucketCount(shard->capacity);
+  if (count == shard->bucket_count) {
+    return true;
+  }
+  CacheEntry** buckets = (CacheEntry**)CountersCalloc(count, sizeof(CacheEntry*));
+  if (!buckets) {
+    return false;
+  }
+  free(shard->buckets);
+  shard->buckets = buckets;
+  shard->bucket_count = count;
+  for (CacheEntry* entry = shard->head; entry; entry = entry->next) {
+    CacheEntry** bucket = BucketOf(shard, entry->hash);
+    entry->chain = *bucket;
+    *bucket = entry;
+  }
+  return true;
+}
+
+// Returns the entry with a reference taken, either the cached one or
+// the given one after it is inserted.
+static CacheEntry* ShardInsert(CacheShard* shard, CacheEntry* entry) {
+  CacheEntry* found = ShardFind(shard, entry->hash, entry->key, entry->key_size);
+  if (found) {
+    // Another thread compiled the same expression first.
+    atomic_fetch_add_explicit(&found->refs, 1, memory_order_relaxed);
+    EntryRelease(entry);
+    return found;
+  }
+  // A capacity below kCacheShards leaves some shards without room.
+  if (!BasicCacheEnabled() || shard->capacity == 0 ||
+      (shard->bucket_count == 0 && !ShardRehash(shard))) {
+    return entry;
+  }
+  ShardTrim(shard, shard->capacity - 1);
+  CacheEntry** bucket = BucketOf(shard, entry->hash);
+  entry->chain = *bucket;
+  *bucket = entry;
+  ListPushFront(shard, entry);
+  ++shard->size;
+  atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+  return entry;
+}
+
+static bool HasVariable(const BasicProgram* program) {
+  for (size_t i = 0; i < program->size; ++i) {
+    if (program->instrs[i].type == kBasicInstrVariable) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static CacheEntry* EntryNew(const char* key, size_t key_size, uint64_t hash, BasicCalcError* error) {
+  BasicProgram* program = NULL;
+  *error = BasicCompileExpr(key, &program);
+  if (*error != kBasicCalcErrorSuccess) {
+    return NULL;
+  }
+  CacheEntry* entry = (CacheEntry*)CountersMalloc(sizeof(CacheEntry) + key_size + 1);
+  if (!entry) {
+    BasicProgramFree(program);
+    *error = kBasicCalcAllocationFail;
+    return NULL;
+  }
+  *entry = (CacheEntry){.hash = hash, .program = program, .key_size = key_size};
+  atomic_init(&entry->refs, 1);
+  memcpy(entry->key, key, key_size + 1);
+  // Cached programs are evaluated many times, so optimizing pays off.
+  *error = BasicProgramOptimize(program, NULL);
+  if (*error == kBasicCalcErrorSuccess) {
+    entry->has_x = HasVariable(program);
+    if (!entry->has_x) {
+      *error = BasicProgramEval(program, 0.0, &entry->value);
+    }
+  }
+  if (*error != kBasicCalcErrorSuccess) {
+    EntryRelease(entry);
+    return NULL;
+  }
+  return entry;
+}
+
+static bool CacheEval(const char* key, size_t key_size, bool allow_x, double x, double* res, BasicCalcError* error) {
+  uint64_t hash = HashKey(key, key_size);
+  CacheShard* shard = ShardOf(hash);
+  MutexLock(&shard->mutex);
+  CacheEntry* entry = ShardFind(shard, hash, key, key_size);
+  if (entry) {
+    ListUnlink(shard, entry);
+    ListPushFront(shard, entry);
+    atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+    ++shard->hits;
+  } else {
+    ++shard->misses;
+  }
+  MutexUnlock(&shard->mutex);
+  if (!entry) {
+    // Compiled outside of the lock, so a slow expression doesn't stall
+    // the whole shard.
+    entry = EntryNew(key, key_size, hash, error);
+    if (!entry) {
+      return *error == kBasicCalcAllocationFail;
+    }
+    MutexLock(&shard->mutex);
+    entry = ShardInsert(shard, entry);
+    MutexUnlock(&shard->mutex);
+  }
+  if (entry->has_x && !allow_x) {
+    *error = kBasicCalcErrorInvalidExpr;
+  } else if (!entry->has_x) {
+    *res = entry->value;
+    *error = kBasicCalcErrorSuccess;
+  } else {
+    *error = BasicProgramEval(entry->program, x, res);
+  }
+  EntryRelease(entry);
+  return true;
+}
+
+bool BasicCacheEnabled(void) {
+  return atomic_load_explicit(&cache_enabled, memory_order_relaxed);
+}
+
+bool BasicCacheEval(const char* math_expr, bool allow_x, double x, double* res, BasicCalcError* error) {
+  OnceCall(&cache_once, CacheInit);
+  char buf[kCacheKeyBufSize];
+  char* key = buf;
+  size_t len = strlen(math_expr);
+  if (len >= kCacheKeyBufSize) {
+    key = (char*)CountersMalloc(len + 1);
+    if (!key) {
+      *error = kBasicCalcAllocationFail;
+      return true;
+    }
+  }
+  size_t key_size = NormalizeExpr(math_expr, key);
+  bool cached = CacheEval(key, key_size, allow_x, x, res, error);
+  if (key != buf) {
+    free(key);
+  }
+  return cached;
+}
+
+BasicCalcError CALL_CONV BasicCacheConfigure(bool enabled, size_t capacity) {
+  OnceCall(&cache_once, CacheInit);
+  if (capacity == 0) {
+    enabled = false;
+  }
+  atomic_store_explicit(&cache_enabled, enabled, memory_order_relaxed);
+  BasicCalcError error = kBasicCalcErrorSuccess;
+  for (size_t i = 0; i < kCacheShards; ++i) {
+    CacheShard* shard = shards + i;
+    // The shards split the capacity exactly, the first ones take the rest.
+    size_t shard_capacity = capacity / kCacheShards + (i < capacity % kCacheShards);
+    MutexLock(&shard->mutex);
+    if (enabled) {
+      ShardTrim(shard, shard_capacity);
+      shard->capacity = shard_capacity;
+      if (shard->bucket_count && !ShardRehash(shard)) {
+        error = kBasicCalcAllocationFail;
+      }
+    } else {
+      // Turning the cache off releases everything it holds.
+      while (shard->tail) {
+        ShardRemove(shard, shard->tail);
+      }
+      free(shard->buckets);
+      shard->buckets = NULL;
+      shard->bucket_count = 0;
+      if (capacity) {
+        shard->capacity = shard_capacity;
+      }
+    }
+    MutexUnlock(&shard->mutex);
+  }
+  return error;
+}
+
+void CALL_CONV BasicCacheGetStats(BasicCacheStats* stats) {
+  OnceCall(&cache_once, CacheInit);
+  *stats = (BasicCacheStats){.enabled = BasicCacheEnabled()};
+  for (size_t i = 0; i < kCacheShards; ++i) {
+    CacheShard* shard = shards + i;
+    MutexLock(&shard->mutex);
+    stats->hits += shard->hits;
+    stats->misses += shard->misses;
+    stats->evictions += shard->evictions;
+    stats->size += shard->size;
+    stats->capacity += shard->capacity;
+    MutexUnlock(&shard->mutex);
+  }
+}
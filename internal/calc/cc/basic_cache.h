@@ -0,0 +1,13 @@
+#ifndef SMARTCALC_INTERNAL_CALC_CC_CORE_BASIC_CACHE_H_
+#define SMARTCALC_INTERNAL_CALC_CC_CORE_BASIC_CACHE_H_
+
+#include "basic_calc.h"
+
+#include <stdbool.h>
+
+extern bool BasicCacheEnabled(void);
+// Evaluates math_expr through the cache. Returns false when the expression
+// does not compile, the uncached path then reports the exact error.
+extern bool BasicCacheEval(const char* math_expr, bool allow_x, double x, double* res, BasicCalcError* error);
+
+#endif // SMARTCALC_INTERNAL_CALC_CC_CORE_BASIC_CACHE_H_
@@ -1,12 +1,16 @@
 #include "basic_calc.h"
-#include "util/str_util.h"
+#include "basic_cache.h"
+#include "basic_jit.h"
+#include "basic_program.h"
+#include "basic_token.h"
+#include "util/counters.h"
 #include "util/stack.h"
 
 #include <ctype.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <math.h>
-#include <float.h>
+#include <string.h>
 
 static double UnaryMinusFunction(double num) {
   return -num;
@@ -29,506 +33,534 @@ static double MultiplyFunction(double num1, double num2) {
 }
 
 static double DivisionFunction(double num1, double num2) {
-  if (num2 == 0) {
-    return DBL_MAX;
-  }
-  return num1 / num2;
+  return BasicDivide(num1, num2);
 }
 
 static double FmodFunction(double num1, double num2) {
-  if (num2 == 0) {
-    return DBL_MIN;
-  }
-  return fmod(num1, num2);
-}
-
-enum MathOperationIdx {
-  kUnaryMinus = 0,
-  kUnaryPlus,
-  kSqrt,
-  kSin,
-  kCos,
-  kTan,
-  kAsin,
-  kAcos,
-  kAtan,
-  kLn,
-  kLog,
-  kPower,
-  kMultiply,
-  kDivision,
-  kFmod,
-  kPlus,
-  kMinus,
-  kOpenBrace
-};
+  return BasicFmod(num1, num2);
+}
 
 static const MathOperation op_map[] = {
-    {.type = kUnary,
+    {.idx = kUnaryMinus,
+     .type = kUnary,
      .priority = kSign,
      .function = { .unary = UnaryMinusFunction }},
-    {.type = kUnary,
+    {.idx = kUnaryPlus,
+     .type = kUnary,
      .priority = kSign,
      .function = { .unary = UnaryPlusFunction }},
-    {.type = kUnary,
+    {.idx = kSqrt,
+     .type = kUnary,
      .priority = kFunction,
      .function = { .unary = sqrt }},
-    {.type = kUnary,
+    {.idx = kSin,
+     .type = kUnary,
      .priority = kFunction,
      .function = { .unary = sin }},
-    {.type = kUnary,
+    {.idx = kCos,
+     .type = kUnary,
      .priority = kFunction,
      .function = { .unary = cos }},
-    {.type = kUnary,
+    {.idx = kTan,
+     .type = kUnary,
      .priority = kFunction,
      .function = { .unary = tan }},
-    {.type = kUnary,
+    {.idx = kAsin,
+     .type = kUnary,
      .priority = kFunction,
      .function = { .unary = asin }},
-    {.type = kUnary,
+    {.idx = kAcos,
+     .type = kUnary,
      .priority = kFunction,
      .function = { .unary = acos }},
-    {.type = kUnary,
+    {.idx = kAtan,
+     .type = kUnary,
      .priority = kFunction,
      .function = { .unary = atan }},
-    {.type = kUnary,
+    {.idx = kLn,
+     .type = kUnary,
      .priority = kFunction,
      .function = { .unary = log }},
-    {.type = kUnary,
+    {.idx = kLog,
+     .type = kUnary,
      .priority = kFunction,
      .function = { .unary = log10 }},
-    {.type = kBinary,
-     .priority = kFunction,
+    {.idx = kPower,
+     .type = kBinary,
+     .priority = kExponent,
      .function = { .binary = pow }},
-    {.type = kBinary,
+    {.idx = kMultiply,
+     .type = kBinary,
      .priority = kComplex,
      .function = { .binary = MultiplyFunction }},
-    {.type = kBinary,
+    {.idx = kDivision,
+     .type = kBinary,
      .priority = kComplex,
      .function = { .binary = DivisionFunction }},
-    {.type = kBinary,
+    {.idx = kFmod,
+     .type = kBinary,
      .priority = kComplex,
      .function = { .binary = FmodFunction }},
-    {.type = kBinary,
+    {.idx = kPlus,
+     .type = kBinary,
      .priority = kSimple,
      .function = { .binary = BinaryPlusFunction }},
-    {.type = kBinary,
+    {.idx = kMinus,
+     .type = kBinary,
      .priority = kSimple,
      .function = { .binary = BinaryMinusFunction }},
-    {.type = kUnary,
+    {.idx = kOpenBrace,
+     .type = kUnary,
      .priority = kBrace}
 };
 
-static BasicCalcError FindOperation(char op, bool prev_was_num, MathOperation* operation) {
-  switch (op) {
-    case '^':
-      if (!prev_was_num) {
-        return kBasicCalcErrorIncorrectOperatorUsage;
-      }
-      *operation = op_map[kPower];
-      break;
-    case '*':
-      if (!prev_was_num) {
-        return kBasicCalcErrorIncorrectOperatorUsage;
-      }
-      *operation = op_map[kMultiply];
-      break;
-    case '/':
-      if (!prev_was_num) {
-        return kBasicCalcErrorIncorrectOperatorUsage;
-      }
-      *operation = op_map[kDivision];
-      break;
-    case 'd':
-      if (!prev_was_num) {
-        return kBasicCalcErrorIncorrectOperatorUsage;
-      }
-      *operation = op_map[kFmod];
-      break;
-    case '+':
-      if (prev_was_num) {
-        *operation = op_map[kPlus];
-      } else {
-        *operation = op_map[kUnaryPlus];
-      }
-      break;
-    case '-':
-      if (prev_was_num) {
-        *operation = op_map[kMinus];
-      } else {
-        *operation = op_map[kUnaryMinus];
-      }
-      break;
-    default:
-      return kBasicCalcErrorIncorrectOperatorUsage;
-  }
-  return kBasicCalcErrorSuccess;
+enum { kCompilerBufSize = 64 };
+
+// Instructions are emitted into buf and only moved to the heap when the
+// expression is too long for it.
+typedef struct {
+  BasicInstr* heap;
+  size_t size;
+  size_t cap;
+  size_t depth;
+  size_t max_depth;
+  size_t vars;
+  size_t tokens;
+  BasicInstr buf[kCompilerBufSize];
+} BasicCompiler;
+
+static inline BasicInstr* CompilerInstrs(BasicCompiler* compiler) {
+  return compiler->heap ? compiler->heap : compiler->buf;
 }
 
-static BasicCalcError FindFunction(char** ptr_ptr, MathOperation* operation) {
-  int is_arc = 0;
-  char *ptr = *ptr_ptr;
-  if (*ptr == 'a') {
-    is_arc = 1;
-    ++ptr;
+static bool CompilerGrow(BasicCompiler* compiler) {
+  size_t cap = compiler->cap * 2;
+  BasicInstr* heap = (BasicInstr*)CountersRealloc(compiler->heap, cap * sizeof(BasicInstr));
+  if (!heap) {
+    return false;
   }
-  switch (*ptr) {
-    case 'c':
-      if (ptr[1] != 'o' || ptr[2] != 's' || ptr[3] != '(') {
-        return kBasicCalcErrorIncorrectFunctionUsage;
-      }
-      *ptr_ptr = ptr + 4;
-      if (is_arc) {
-        *operation = op_map[kAcos];
-      } else {
-        *operation = op_map[kCos];
-      }
-      break;
-    case 's':
-      if (ptr[1] == 'q') {
-        if (ptr[2] != 'r' || ptr[3] != 't' || ptr[4] != '(') {
-          return kBasicCalcErrorIncorrectFunctionUsage;
-        }
-        *ptr_ptr = ptr + 5;
-        *operation = op_map[kSqrt];
-      } else if (ptr[1] == 'i') {
-        if (ptr[2] != 'n' || ptr[3] != '(') {
-          return kBasicCalcErrorIncorrectFunctionUsage;
-        }
-        *ptr_ptr = ptr + 4;
-        if (is_arc) {
-          *operation = op_map[kAsin];
-        } else {
-          *operation = op_map[kSin];
-        }
-      } else {
-        return kBasicCalcErrorIncorrectFunctionUsage;
-      }
-      break;
-    case 't':
-      if (ptr[1] != 'a' || ptr[2] != 'n' || ptr[3] != '(') {
-        return kBasicCalcErrorIncorrectFunctionUsage;
-      }
-      *ptr_ptr = ptr + 4;
-      if (is_arc) {
-        *operation = op_map[kAtan];
-      } else {
-        *operation = op_map[kTan];
-      }
-      break;
-    case 'l':
-      if (is_arc) {
-        return kBasicCalcErrorIncorrectFunctionUsage;
-      }
-      if (ptr[1] == 'n') {
-        if (ptr[2] != '(') {
-          return kBasicCalcErrorIncorrectFunctionUsage;
-        }
-        *ptr_ptr = ptr + 3;
-        *operation = op_map[kLn];
-      } else if (ptr[1] == 'o') {
-        if (ptr[2] != 'g' || ptr[3] != '(') {
-          return kBasicCalcErrorIncorrectFunctionUsage;
-        }
-        *ptr_ptr = ptr + 4;
-        *operation = op_map[kLog];
-      } else {
-        return kBasicCalcErrorIncorrectFunctionUsage;
-      }
-      break;
-    default:
-      return kBasicCalcErrorIncorrectFunctionUsage;
+  if (!compiler->heap) {
+    memcpy(heap, compiler->buf, compiler->size * sizeof(BasicInstr));
   }
+  compiler->heap = heap;
+  compiler->cap = cap;
+  return true;
+}
+
+static BasicCalcError EmitInstr(BasicCompiler* compiler, BasicInstr instr) {
+  if (compiler->size == compiler->cap && !CompilerGrow(compiler)) {
+    return kBasicCalcAllocationFail;
+  }
+  CompilerInstrs(compiler)[compiler->size++] = instr;
   return kBasicCalcErrorSuccess;
 }
 
-static BasicCalcError ShuntYardAlgo(StackDouble** num_stack, StackOperation** op_stack) {
-  MathOperation op = StackPop(op_stack);
-  if (!*op_stack) {
-    return kBasicCalcErrorInvalidSyntax;
+static BasicCalcError EmitOperand(BasicCompiler* compiler, BasicInstr instr) {
+  if (++compiler->depth > compiler->max_depth) {
+    compiler->max_depth = compiler->depth;
   }
-  double num1 = StackPop(num_stack);
-  if (!*num_stack) {
+  return EmitInstr(compiler, instr);
+}
+
+static BasicCalcError ShuntYardAlgo(BasicCompiler* compiler, StackOperation* op_stack) {
+  MathOperation op = StackPop(op_stack);
+  if (compiler->depth == 0) {
     return kBasicCalcErrorInvalidSyntax;
   }
   if (op.priority == kBrace) {
     return kBasicCalcErrorBracesNotMatching;
   }
-  double res;
-  if (op.type == kUnary) {
-    res = op.function.unary(num1);
-  } else {
-    double num2 = StackPop(num_stack);
-    if (!*num_stack) {
+  if (op.type == kBinary) {
+    if (compiler->depth < 2) {
       return kBasicCalcErrorInvalidSyntax;
     }
-    res = op.function.binary(num2, num1);
+    --compiler->depth;
   }
-  *num_stack = StackPush(*num_stack, res);
-  if (!*num_stack) {
-    return kBasicCalcAllocationFail;
-  }
-  return kBasicCalcErrorSuccess;
+  return EmitInstr(compiler, (BasicInstr){.type = kBasicInstrOperation, .op = op.idx});
 }
 
-static BasicCalcError ShuntYardBrace(StackDouble** num_stack, StackOperation** op_stack) {
-  while ((*op_stack)->size && (*op_stack)->top.priority != kBrace) {
-    BasicCalcError error = ShuntYardAlgo(num_stack, op_stack);
+static BasicCalcError ShuntYardBrace(BasicCompiler* compiler, StackOperation* op_stack) {
+  while (op_stack->size && StackTop(op_stack).priority != kBrace) {
+    BasicCalcError error = ShuntYardAlgo(compiler, op_stack);
     if (error != kBasicCalcErrorSuccess) {
       return error;
     }
   }
-  if ((*op_stack)->size == 0) {
+  if (op_stack->size == 0) {
     return kBasicCalcErrorBracesNotMatching;
   }
   StackPop(op_stack);
   return kBasicCalcErrorSuccess;
 }
 
-static BasicCalcError ShuntYardOperation(const MathOperation* op, StackDouble** num_stack, StackOperation** op_stack) {
-  while ((*op_stack)->size && op->priority <= (*op_stack)->top.priority) {
-    BasicCalcError error = ShuntYardAlgo(num_stack, op_stack);
+static BasicCalcError ShuntYardOperation(const MathOperation* op, BasicCompiler* compiler, StackOperation* op_stack) {
+  while (op_stack->size) {
+    MathOperation top = StackTop(op_stack);
+    if (!BasicReducesBefore(op, &top)) {
+      break;
+    }
+    BasicCalcError error = ShuntYardAlgo(compiler, op_stack);
     if (error != kBasicCalcErrorSuccess) {
       return error;
     }
   }
-  *op_stack = StackPush(*op_stack, *op);
-  if (!*op_stack) {
+  if (!StackPush(op_stack, *op)) {
     return kBasicCalcAllocationFail;
   }
   return kBasicCalcErrorSuccess;
 }
 
-static char* ClosedBraceNext(char* ptr) {
-  for (; *ptr && *ptr != ')'; ++ptr)
-    ;
-  for (; *ptr == ')'; ++ptr)
-    ;
-  return ptr;
+static inline BasicCalcError ProcessBrace(StackOperation* op_stack) {
+  if (!StackPush(op_stack, op_map[kOpenBrace])) {
+    return kBasicCalcAllocationFail;
+  }
+  return kBasicCalcErrorSuccess;
 }
 
-static inline bool PowExprAcceptable(char ch) {
-  return isalnum(ch) || isspace(ch) || ch == '^' || ch == '(' || ch == '.';
+static inline BasicCalcError ProcessFunction(enum MathOperationIdx function, StackOperation* op_stack) {
+  if (!StackPush(op_stack, op_map[function])) {
+    return kBasicCalcAllocationFail;
+  }
+  // The function token includes the opening brace of the argument list,
+  // so it has to be pushed here for the matching ')' to close the call.
+  return ProcessBrace(op_stack);
 }
 
-static BasicCalcError FixPower(char** ptr_ptr, char** expr) {
-  char* ptr = *ptr_ptr;
-  char* start = ptr + 1;
-  bool has_pow = false;
-  while (PowExprAcceptable(*ptr)) {
-    if (*ptr == '^') {
-      has_pow = true;
-    } else if (*ptr == '(') {
-      ptr = ClosedBraceNext(ptr);
-      continue;
-    }
-    ++ptr;
-  }
-  if (has_pow) {
-    size_t idx1 = start - *expr;
-    size_t idx2 = ptr - *expr + 1;
-    *expr = StrInsert(*expr, "(", idx1);
-    if (!*expr) {
-      return kBasicCalcAllocationFail;
+// isspace of the C locale, whatever the locale of the process.
+static inline bool IsSpace(char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline bool IsNameStart(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static inline bool IsNameChar(char c) {
+  return IsNameStart(c) || (c >= '0' && c <= '9');
+}
+
+static BasicCalcError CheckXUsage(const char* expr) {
+  char prev = '\0';
+  for (const char* ptr = expr; *ptr; ++ptr) {
+    if (*ptr == 'x' && (isdigit(prev) || prev == 'x')) {
+      return kBasicCalcErrorInvalidXExpr;
     }
-    *expr = StrInsert(*expr, ")", idx2);
-    if (!*expr) {
-      return kBasicCalcAllocationFail;
+    if (!IsSpace(*ptr)) {
+      prev = *ptr;
     }
-    *ptr_ptr = *expr + idx1 - 1;
-  } else {
-    *ptr_ptr = start - 1;
   }
   return kBasicCalcErrorSuccess;
 }
 
-static inline BasicCalcError ProcessOperation(char** ptr_ptr,
-                                              char** expr,
-                                              bool prev_was_num,
-                                              StackDouble** num_stack,
-                                              StackOperation** op_stack) {
-  if (**ptr_ptr == '^') {
-    BasicCalcError error = FixPower(ptr_ptr, expr);
+enum { kCompilerTokenChunk = 64 };
+
+static inline BasicCalcError CompileToken(const BasicToken* token, BasicCompiler* compiler, StackOperation* op_stack) {
+  switch (token->type) {
+    case kBasicTokenNumber:
+      return EmitOperand(compiler, (BasicInstr){.type = kBasicInstrNumber, .number = token->number});
+    case kBasicTokenVariable:
+      return EmitOperand(compiler, (BasicInstr){.type = kBasicInstrVariable, .slot = token->slot});
+    case kBasicTokenOperator:
+      return ShuntYardOperation(op_map + token->op, compiler, op_stack);
+    case kBasicTokenFunction:
+      return ProcessFunction(token->function, op_stack);
+    case kBasicTokenOpenBrace:
+      return ProcessBrace(op_stack);
+    case kBasicTokenCloseBrace:
+      return ShuntYardBrace(compiler, op_stack);
+    case kBasicTokenError:
+      return token->error;
+  }
+  return kBasicCalcErrorInvalidExpr;
+}
+
+// Tokens are read a chunk at a time, so the lexer runs its tight loop
+// over many characters before the parser touches the stacks.
+static BasicCalcError Compile(const char* math_expr,
+                              bool allow_x,
+                              const BasicVarNames* vars,
+                              BasicCompiler* compiler,
+                              StackOperation* op_stack) {
+  BasicCalcError error;
+  BasicLexer lexer = BasicLexerNew(math_expr, allow_x, vars);
+  BasicToken tokens[kCompilerTokenChunk];
+  size_t size;
+
+  do {
+    size = BasicLex(&lexer, tokens, kCompilerTokenChunk);
+    compiler->tokens += size;
+    for (size_t i = 0; i < size; ++i) {
+      error = CompileToken(tokens + i, compiler, op_stack);
+      if (error != kBasicCalcErrorSuccess) {
+        return error;
+      }
+    }
+  } while (size == kCompilerTokenChunk);
+  while (op_stack->size) {
+    error = ShuntYardAlgo(compiler, op_stack);
     if (error != kBasicCalcErrorSuccess) {
       return error;
     }
   }
-  MathOperation op;
-  BasicCalcError error = FindOperation(**ptr_ptr, prev_was_num, &op);
-  if (error != kBasicCalcErrorSuccess) {
-    return error;
+  if (compiler->depth != 1) {
+    return kBasicCalcErrorInvalidExpr;
   }
-  return ShuntYardOperation(&op, num_stack, op_stack);
+  return kBasicCalcErrorSuccess;
 }
 
-static inline BasicCalcError ProcessFunction(char** ptr_ptr, StackOperation** op_stack) {
-  MathOperation function;
-  BasicCalcError error = FindFunction(ptr_ptr, &function);
-  if (error != kBasicCalcErrorSuccess) {
-    return error;
+// Without vars, x is the only variable and only when allow_x is set.
+// clock holds the start of the compile phase from CountersStart and gets
+// its end.
+static BasicCalcError CompilerRun(const char* math_expr,
+                                  bool allow_x,
+                                  const BasicVarNames* vars,
+                                  BasicCompiler* compiler,
+                                  uint64_t* clock) {
+  *compiler = (BasicCompiler){.cap = kCompilerBufSize, .vars = vars ? vars->size : allow_x};
+  BasicCalcError error = kBasicCalcErrorSuccess;
+  if (vars) {
+    allow_x = false;
+  } else if (allow_x) {
+    error = CheckXUsage(math_expr);
   }
-  *op_stack = StackPush(*op_stack, function);
-  if (!*op_stack) {
-    return kBasicCalcAllocationFail;
+  if (error == kBasicCalcErrorSuccess) {
+    StackOperation op_stack = StackNew(MathOperation);
+    error = Compile(math_expr, allow_x, vars, compiler, &op_stack);
+    StackDelete(&op_stack);
   }
-  return kBasicCalcErrorSuccess;
+  *clock = CountersEnd(kCalcStatsPhaseCompile, *clock, error, compiler->tokens);
+  return error;
+}
+
+static inline BasicProgram CompilerProgram(BasicCompiler* compiler) {
+  return (BasicProgram){
+    .instrs = CompilerInstrs(compiler),
+    .size = compiler->size,
+    .depth = compiler->max_depth,
+    .vars = compiler->vars
+  };
 }
 
-static inline BasicCalcError ProcessNumber(char** expr, StackDouble** num_stack) {
-  char* ptr = *expr;
-  char* end = NULL;
-  double num = strtod(ptr, &end);
-  if (ptr == end) {
-    return kBasicCalcErrorIncorrectNumberUsage;
+static inline void CompilerDestroy(BasicCompiler* compiler) {
+  free(compiler->heap);
+  compiler->heap = NULL;
+}
+
+BasicCalcError BasicProgramInit(const char* math_expr, bool allow_x, BasicProgram* program) {
+  BasicCompiler compiler;
+  uint64_t clock = CountersStart();
+  BasicCalcError error = CompilerRun(math_expr, allow_x, NULL, &compiler, &clock);
+  if (error == kBasicCalcErrorSuccess) {
+    *program = CompilerProgram(&compiler);
+    program->instrs = (BasicInstr*)CountersMalloc(program->size * sizeof(BasicInstr));
+    if (program->instrs) {
+      memcpy(program->instrs, CompilerInstrs(&compiler), program->size * sizeof(BasicInstr));
+    } else {
+      error = kBasicCalcAllocationFail;
+    }
   }
-  *num_stack = StackPush(*num_stack, num);
-  if (!*num_stack) {
-    return kBasicCalcAllocationFail;
+  CompilerDestroy(&compiler);
+  return error;
+}
+
+void BasicProgramDestroy(BasicProgram* program) {
+  free(program->instrs);
+  *program = (BasicProgram){0};
+}
+
+const MathOperation* BasicOperationGet(enum MathOperationIdx op) {
+  return op_map + op;
+}
+
+double BasicOperationApply(enum MathOperationIdx op, double lhs, double rhs) {
+  if (op_map[op].type == kUnary) {
+    return op_map[op].function.unary(rhs);
   }
-  *expr = end;
-  return kBasicCalcErrorSuccess;
+  return op_map[op].function.binary(lhs, rhs);
 }
 
-static BasicCalcError ReplaceXInString(char** expr, const char* number) {
-  char* ptr = *expr;
-  char prev = '\0';
-  for (;*ptr; ++ptr) {
-    if (*ptr == 'x') {
-      if (ptr != *expr && (isdigit(prev) || prev == 'x')) {
-        return kBasicCalcErrorInvalidXExpr;
-      }
-      *ptr = ' ';
-      size_t idx = ptr - *expr;
-      *expr = StrInsert(*expr, number, idx);
-      if (!*expr) {
-        return kBasicCalcAllocationFail;
-      }
-      ptr = *expr + idx;
+enum { kEvalBufSize = 64 };
+
+// Programs without code of their own, as in BasicCalculate, are
+// translated for this evaluation only. Temp slots sit at the bottom of
+// the value stack.
+static BasicCalcError ProgramEval(const BasicProgram* program, const double* vars, double* res) {
+  size_t code_cap = program->code ? 0 : program->size + 1;
+  size_t stack_size = program->temps + program->depth;
+  BasicCode code_buf[kEvalBufSize];
+  double stack_buf[kEvalBufSize];
+  BasicCode* code = program->code ? program->code : code_buf;
+  double* stack = stack_buf;
+  void* heap = NULL;
+  if (code_cap > kEvalBufSize || stack_size > kEvalBufSize) {
+    heap = CountersMalloc(code_cap * sizeof(BasicCode) + stack_size * sizeof(double));
+    if (!heap) {
+      return kBasicCalcAllocationFail;
     }
-    if (!isspace(*ptr)) {
-      prev = *ptr;
+    if (code_cap) {
+      code = (BasicCode*)heap;
     }
+    stack = (double*)((BasicCode*)heap + code_cap);
+  }
+  if (code_cap) {
+    BasicInterpTranslate(program->instrs, program->size, code);
   }
+  *res = BasicInterpRun(code, vars, stack, program->temps);
+  free(heap);
   return kBasicCalcErrorSuccess;
 }
 
-BasicCalcError CALL_CONV BasicCalculateExpr(const char* math_expr, double* res) {
-  BasicCalcError error = kBasicCalcErrorSuccess;
-  char* expr = StrDup(math_expr);
-  if (!expr) {
-    return kBasicCalcAllocationFail;
+static BasicCalcError CompileHandle(const char* math_expr, const BasicVarNames* vars, BasicProgram** program) {
+  BasicCompiler compiler;
+  uint64_t clock = CountersStart();
+  BasicCalcError error = CompilerRun(math_expr, true, vars, &compiler, &clock);
+  if (error == kBasicCalcErrorSuccess) {
+    // The handle, its jit state, its instructions and its bytecode share a
+    // single allocation.
+    BasicProgram* new_program = (BasicProgram*)CountersMalloc(sizeof(BasicProgram) +
+                                                      sizeof(BasicJitState) +
+                                                      compiler.size * sizeof(BasicInstr) +
+                                                      (compiler.size + 1) * sizeof(BasicCode));
+    if (new_program) {
+      *new_program = CompilerProgram(&compiler);
+      new_program->jit = (BasicJitState*)(new_program + 1);
+      atomic_init(&new_program->jit->evals, 0);
+      atomic_init(&new_program->jit->code, NULL);
+      new_program->instrs = (BasicInstr*)(new_program->jit + 1);
+      memcpy(new_program->instrs, CompilerInstrs(&compiler), compiler.size * sizeof(BasicInstr));
+      new_program->code = (BasicCode*)(new_program->instrs + compiler.size);
+      BasicInterpTranslate(new_program->instrs, compiler.size, new_program->code);
+      *program = new_program;
+    } else {
+      error = kBasicCalcAllocationFail;
+    }
+  }
+  CompilerDestroy(&compiler);
+  return error;
+}
+
+static bool IsReservedName(const char* name) {
+  static const char* const kReserved[] = {
+    "mod", "sqrt", "sin", "cos", "tan", "asin", "acos", "atan", "ln", "log"
+  };
+  for (size_t i = 0; i < sizeof(kReserved) / sizeof(*kReserved); ++i) {
+    if (strcmp(name, kReserved[i]) == 0) {
+      return true;
+    }
   }
-  char* ptr = expr;
-  bool prev_was_num = false;
+  return false;
+}
 
-  StackDouble* num_stack = StackNew(double);
-  if (!num_stack) {
-    return kBasicCalcAllocationFail;
+static bool IsValidName(const char* const* names, size_t idx) {
+  const char* name = names[idx];
+  if (!name || !IsNameStart(*name) || IsReservedName(name)) {
+    return false;
   }
-  StackOperation* op_stack = StackNew(MathOperation);
-  if (!op_stack) {
-    error = kBasicCalcAllocationFail;
-    goto cleanup;
-  }
-  while(*ptr) {
-    switch (*ptr) {
-      case ' ':
-      case '\n':
-      case '\t':
-        break;
-      case 'm':
-        if (ptr[1] != 'o' || ptr[2] != 'd') {
-          error = kBasicCalcErrorIncorrectFunctionUsage;
-          goto cleanup;
-        }
-        ptr += 2;
-        /* fallthrough */
-      case '^':
-      case '+':
-      case '-':
-      case '*':
-      case '/':
-        error = ProcessOperation(&ptr, &expr,
-                                 prev_was_num,
-                                 &num_stack,
-                                 &op_stack);
-        if (error != kBasicCalcErrorSuccess) {
-          goto cleanup;
-        }
-        prev_was_num = false;
-        break;
-      case '(':
-        op_stack = StackPush(op_stack, op_map[kOpenBrace]);
-        if (!op_stack) {
-          error = kBasicCalcAllocationFail;
-          goto cleanup;
-        }
-        break;
-      case ')':
-        error = ShuntYardBrace(&num_stack, &op_stack);
-        if (error != kBasicCalcErrorSuccess) {
-          goto cleanup;
-        }
-        break;
-      case '0':
-      case '1':
-      case '2':
-      case '3':
-      case '4':
-      case '5':
-      case '6':
-      case '7':
-      case '8':
-      case '9':
-        error = ProcessNumber(&ptr, &num_stack);
-        if (error != kBasicCalcErrorSuccess) {
-          goto cleanup;
-        } 
-        prev_was_num = true;
-        continue;
-      case 'a':
-      case 's':
-      case 'c':
-      case 't':
-      case 'l':
-        error = ProcessFunction(&ptr, &op_stack);
-        if (error != kBasicCalcErrorSuccess) {
-          goto cleanup;
-        }
-        continue;
-      default:
-        error = kBasicCalcErrorInvalidExpr;
-        goto cleanup;
+  for (const char* ptr = name; *ptr; ++ptr) {
+    if (!IsNameChar(*ptr)) {
+      return false;
     }
-    ++ptr;
   }
-  while (op_stack->size) {
-    error = ShuntYardAlgo(&num_stack, &op_stack);
-    if (error != kBasicCalcErrorSuccess) {
-      goto cleanup;
+  for (size_t i = 0; i < idx; ++i) {
+    if (strcmp(names[i], name) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+BasicCalcError CALL_CONV BasicCompileExpr(const char* math_expr, BasicProgram** program) {
+  return CompileHandle(math_expr, NULL, program);
+}
+
+BasicCalcError CALL_CONV BasicCompileVars(const char* math_expr,
+                                          const char* const* names,
+                                          size_t size,
+                                          BasicProgram** program) {
+  for (size_t i = 0; i < size; ++i) {
+    if (!IsValidName(names, i)) {
+      return kBasicCalcErrorInvalidArgument;
     }
   }
-  if (num_stack->size != 1) {
-    error = kBasicCalcErrorInvalidExpr;
-  } else {
-    *res = num_stack->top;
+  BasicVarNames vars = {.names = names, .size = size};
+  return CompileHandle(math_expr, &vars, program);
+}
+
+BasicCalcError CALL_CONV BasicProgramEvalVars(const BasicProgram* program, const double* values, double* res) {
+  uint64_t start = CountersStart();
+  BasicCalcError error = kBasicCalcErrorSuccess;
+  if (!BasicJitTryEval(program, values, res)) {
+    error = ProgramEval(program, values, res);
   }
-cleanup:
-  StackDelete(num_stack);
-  StackDelete(op_stack);
-  free(expr);
+  CountersEnd(kCalcStatsPhaseEval, start, error, program->size);
   return error;
 }
 
-BasicCalcError CALL_CONV BasicCalculateEquation(const char* math_expr, const char* x, double* res) {
-  char* expr = StrDup(math_expr);
-  if (!expr) {
-    return kBasicCalcAllocationFail;
+BasicCalcError CALL_CONV BasicProgramEval(const BasicProgram* program, double x, double* res) {
+  if (program->vars > 1) {
+    return kBasicCalcErrorInvalidArgument;
   }
-  BasicCalcError error = ReplaceXInString(&expr, x);
+  return BasicProgramEvalVars(program, &x, res);
+}
+
+void CALL_CONV BasicProgramFree(BasicProgram* program) {
+  if (!program) {
+    return;
+  }
+  BasicJitStateDestroy(program->jit);
+  free(program);
+}
+
+BasicCalcError BasicCalculate(const char* math_expr, bool allow_x, double x, double* res) {
+  BasicCalcError error;
+  uint64_t start = CountersStart();
+  if (BasicCacheEnabled() && BasicCacheEval(math_expr, allow_x, x, res, &error)) {
+    CountersEnd(kCalcStatsPhaseCalculate, start, error, 1);
+    return error;
+  }
+  // Each phase starts where the one before it ended, clock reads are
+  // most of what counting costs.
+  BasicCompiler compiler;
+  uint64_t clock = start;
+  error = CompilerRun(math_expr, allow_x, NULL, &compiler, &clock);
   if (error == kBasicCalcErrorSuccess) {
-    error = BasicCalculateExpr(expr, res);
+    BasicProgram program = CompilerProgram(&compiler);
+    error = ProgramEval(&program, &x, res);
+    clock = CountersEnd(kCalcStatsPhaseEval, clock, error, program.size);
   }
-  free(expr);
+  CompilerDestroy(&compiler);
+  CountersEndAt(kCalcStatsPhaseCalculate, start, clock, error, 0);
   return error;
+}
+
+BasicCalcError CALL_CONV BasicCalculateExpr(const char* math_expr, double* res) {
+  return BasicCalculate(math_expr, false, 0.0, res);
+}
+
+// Reads x as the lexer reads a number in the expression, with an optional
+// sign in front, so inf, nan and other names stay invalid.
+static bool ReadX(const char* x, double* x_val) {
+  BasicLexer lexer = BasicLexerNew(x, false, NULL);
+  BasicToken tokens[3];
+  size_t size = BasicLex(&lexer, tokens, 3);
+  double sign = 1.0;
+  if (size == 2 && tokens[0].type == kBasicTokenOperator &&
+      (tokens[0].op == kUnaryMinus || tokens[0].op == kUnaryPlus)) {
+    sign = tokens[0].op == kUnaryMinus ? -1.0 : 1.0;
+    tokens[0] = tokens[1];
+    --size;
+  }
+  if (size != 1 || tokens[0].type != kBasicTokenNumber || lexer.ptr != lexer.end) {
+    return false;
+  }
+  *x_val = sign * tokens[0].number;
+  return true;
+}
+
+BasicCalcError CALL_CONV BasicCalculateEquation(const char* math_expr, const char* x, double* res) {
+  double x_val = 0.0;
+  if (!ReadX(x, &x_val)) {
+    return kBasicCalcErrorInvalidXExpr;
+  }
+  return BasicCalculate(math_expr, true, x_val, res);
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 
 #include "api.h"
 
+#include <stdbool.h>
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -16,11 +19,132 @@ typedef enum {
   kBasicCalcErrorIncorrectOperatorUsage,
   kBasicCalcErrorIncorrectFunctionUsage,
   kBasicCalcErrorInvalidXExpr,
-  kBasicCalcErrorInvalidExpr
+  kBasicCalcErrorInvalidExpr,
+  kBasicCalcErrorInvalidArgument
 } BasicCalcError;
 
+typedef struct BasicProgram BasicProgram;
+typedef struct BasicEditor BasicEditor;
+
+typedef struct {
+  bool enabled;
+  size_t capacity;
+  size_t size;
+  size_t hits;
+  size_t misses;
+  size_t evictions;
+} BasicCacheStats;
+
+typedef struct {
+  double x;
+  double y;
+} BasicPoint;
+
+// From loosest to tightest: + and -, then * / and mod, then '^', which is
+// right associative, then functions and signs, so -2^2 is 4. The exponent
+// ends at mod as it does at * and /: 2^3 mod 3 is (2^3) mod 3 = 2, older
+// versions read it as 2^(3 mod 3) = 1.
 extern CALC_API BasicCalcError BasicCalculateExpr(const char* math_expr, double* res);
 extern CALC_API BasicCalcError BasicCalculateEquation(const char* math_expr, const char* x, double* res);
+// Evaluates size expressions on a thread pool, each as BasicCalculateExpr
+// would, or as BasicCalculateEquation with x[i] when x is not NULL. errors
+// may be NULL. Fails only if the batch could not run at all. The pool
+// runs one batch at a time: a batch started while another one holds it,
+// from any thread, runs on its calling thread only.
+extern CALC_API BasicCalcError BasicCalculateBatch(const char* const* math_exprs,
+                                                   const double* x,
+                                                   size_t size,
+                                                   double* res,
+                                                   BasicCalcError* errors);
+// Threads used by BasicCalculateBatch and DepositCalculateBatch, which
+// share one pool, the calling one included. 0 uses every processor, 1
+// stops the pool threads.
+extern CALC_API void BasicSetBatchThreads(size_t threads);
+
+extern CALC_API BasicCalcError BasicCompileExpr(const char* math_expr, BasicProgram** program);
+extern CALC_API BasicCalcError BasicProgramEval(const BasicProgram* program, double x, double* res);
+extern CALC_API void BasicProgramFree(BasicProgram* program);
+// Compiles math_expr with names bound to variable slots in the given order,
+// BasicProgramEvalVars then takes one value per name. Names are letters,
+// digits and '_', not starting with a digit and not a function or mod.
+extern CALC_API BasicCalcError BasicCompileVars(const char* math_expr,
+                                                const char* const* names,
+                                                size_t size,
+                                                BasicProgram** program);
+extern CALC_API BasicCalcError BasicProgramEvalVars(const BasicProgram* program, const double* values, double* res);
+// Rewrites the program in place and drops native code compiled from the
+// old one. It must not run while another thread evaluates the program.
+extern CALC_API BasicCalcError BasicProgramOptimize(BasicProgram* program, size_t* removed);
+// Program handles are compiled to native code after threshold evaluations,
+// where the platform supports it. 0 keeps every handle interpreted.
+extern CALC_API void BasicSetJitThreshold(size_t threshold);
+
+// Caches compiled programs, and final values of expressions without x,
+// keyed by the expression with insignificant whitespace dropped. Off by
+// default, a zero capacity turns it off. The capacity bounds the whole
+// cache. It is split over 16 shards by key hash, so a capacity below 16
+// leaves the keys of some shards uncached.
+extern CALC_API BasicCalcError BasicCacheConfigure(bool enabled, size_t capacity);
+extern CALC_API void BasicCacheGetStats(BasicCacheStats* stats);
+
+// Finds up to max_roots roots of math_expr = 0 in [x_min, x_max], in
+// ascending order. The interval is scanned for sign changes and each one
+// is refined by Newton steps on the derivative, falling back to bisection.
+extern CALC_API BasicCalcError BasicSolveEquation(const char* math_expr,
+                                                  double x_min,
+                                                  double x_max,
+                                                  double tolerance,
+                                                  double* roots,
+                                                  size_t max_roots,
+                                                  size_t* count);
+
+// Samples math_expr over [x_min, x_max] for a plot pixel_width pixels wide,
+// refining where the curve bends by more than half a pixel of the y viewport
+// spread over the same pixel count. Discontinuities and points outside the
+// domain are emitted as a single break point with NaN coordinates. count
+// receives the full polyline size, only the first max_points are written.
+extern CALC_API BasicCalcError BasicSampleCurve(const char* math_expr,
+                                                double x_min,
+                                                double x_max,
+                                                double y_min,
+                                                double y_max,
+                                                size_t pixel_width,
+                                                BasicPoint* points,
+                                                size_t max_points,
+                                                size_t* count);
+
+extern CALC_API BasicCalcError BasicProgramEvalRange(const BasicProgram* program,
+                                                     const double* x,
+                                                     size_t size,
+                                                     double* res);
+extern CALC_API BasicCalcError BasicEvaluateRange(const char* math_expr,
+                                                  const double* x,
+                                                  size_t size,
+                                                  double* res,
+                                                  BasicCalcError* errors);
+extern CALC_API BasicCalcError BasicEvaluateLinspace(const char* math_expr,
+                                                     double x_start,
+                                                     double x_step,
+                                                     size_t size,
+                                                     double* res,
+                                                     BasicCalcError* errors);
+
+// Holds an expression being edited together with its parse, so that an
+// edit only reads the tokens around it again and recomputes the
+// operations above them. Results are those of BasicCalculateExpr on the
+// whole text. A new editor holds an empty text.
+extern CALC_API BasicCalcError BasicEditorNew(BasicEditor** editor);
+// Replaces removed bytes at pos with size bytes of text and returns what
+// the new text evaluates to. The text is left as it was on
+// kBasicCalcErrorInvalidArgument, for a range outside of it or a '\0' in
+// text, and on kBasicCalcAllocationFail.
+extern CALC_API BasicCalcError BasicEditorReplace(BasicEditor* editor,
+                                                  size_t pos,
+                                                  size_t removed,
+                                                  const char* text,
+                                                  size_t size,
+                                                  double* res);
+extern CALC_API void BasicEditorFree(BasicEditor* editor);
 
 #ifdef __cplusplus
 } // extern "C"
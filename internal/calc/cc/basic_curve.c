@@ -0,0 +1,256 @@
+#include "basic_calc.h"
+#include "basic_program.h"
+#include "util/counters.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+// The first pass samples every kCurveSpacing pixels, intervals are then
+// halved down to 1 / 2^kCurveSubPixelLevels of a pixel at most.
+enum { kCurveSpacing = 4, kCurveMinIntervals = 8, kCurveSubPixelLevels = 6 };
+
+static const double kCurveJumpRatio = 0.1;
+
+typedef enum {
+  kIntervalOpen,
+  kIntervalClosed,
+  kIntervalBreak
+} IntervalState;
+
+// A sample and the state of the interval to its right.
+typedef struct {
+  double x;
+  double y;
+  IntervalState right;
+} CurveSample;
+
+typedef struct {
+  double y_min;
+  double y_max;
+  double y_tolerance;
+  double min_width;
+} CurveLimits;
+
+typedef struct {
+  CurveSample* samples;
+  size_t size;
+  CurveSample* next;
+  double* mid_x;
+  double* mid_y;
+  size_t cap;
+} Curve;
+
+static inline bool IsDrawable(double y) {
+  // DivisionFunction reports a zero divisor as DBL_MAX.
+  return isfinite(y) && fabs(y) < DBL_MAX;
+}
+
+static bool CurveReserve(Curve* curve, size_t cap) {
+  if (cap <= curve->cap) {
+    return true;
+  }
+  void* block = CountersRealloc(curve->next, cap * (sizeof(CurveSample) + 2 * sizeof(double)));
+  if (!block) {
+    return false;
+  }
+  curve->next = (CurveSample*)block;
+  curve->mid_x = (double*)(curve->next + cap);
+  curve->mid_y = curve->mid_x + cap;
+  CurveSample* samples = (CurveSample*)CountersRealloc(curve->samples, cap * sizeof(CurveSample));
+  if (!samples) {
+    return false;
+  }
+  curve->samples = samples;
+  curve->cap = cap;
+  return true;
+}
+
+static void CurveDestroy(Curve* curve) {
+  free(curve->samples);
+  free(curve->next);
+  *curve = (Curve){0};
+}
+
+static inline bool OffScreen(const CurveLimits* limits, double y1, double y2, double y3) {
+  return (y1 > limits->y_max && y2 > limits->y_max && y3 > limits->y_max) ||
+         (y1 < limits->y_min && y2 < limits->y_min && y3 < limits->y_min);
+}
+
+// Decides what a probed midpoint tells about an open interval. Returns
+// true when the midpoint is kept and both halves stay open.
+static bool SplitInterval(const CurveLimits* limits, CurveSample* a, const CurveSample* mid, const CurveSample* b) {
+  bool drawable_a = IsDrawable(a->y), drawable_mid = IsDrawable(mid->y), drawable_b = IsDrawable(b->y);
+  bool can_split = mid->x - a->x >= limits->min_width;
+  if (!drawable_a && !drawable_mid && !drawable_b) {
+    a->right = kIntervalClosed;
+    return false;
+  }
+  if (drawable_a && drawable_mid && drawable_b) {
+    if (OffScreen(limits, a->y, mid->y, b->y) ||
+        fabs(mid->y - 0.5 * (a->y + b->y)) <= limits->y_tolerance) {
+      a->right = kIntervalClosed;
+      return false;
+    }
+  }
+  if (can_split) {
+    return true;
+  }
+  // Below the finest resolution a steep but continuous curve, like sqrt
+  // near 0, still has its midpoint well between the ends. A jump or a pole
+  // puts it next to one end or outside, and the curve is not drawn across.
+  if (drawable_a && drawable_mid && drawable_b) {
+    double t = (mid->y - a->y) / (b->y - a->y);
+    if (t > kCurveJumpRatio && t < 1 - kCurveJumpRatio) {
+      a->right = kIntervalClosed;
+      return false;
+    }
+  }
+  a->right = kIntervalBreak;
+  return false;
+}
+
+static BasicCalcError CurveRefine(const BasicProgram* program, const CurveLimits* limits, Curve* curve) {
+  for (;;) {
+    size_t open = 0;
+    for (size_t i = 0; i + 1 < curve->size; ++i) {
+      if (curve->samples[i].right == kIntervalOpen) {
+        curve->mid_x[open++] = 0.5 * (curve->samples[i].x + curve->samples[i + 1].x);
+      }
+    }
+    if (open == 0) {
+      return kBasicCalcErrorSuccess;
+    }
+    // Every midpoint of a level is evaluated in one columnar pass.
+    BasicCalcError error = BasicProgramEvalRange(program, curve->mid_x, open, curve->mid_y);
+    if (error != kBasicCalcErrorSuccess) {
+      return error;
+    }
+    size_t size = 0;
+    for (size_t i = 0, j = 0; i < curve->size; ++i) {
+      CurveSample sample = curve->samples[i];
+      if (sample.right != kIntervalOpen || i + 1 == curve->size) {
+        curve->next[size++] = sample;
+        continue;
+      }
+      CurveSample mid = {.x = curve->mid_x[j], .y = curve->mid_y[j], .right = kIntervalOpen};
+      ++j;
+      bool split = SplitInterval(limits, &sample, &mid, curve->samples + i + 1);
+      curve->next[size++] = sample;
+      if (split) {
+        curve->next[size++] = mid;
+      }
+    }
+    CurveSample* samples = curve->samples;
+    curve->samples = curve->next;
+    curve->next = samples;
+    curve->size = size;
+    if (!CurveReserve(curve, size * 2)) {
+      return kBasicCalcAllocationFail;
+    }
+  }
+}
+
+static inline void EmitPoint(BasicPoint* points, size_t max_points, size_t* count, double x, double y) {
+  if (*count < max_points) {
+    points[*count] = (BasicPoint){.x = x, .y = y};
+  }
+  ++*count;
+}
+
+static void CurveEmit(const Curve* curve, BasicPoint* points, size_t max_points, size_t* count) {
+  // Set while the last emitted point is a break or nothing was emitted,
+  // so breaks are never doubled and never lead or trail the polyline.
+  bool broken = true;
+  for (size_t i = 0; i < curve->size; ++i) {
+    const CurveSample* sample = curve->samples + i;
+    if (!IsDrawable(sample->y)) {
+      if (!broken) {
+        EmitPoint(points, max_points, count, NAN, NAN);
+        broken = true;
+      }
+      continue;
+    }
+    EmitPoint(points, max_points, count, sample->x, sample->y);
+    broken = false;
+    if (sample->right == kIntervalBreak && i + 1 < curve->size) {
+      EmitPoint(points, max_points, count, NAN, NAN);
+      broken = true;
+    }
+  }
+  if (*count && broken) {
+    --*count;
+  }
+}
+
+static BasicCalcError SampleProgram(const BasicProgram* program,
+                                    double x_min,
+                                    double x_max,
+                                    const CurveLimits* limits,
+                                    size_t intervals,
+                                    BasicPoint* points,
+                                    size_t max_points,
+                                    size_t* count) {
+  Curve curve = {0};
+  if (!CurveReserve(&curve, (intervals + 1) * 2)) {
+    CurveDestroy(&curve);
+    return kBasicCalcAllocationFail;
+  }
+  curve.size = intervals + 1;
+  for (size_t i = 0; i < intervals; ++i) {
+    curve.mid_x[i] = x_min + (x_max - x_min) * (double)i / (double)intervals;
+  }
+  curve.mid_x[intervals] = x_max;
+  BasicCalcError error = BasicProgramEvalRange(program, curve.mid_x, curve.size, curve.mid_y);
+  if (error == kBasicCalcErrorSuccess) {
+    for (size_t i = 0; i < curve.size; ++i) {
+      curve.samples[i] = (CurveSample){.x = curve.mid_x[i], .y = curve.mid_y[i], .right = kIntervalOpen};
+    }
+    error = CurveRefine(program, limits, &curve);
+  }
+  if (error == kBasicCalcErrorSuccess) {
+    CurveEmit(&curve, points, max_points, count);
+  }
+  CurveDestroy(&curve);
+  return error;
+}
+
+BasicCalcError CALL_CONV BasicSampleCurve(const char* math_expr,
+                                          double x_min,
+                                          double x_max,
+                                          double y_min,
+                                          double y_max,
+                                          size_t pixel_width,
+                                          BasicPoint* points,
+                                          size_t max_points,
+                                          size_t* count) {
+  *count = 0;
+  if (!isfinite(x_min) || !isfinite(x_max) || !(x_min < x_max) ||
+      !isfinite(y_min) || !isfinite(y_max) || !(y_min < y_max) || pixel_width == 0) {
+    return kBasicCalcErrorInvalidArgument;
+  }
+  double x_pixel = (x_max - x_min) / (double)pixel_width;
+  double y_pixel = (y_max - y_min) / (double)pixel_width;
+  CurveLimits limits = {
+    .y_min = y_min,
+    .y_max = y_max,
+    .y_tolerance = 0.5 * y_pixel,
+    .min_width = ldexp(x_pixel, -kCurveSubPixelLevels)
+  };
+  size_t intervals = pixel_width / kCurveSpacing;
+  if (intervals < kCurveMinIntervals) {
+    intervals = kCurveMinIntervals;
+  }
+  BasicProgram program;
+  BasicCalcError error = BasicProgramInit(math_expr, true, &program);
+  if (error != kBasicCalcErrorSuccess) {
+    return error;
+  }
+  error = BasicProgramOptimize(&program, NULL);
+  if (error == kBasicCalcErrorSuccess) {
+    error = SampleProgram(&program, x_min, x_max, &limits, intervals, points, max_points, count);
+  }
+  BasicProgramDestroy(&program);
+  return error;
+}
@@ -0,0 +1,806 @@
+#include "basic_calc.h"
+#include "basic_program.h"
+#include "basic_token.h"
+#include "util/counters.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// How far past its end a number is read to tell where it stops, as in
+// "1e+" or "0x1p-" followed by something other than a digit.
+enum { kEditLookahead = 4 };
+// Tokens between two saved parser states. An edit parses again from the
+// saved state in front of it up to a saved state behind it that matches.
+enum { kEditCheckpointTokens = 16 };
+enum { kEditChunkNodes = 256 };
+// Op of a number node.
+enum { kEditNumber = 0xFF };
+
+// A number or an operation of the parsed expression with its value.
+// Every node belongs to the token that made it, or to the editor for
+// the operations reduced at the end of the text.
+typedef struct EditNode {
+  struct EditNode* parent;
+  // Unary operations only have rhs.
+  struct EditNode* lhs;
+  struct EditNode* rhs;
+  // Next node of the same owner, or of the free list.
+  struct EditNode* next;
+  double value;
+  // The edit that made the node.
+  size_t edit;
+  unsigned char op;
+} EditNode;
+
+typedef struct EditChunk {
+  struct EditChunk* next;
+  EditNode nodes[kEditChunkNodes];
+} EditChunk;
+
+// Parser state in front of a token: the operand nodes the compiler would
+// have on its value stack, then the operation stack as op indices.
+typedef struct {
+  size_t operands;
+  size_t ops;
+  bool after_operand;
+  EditNode* nodes[];
+} EditSnapshot;
+
+// Offsets are into the text for tokens in front of the gap and from
+// the end of the text behind it, so an edit moves none of the tokens
+// after it. A token that failed reaches the end of the text.
+typedef struct {
+  size_t start;
+  size_t end;
+  EditSnapshot* snapshot;
+  EditNode* nodes;
+} EditToken;
+
+typedef struct {
+  EditNode* node;
+  EditNode* parent;
+} EditParent;
+
+struct BasicEditor {
+  char* text;
+  size_t size;
+  size_t cap;
+
+  // Tokens are kept in a gap buffer, the gap sits where the last edit was.
+  EditToken* tokens;
+  size_t gap_start;
+  size_t gap_end;
+  size_t tokens_cap;
+
+  // The parse ends with error at the last token when stopped, otherwise
+  // with the reduction at the end of the text, whose nodes are kept in
+  // drain and whose state before it is in end.
+  bool stopped;
+  bool broken;
+  BasicCalcError error;
+  EditNode* root;
+  EditNode* drain;
+  EditSnapshot* end;
+
+  // When stopped, the last stale tokens, root, drain and end are still
+  // those of the last parse that got to the end of the text, which ended
+  // with stale_error. An edit that fixes the error takes them back where
+  // its state matches theirs, so nodes they may point at wait in limbo
+  // instead of the free list. Parents their nodes had in that parse and
+  // the stopped ones changed are in stale_parents.
+  size_t stale;
+  BasicCalcError stale_error;
+  EditNode* limbo;
+  EditParent* stale_parents;
+  size_t stale_parents_size;
+  size_t stale_parents_cap;
+
+  // The parser state while an edit is parsed.
+  EditNode** operands;
+  size_t operands_size;
+  size_t operands_cap;
+  unsigned char* ops;
+  size_t ops_size;
+  size_t ops_cap;
+  bool after_operand;
+
+  // What the current edit removed, put back if it fails.
+  char* undo;
+  size_t undo_cap;
+
+  size_t edit;
+  // Parents of older nodes that the current edit took over.
+  EditParent* parents;
+  size_t parents_size;
+  size_t parents_cap;
+
+  EditNode* free_nodes;
+  EditChunk* chunks;
+};
+
+static bool Grow(void** data, size_t* cap, size_t need, size_t elem_size) {
+  if (need <= *cap) {
+    return true;
+  }
+  size_t new_cap = *cap ? *cap * 2 : 16;
+  while (new_cap < need) {
+    new_cap *= 2;
+  }
+  void* new_data = CountersRealloc(*data, new_cap * elem_size);
+  if (!new_data) {
+    return false;
+  }
+  *data = new_data;
+  *cap = new_cap;
+  return true;
+}
+
+static EditNode* NewNode(BasicEditor* editor, EditNode** owner) {
+  if (!editor->free_nodes) {
+    EditChunk* chunk = (EditChunk*)CountersMalloc(sizeof(EditChunk));
+    if (!chunk) {
+      return NULL;
+    }
+    chunk->next = editor->chunks;
+    editor->chunks = chunk;
+    for (size_t i = 0; i < kEditChunkNodes; ++i) {
+      chunk->nodes[i].next = editor->free_nodes;
+      editor->free_nodes = chunk->nodes + i;
+    }
+  }
+  EditNode* node = editor->free_nodes;
+  editor->free_nodes = node->next;
+  *node = (EditNode){.next = *owner, .edit = editor->edit};
+  *owner = node;
+  return node;
+}
+
+static void FreeNodes(BasicEditor* editor, EditNode* nodes) {
+  while (nodes) {
+    EditNode* next = nodes->next;
+    nodes->next = editor->free_nodes;
+    editor->free_nodes = nodes;
+    nodes = next;
+  }
+}
+
+static inline size_t TokenCount(const BasicEditor* editor) {
+  return editor->gap_start + editor->tokens_cap - editor->gap_end;
+}
+
+static inline EditToken* TokenAt(BasicEditor* editor, size_t idx) {
+  if (idx < editor->gap_start) {
+    return editor->tokens + idx;
+  }
+  return editor->tokens + editor->gap_end + idx - editor->gap_start;
+}
+
+// Stale tokens reach the end of the text like a failed one, an edit
+// behind the error is parsed from in front of it.
+static inline size_t TokenEnd(BasicEditor* editor, size_t idx) {
+  if (TokenCount(editor) - idx <= editor->stale) {
+    return editor->size;
+  }
+  const EditToken* token = TokenAt(editor, idx);
+  return idx < editor->gap_start ? token->end : editor->size - token->end;
+}
+
+static inline size_t BackStart(const BasicEditor* editor) {
+  return editor->size - editor->tokens[editor->gap_end].start;
+}
+
+static void MoveGap(BasicEditor* editor, size_t idx) {
+  while (editor->gap_start > idx) {
+    EditToken* token = editor->tokens + --editor->gap_end;
+    *token = editor->tokens[--editor->gap_start];
+    token->start = editor->size - token->start;
+    token->end = editor->size - token->end;
+  }
+  while (editor->gap_start < idx) {
+    EditToken* token = editor->tokens + editor->gap_start++;
+    *token = editor->tokens[editor->gap_end++];
+    token->start = editor->size - token->start;
+    token->end = editor->size - token->end;
+  }
+}
+
+static EditToken* PushToken(BasicEditor* editor) {
+  if (editor->gap_start == editor->gap_end) {
+    size_t back = editor->tokens_cap - editor->gap_end;
+    size_t cap = editor->tokens_cap;
+    if (!Grow((void**)&editor->tokens, &cap, cap + 1, sizeof(EditToken))) {
+      return NULL;
+    }
+    memmove(editor->tokens + cap - back, editor->tokens + editor->gap_end, back * sizeof(EditToken));
+    editor->gap_end = cap - back;
+    editor->tokens_cap = cap;
+  }
+  EditToken* token = editor->tokens + editor->gap_start++;
+  *token = (EditToken){0};
+  return token;
+}
+
+static inline unsigned char* SnapshotOps(EditSnapshot* snapshot) {
+  return (unsigned char*)(snapshot->nodes + snapshot->operands);
+}
+
+static EditSnapshot* TakeSnapshot(const BasicEditor* editor) {
+  EditSnapshot* snapshot = (EditSnapshot*)CountersMalloc(sizeof(EditSnapshot) +
+                                                         editor->operands_size * sizeof(EditNode*) +
+                                                         editor->ops_size);
+  if (snapshot) {
+    snapshot->operands = editor->operands_size;
+    snapshot->ops = editor->ops_size;
+    snapshot->after_operand = editor->after_operand;
+    memcpy(snapshot->nodes, editor->operands, editor->operands_size * sizeof(EditNode*));
+    memcpy(SnapshotOps(snapshot), editor->ops, editor->ops_size);
+  }
+  return snapshot;
+}
+
+static bool RestoreSnapshot(BasicEditor* editor, EditSnapshot* snapshot) {
+  if (!Grow((void**)&editor->operands, &editor->operands_cap, snapshot->operands, sizeof(EditNode*)) ||
+      !Grow((void**)&editor->ops, &editor->ops_cap, snapshot->ops, 1)) {
+    return false;
+  }
+  editor->operands_size = snapshot->operands;
+  editor->ops_size = snapshot->ops;
+  editor->after_operand = snapshot->after_operand;
+  memcpy(editor->operands, snapshot->nodes, snapshot->operands * sizeof(EditNode*));
+  memcpy(editor->ops, SnapshotOps(snapshot), snapshot->ops);
+  return true;
+}
+
+// Operand nodes may differ, whatever made them is parsed the same from here.
+static bool SameState(const BasicEditor* editor, EditSnapshot* snapshot) {
+  return snapshot->operands == editor->operands_size && snapshot->ops == editor->ops_size &&
+         snapshot->after_operand == editor->after_operand &&
+         memcmp(SnapshotOps(snapshot), editor->ops, editor->ops_size) == 0;
+}
+
+// The state is the saved one on top of an open brace, with at least as
+// many operands. Where the saved parse got to the end of the text without
+// an error, the rest is parsed the same inside the brace, which is then
+// left open.
+static bool Wrapped(const BasicEditor* editor, EditSnapshot* snapshot) {
+  if (editor->ops_size <= snapshot->ops || editor->operands_size < snapshot->operands ||
+      editor->after_operand != snapshot->after_operand) {
+    return false;
+  }
+  size_t below = editor->ops_size - snapshot->ops;
+  return editor->ops[below - 1] == kOpenBrace &&
+         memcmp(SnapshotOps(snapshot), editor->ops + below, snapshot->ops) == 0;
+}
+
+// Nodes made before this edit keep what their parent was, the old tree
+// is hooked back onto the new one by it. Only the operands of the saved
+// state parsing starts from are older, so the log never grows.
+static void SetParent(BasicEditor* editor, EditNode* node, EditNode* parent) {
+  if (node->edit != editor->edit) {
+    editor->parents[editor->parents_size++] = (EditParent){node, node->parent};
+  }
+  node->parent = parent;
+}
+
+static EditNode* OldParent(const BasicEditor* editor, EditNode* node, bool stale) {
+  for (size_t i = 0; stale && i < editor->stale_parents_size; ++i) {
+    if (editor->stale_parents[i].node == node) {
+      return editor->stale_parents[i].parent;
+    }
+  }
+  for (size_t i = 0; i < editor->parents_size; ++i) {
+    if (editor->parents[i].node == node) {
+      return editor->parents[i].parent;
+    }
+  }
+  return node->parent;
+}
+
+static inline double NodeValue(const EditNode* node) {
+  return BasicOperationApply((enum MathOperationIdx)node->op, node->lhs ? node->lhs->value : 0.0, node->rhs->value);
+}
+
+static BasicCalcError PushOperand(BasicEditor* editor, EditNode* node) {
+  if (!Grow((void**)&editor->operands, &editor->operands_cap, editor->operands_size + 1, sizeof(EditNode*))) {
+    return kBasicCalcAllocationFail;
+  }
+  editor->operands[editor->operands_size++] = node;
+  return kBasicCalcErrorSuccess;
+}
+
+static BasicCalcError PushOp(BasicEditor* editor, enum MathOperationIdx op) {
+  if (!Grow((void**)&editor->ops, &editor->ops_cap, editor->ops_size + 1, 1)) {
+    return kBasicCalcAllocationFail;
+  }
+  editor->ops[editor->ops_size++] = (unsigned char)op;
+  return kBasicCalcErrorSuccess;
+}
+
+// ShuntYardAlgo of the compiler, making a node instead of an instruction.
+static BasicCalcError Reduce(BasicEditor* editor, EditNode** owner) {
+  const MathOperation* op = BasicOperationGet((enum MathOperationIdx)editor->ops[--editor->ops_size]);
+  if (editor->operands_size == 0) {
+    return kBasicCalcErrorInvalidSyntax;
+  }
+  if (op->priority == kBrace) {
+    return kBasicCalcErrorBracesNotMatching;
+  }
+  if (op->type == kBinary && editor->operands_size < 2) {
+    return kBasicCalcErrorInvalidSyntax;
+  }
+  EditNode* node = NewNode(editor, owner);
+  if (!node) {
+    return kBasicCalcAllocationFail;
+  }
+  node->op = (unsigned char)op->idx;
+  node->rhs = editor->operands[--editor->operands_size];
+  SetParent(editor, node->rhs, node);
+  if (op->type == kBinary) {
+    node->lhs = editor->operands[--editor->operands_size];
+    SetParent(editor, node->lhs, node);
+  }
+  node->value = NodeValue(node);
+  editor->operands[editor->operands_size++] = node;
+  return kBasicCalcErrorSuccess;
+}
+
+static BasicCalcError ParseToken(BasicEditor* editor, const BasicToken* token, EditNode** owner) {
+  BasicCalcError error;
+  switch (token->type) {
+    case kBasicTokenNumber: {
+      EditNode* node = NewNode(editor, owner);
+      if (!node) {
+        return kBasicCalcAllocationFail;
+      }
+      node->op = kEditNumber;
+      node->value = token->number;
+      return PushOperand(editor, node);
+    }
+    case kBasicTokenOperator: {
+      const MathOperation* op = BasicOperationGet(token->op);
+      while (editor->ops_size && BasicReducesBefore(op, BasicOperationGet((enum MathOperationIdx)editor->ops[editor->ops_size - 1]))) {
+        error = Reduce(editor, owner);
+        if (error != kBasicCalcErrorSuccess) {
+          return error;
+        }
+      }
+      return PushOp(editor, token->op);
+    }
+    case kBasicTokenFunction:
+      error = PushOp(editor, token->function);
+      return error == kBasicCalcErrorSuccess ? PushOp(editor, kOpenBrace) : error;
+    case kBasicTokenOpenBrace:
+      return PushOp(editor, kOpenBrace);
+    case kBasicTokenCloseBrace:
+      while (editor->ops_size && editor->ops[editor->ops_size - 1] != kOpenBrace) {
+        error = Reduce(editor, owner);
+        if (error != kBasicCalcErrorSuccess) {
+          return error;
+        }
+      }
+      if (editor->ops_size == 0) {
+        return kBasicCalcErrorBracesNotMatching;
+      }
+      --editor->ops_size;
+      return kBasicCalcErrorSuccess;
+    case kBasicTokenError:
+      return token->error;
+    default:
+      break;
+  }
+  return kBasicCalcErrorInvalidExpr;
+}
+
+static BasicCalcError Drain(BasicEditor* editor) {
+  while (editor->ops_size) {
+    BasicCalcError error = Reduce(editor, &editor->drain);
+    if (error != kBasicCalcErrorSuccess) {
+      return error;
+    }
+  }
+  if (editor->operands_size != 1) {
+    return kBasicCalcErrorInvalidExpr;
+  }
+  editor->root = editor->operands[0];
+  SetParent(editor, editor->root, NULL);
+  return kBasicCalcErrorSuccess;
+}
+
+static void FreeSnapshots(BasicEditor* editor) {
+  for (size_t i = 0; i < TokenCount(editor); ++i) {
+    free(TokenAt(editor, i)->snapshot);
+  }
+  free(editor->end);
+  editor->end = NULL;
+}
+
+// Drops the parse after an allocation failed, the next edit starts over.
+static void Reset(BasicEditor* editor) {
+  FreeSnapshots(editor);
+  while (editor->chunks) {
+    EditChunk* next = editor->chunks->next;
+    free(editor->chunks);
+    editor->chunks = next;
+  }
+  editor->free_nodes = NULL;
+  editor->gap_start = 0;
+  editor->gap_end = editor->tokens_cap;
+  editor->root = NULL;
+  editor->drain = NULL;
+  editor->limbo = NULL;
+  editor->stale = 0;
+  editor->stale_parents_size = 0;
+  editor->stopped = false;
+  editor->broken = true;
+}
+
+// The old parse continues from snapshot, which the new one matched. Its
+// operands are swapped for the new ones in every later state and below
+// the parents they had, whose values are then recomputed upwards.
+static void Splice(BasicEditor* editor, EditSnapshot* snapshot, bool stale) {
+  for (size_t i = 0; i < snapshot->operands; ++i) {
+    EditNode* old_node = snapshot->nodes[i];
+    EditNode* new_node = editor->operands[i];
+    EditNode* parent = OldParent(editor, old_node, stale);
+    new_node->parent = parent;
+    if (old_node == new_node) {
+      continue;
+    }
+    if (editor->root == old_node) {
+      editor->root = new_node;
+    }
+    for (size_t j = editor->gap_end; j <= editor->tokens_cap; ++j) {
+      EditSnapshot* later = j < editor->tokens_cap ? editor->tokens[j].snapshot : editor->end;
+      if (!later) {
+        continue;
+      }
+      // A node leaves the stack once and never comes back.
+      if (later->operands <= i || later->nodes[i] != old_node) {
+        break;
+      }
+      later->nodes[i] = new_node;
+    }
+    if (!parent) {
+      continue;
+    }
+    if (parent->lhs == old_node) {
+      parent->lhs = new_node;
+    } else {
+      parent->rhs = new_node;
+    }
+    for (EditNode* node = parent; node; node = node->parent) {
+      double value = NodeValue(node);
+      if (memcmp(&value, &node->value, sizeof(value)) == 0) {
+        break;
+      }
+      node->value = value;
+    }
+  }
+}
+
+static void AppendNodes(EditNode** list, EditNode* nodes) {
+  if (nodes) {
+    EditNode* last = nodes;
+    while (last->next) {
+      last = last->next;
+    }
+    last->next = *list;
+    *list = nodes;
+  }
+}
+
+static void DropToken(BasicEditor* editor, EditNode** dead) {
+  if (editor->tokens_cap - editor->gap_end <= editor->stale) {
+    --editor->stale;
+  }
+  EditToken* token = editor->tokens + editor->gap_end++;
+  free(token->snapshot);
+  AppendNodes(dead, token->nodes);
+}
+
+static void PopToken(BasicEditor* editor, EditNode** dead) {
+  EditToken* token = editor->tokens + --editor->gap_start;
+  free(token->snapshot);
+  AppendNodes(dead, token->nodes);
+}
+
+// Adds the parents this edit took over to those of the stale parse, the
+// first one a node has there is the parent it had in it.
+static bool KeepStaleParents(BasicEditor* editor) {
+  if (!Grow((void**)&editor->stale_parents, &editor->stale_parents_cap,
+            editor->stale_parents_size + editor->parents_size, sizeof(EditParent))) {
+    return false;
+  }
+  size_t size = editor->stale_parents_size;
+  for (size_t i = 0; i < editor->parents_size; ++i) {
+    size_t j = 0;
+    while (j < size && editor->stale_parents[j].node != editor->parents[i].node) {
+      ++j;
+    }
+    if (j == size) {
+      editor->stale_parents[editor->stale_parents_size++] = editor->parents[i];
+    }
+  }
+  return true;
+}
+
+// Index of the first token that an edit at pos may change.
+static size_t FirstTouched(BasicEditor* editor, size_t pos) {
+  size_t lo = 0;
+  size_t hi = TokenCount(editor);
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (TokenEnd(editor, mid) + kEditLookahead > pos) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
+
+// Gets everything an edit needs that may fail to allocate while nothing
+// has changed yet. Parsing starts from snapshot, or from nothing.
+static bool Prepare(BasicEditor* editor, EditSnapshot* snapshot, size_t size, size_t removed) {
+  editor->operands_size = 0;
+  editor->ops_size = 0;
+  editor->after_operand = false;
+  editor->parents_size = 0;
+  // Never left NULL, snapshots copy from them.
+  if (!Grow((void**)&editor->operands, &editor->operands_cap, 1, sizeof(EditNode*)) ||
+      !Grow((void**)&editor->ops, &editor->ops_cap, 1, 1) ||
+      (snapshot && !RestoreSnapshot(editor, snapshot))) {
+    return false;
+  }
+  return Grow((void**)&editor->parents, &editor->parents_cap, editor->operands_size + 1, sizeof(EditParent)) &&
+         Grow((void**)&editor->text, &editor->cap, size + 1, 1) &&
+         Grow((void**)&editor->undo, &editor->undo_cap, removed, 1);
+}
+
+static void ReplaceText(BasicEditor* editor, size_t pos, size_t removed, const char* text, size_t size) {
+  memmove(editor->text + pos + size, editor->text + pos + removed, editor->size - pos - removed);
+  memcpy(editor->text + pos, text, size);
+  editor->size += size - removed;
+  editor->text[editor->size] = '\0';
+}
+
+// Parses the text from ptr on with the prepared state, up to where the
+// tokens and the state match what the last parse had there.
+static BasicCalcError Parse(BasicEditor* editor, size_t ptr, size_t edit_end, EditNode* dead) {
+  BasicLexer lexer = BasicLexerNew(editor->text, false, NULL);
+  lexer.ptr = editor->text + ptr;
+  lexer.end = editor->text + editor->size;
+  BasicCalcError error = kBasicCalcErrorSuccess;
+  EditSnapshot* converged = NULL;
+  bool stale = false;
+  bool wrapped = false;
+  // Back tokens not parsed past yet. Those parsed past are dropped after
+  // the loop, a wrapped parse keeps them instead of its own.
+  size_t behind = editor->tokens_cap - editor->gap_end;
+  for (size_t since = kEditCheckpointTokens;; ++since) {
+    BasicToken token;
+    const char* start;
+    lexer.after_operand = editor->after_operand;
+    bool more = BasicLexNext(&lexer, &token, &start);
+    size_t pos = (size_t)(start - editor->text);
+    if (pos >= edit_end) {
+      while (behind && editor->size - editor->tokens[editor->tokens_cap - behind].start < pos) {
+        --behind;
+      }
+      // When stopped, the end state is that of the stale parse.
+      EditSnapshot* snapshot = NULL;
+      stale = editor->stopped;
+      if (behind) {
+        const EditToken* back = editor->tokens + editor->tokens_cap - behind;
+        if (editor->size - back->start == pos) {
+          snapshot = back->snapshot;
+          stale = behind <= editor->stale;
+        }
+      } else if (!more) {
+        snapshot = editor->end;
+      }
+      // When stopped, only the stale parse is matched. A splice into the
+      // stopped one would rehook nodes the stale tail still hangs from
+      // under parents and values it never had.
+      if (!stale && editor->stopped) {
+        snapshot = NULL;
+      }
+      if (snapshot && SameState(editor, snapshot)) {
+        converged = snapshot;
+        break;
+      }
+      // An open brace in front of a parse that got through needs nothing
+      // parsed again to give BracesNotMatching.
+      BasicCalcError outcome = stale ? editor->stale_error : editor->error;
+      if (snapshot && outcome == kBasicCalcErrorSuccess && Wrapped(editor, snapshot)) {
+        wrapped = true;
+        break;
+      }
+    }
+    if (!more) {
+      break;
+    }
+    EditToken* new_token = PushToken(editor);
+    if (!new_token) {
+      error = kBasicCalcAllocationFail;
+      break;
+    }
+    new_token->start = pos;
+    new_token->end = (size_t)(lexer.ptr - editor->text);
+    if (since >= kEditCheckpointTokens) {
+      new_token->snapshot = TakeSnapshot(editor);
+      if (!new_token->snapshot) {
+        error = kBasicCalcAllocationFail;
+        break;
+      }
+      since = 0;
+    }
+    editor->after_operand = lexer.after_operand;
+    error = ParseToken(editor, &token, &new_token->nodes);
+    if (error != kBasicCalcErrorSuccess) {
+      new_token->end = editor->size;
+      break;
+    }
+  }
+  if (error == kBasicCalcAllocationFail) {
+    return error;
+  }
+  if (!wrapped) {
+    while (editor->tokens_cap - editor->gap_end > behind) {
+      DropToken(editor, &dead);
+    }
+  }
+  if (converged) {
+    Splice(editor, converged, stale);
+    if (stale) {
+      editor->stopped = false;
+      editor->stale = 0;
+      editor->stale_parents_size = 0;
+      editor->error = editor->stale_error;
+      FreeNodes(editor, editor->limbo);
+      editor->limbo = NULL;
+    }
+  } else if (error != kBasicCalcErrorSuccess || wrapped) {
+    // Left without a parent in the new parse, older operands may still
+    // point at one the old parse made.
+    for (size_t i = 0; i < editor->operands_size; ++i) {
+      SetParent(editor, editor->operands[i], NULL);
+    }
+    if (!editor->stopped) {
+      editor->stale = editor->tokens_cap - editor->gap_end;
+      editor->stale_error = editor->error;
+      editor->stale_parents_size = 0;
+    }
+    // Tokens of an earlier stop behind this one are of no parse.
+    while (editor->tokens_cap - editor->gap_end > editor->stale) {
+      DropToken(editor, &dead);
+    }
+    if (wrapped) {
+      // The next edit matches the stale tokens behind the edit sooner
+      // than the ones parsed inside the brace.
+      while (editor->gap_start && editor->tokens[editor->gap_start - 1].start >= edit_end) {
+        PopToken(editor, &dead);
+      }
+      while (editor->gap_end < editor->tokens_cap && editor->gap_start &&
+             BackStart(editor) < editor->tokens[editor->gap_start - 1].end) {
+        DropToken(editor, &dead);
+      }
+    }
+    if (!KeepStaleParents(editor)) {
+      return kBasicCalcAllocationFail;
+    }
+    editor->stopped = true;
+    editor->error = wrapped ? kBasicCalcErrorBracesNotMatching : error;
+  } else {
+    while (editor->gap_end < editor->tokens_cap) {
+      DropToken(editor, &dead);
+    }
+    AppendNodes(&dead, editor->drain);
+    AppendNodes(&dead, editor->limbo);
+    editor->drain = NULL;
+    editor->limbo = NULL;
+    free(editor->end);
+    editor->end = NULL;
+    editor->root = NULL;
+    editor->stopped = false;
+    editor->stale_parents_size = 0;
+    editor->end = TakeSnapshot(editor);
+    error = editor->end ? Drain(editor) : kBasicCalcAllocationFail;
+    if (error == kBasicCalcAllocationFail) {
+      return error;
+    }
+    if (error != kBasicCalcErrorSuccess) {
+      for (size_t i = 0; i < editor->operands_size; ++i) {
+        editor->operands[i]->parent = NULL;
+      }
+    }
+    editor->error = error;
+  }
+  if (editor->stopped && (editor->stale || editor->end)) {
+    AppendNodes(&editor->limbo, dead);
+  } else {
+    FreeNodes(editor, dead);
+  }
+  return kBasicCalcErrorSuccess;
+}
+
+BasicCalcError CALL_CONV BasicEditorNew(BasicEditor** editor) {
+  BasicEditor* new_editor = (BasicEditor*)CountersCalloc(1, sizeof(BasicEditor));
+  if (!new_editor) {
+    return kBasicCalcAllocationFail;
+  }
+  // An empty text is an error, as for BasicCalculateExpr.
+  new_editor->broken = true;
+  double res;
+  if (BasicEditorReplace(new_editor, 0, 0, "", 0, &res) == kBasicCalcAllocationFail) {
+    BasicEditorFree(new_editor);
+    return kBasicCalcAllocationFail;
+  }
+  *editor = new_editor;
+  return kBasicCalcErrorSuccess;
+}
+
+BasicCalcError CALL_CONV BasicEditorReplace(BasicEditor* editor,
+                                            size_t pos,
+                                            size_t removed,
+                                            const char* text,
+                                            size_t size,
+                                            double* res) {
+  if (pos > editor->size || removed > editor->size - pos || (size && memchr(text, '\0', size))) {
+    return kBasicCalcErrorInvalidArgument;
+  }
+  size_t ptr = 0;
+  EditSnapshot* snapshot = NULL;
+  if (!editor->broken) {
+    // The saved state in front of the first token the edit may change.
+    // That token starts before pos, so it stays where it is.
+    size_t idx = FirstTouched(editor, pos);
+    while (idx && !TokenAt(editor, --idx)->snapshot)
+      ;
+    MoveGap(editor, idx);
+    if (idx) {
+      ptr = BackStart(editor);
+      snapshot = editor->tokens[editor->gap_end].snapshot;
+    }
+  }
+  if (!Prepare(editor, snapshot, editor->size - removed + size, removed)) {
+    return kBasicCalcAllocationFail;
+  }
+  // Tokens starting in front of the end of the edit are parsed again,
+  // the others keep their offsets from the end of the text.
+  EditNode* dead = NULL;
+  while (editor->gap_end < editor->tokens_cap && BackStart(editor) < pos + removed) {
+    DropToken(editor, &dead);
+  }
+  if (removed) {
+    memcpy(editor->undo, editor->text + pos, removed);
+  }
+  ReplaceText(editor, pos, removed, text, size);
+  ++editor->edit;
+  editor->broken = false;
+  if (Parse(editor, ptr, pos + size, dead) != kBasicCalcErrorSuccess) {
+    ReplaceText(editor, pos, size, editor->undo, removed);
+    Reset(editor);
+    return kBasicCalcAllocationFail;
+  }
+  if (editor->error == kBasicCalcErrorSuccess) {
+    *res = editor->root->value;
+  }
+  return editor->error;
+}
+
+void CALL_CONV BasicEditorFree(BasicEditor* editor) {
+  if (!editor) {
+    return;
+  }
+  Reset(editor);
+  free(editor->tokens);
+  free(editor->text);
+  free(editor->operands);
+  free(editor->ops);
+  free(editor->parents);
+  free(editor->stale_parents);
+  free(editor->undo);
+  free(editor);
+}
@@ -0,0 +1,221 @@
+#include "basic_program.h"
+
+#include <math.h>
+#include <stddef.h>
+
+// Threaded dispatch needs labels as values, a gcc and clang extension.
+#if defined(__GNUC__) || defined(__clang__)
+#   define BASIC_INTERP_THREADED
+#endif
+
+// Number, Variable and NegVariable push, Number and Variable forms of an
+// operation take their right operand from the instruction instead of
+// the stack. MultiplyPlus and MultiplyMinus compute a + b * c and
+// a - b * c from the top three values, rounded twice as the unfused pair
+// is since the library is built with -ffp-contract=off.
+#define INTERP_OPS(X) \
+  X(End) X(Number) X(Variable) X(NegVariable) X(Store) X(Load) \
+  X(UnaryMinus) X(Sqrt) X(Sin) X(Cos) X(Tan) X(Asin) X(Acos) X(Atan) X(Ln) X(Log) \
+  X(Power) X(Multiply) X(Division) X(Fmod) X(Plus) X(Minus) \
+  X(PowerNumber) X(MultiplyNumber) X(DivisionNumber) X(PlusNumber) X(MinusNumber) \
+  X(MultiplyVariable) X(DivisionVariable) X(PlusVariable) X(MinusVariable) \
+  X(MultiplyPlus) X(MultiplyMinus)
+
+#define INTERP_ENUM(name) kCode##name,
+enum { INTERP_OPS(INTERP_ENUM) kCodeNone };
+#undef INTERP_ENUM
+
+// Opcodes by MathOperationIdx. Unary plus is dropped when translating.
+static const unsigned kOpCodes[] = {
+  [kUnaryMinus] = kCodeUnaryMinus,
+  [kUnaryPlus] = kCodeNone,
+  [kSqrt] = kCodeSqrt,
+  [kSin] = kCodeSin,
+  [kCos] = kCodeCos,
+  [kTan] = kCodeTan,
+  [kAsin] = kCodeAsin,
+  [kAcos] = kCodeAcos,
+  [kAtan] = kCodeAtan,
+  [kLn] = kCodeLn,
+  [kLog] = kCodeLog,
+  [kPower] = kCodePower,
+  [kMultiply] = kCodeMultiply,
+  [kDivision] = kCodeDivision,
+  [kFmod] = kCodeFmod,
+  [kPlus] = kCodePlus,
+  [kMinus] = kCodeMinus,
+  [kOpenBrace] = kCodeNone
+};
+
+static const unsigned kNumberCodes[] = {
+  [kPower] = kCodePowerNumber,
+  [kMultiply] = kCodeMultiplyNumber,
+  [kDivision] = kCodeDivisionNumber,
+  [kFmod] = kCodeNone,
+  [kPlus] = kCodePlusNumber,
+  [kMinus] = kCodeMinusNumber
+};
+
+static const unsigned kVariableCodes[] = {
+  [kPower] = kCodeNone,
+  [kMultiply] = kCodeMultiplyVariable,
+  [kDivision] = kCodeDivisionVariable,
+  [kFmod] = kCodeNone,
+  [kPlus] = kCodePlusVariable,
+  [kMinus] = kCodeMinusVariable
+};
+
+// Folds op into the last entry when it only works on what that entry
+// pushed. Every fold gives the same bits as the unfused instructions.
+static size_t TranslateOperation(enum MathOperationIdx op, BasicCode* code, size_t size) {
+  BasicCode* last = size ? code + size - 1 : NULL;
+  if (op == kUnaryPlus) {
+    return size;
+  }
+  if (op == kUnaryMinus && last) {
+    if (last->op == kCodeNumber) {
+      last->number = -last->number;
+      return size;
+    }
+    if (last->op == kCodeVariable || last->op == kCodeNegVariable) {
+      last->op = last->op == kCodeVariable ? kCodeNegVariable : kCodeVariable;
+      return size;
+    }
+  }
+  if (!MathOperationIsUnary(op) && last) {
+    if (last->op == kCodeNumber && kNumberCodes[op] != kCodeNone) {
+      last->op = kNumberCodes[op];
+      return size;
+    }
+    if (last->op == kCodeVariable && kVariableCodes[op] != kCodeNone) {
+      last->op = kVariableCodes[op];
+      return size;
+    }
+    if (last->op == kCodeMultiply && (op == kPlus || op == kMinus)) {
+      last->op = op == kPlus ? kCodeMultiplyPlus : kCodeMultiplyMinus;
+      return size;
+    }
+  }
+  code[size] = (BasicCode){.op = kOpCodes[op]};
+  return size + 1;
+}
+
+size_t BasicInterpTranslate(const BasicInstr* instrs, size_t size, BasicCode* code) {
+  size_t code_size = 0;
+  for (size_t i = 0; i < size; ++i) {
+    const BasicInstr* instr = instrs + i;
+    switch (instr->type) {
+      case kBasicInstrNumber:
+        code[code_size++] = (BasicCode){.op = kCodeNumber, .number = instr->number};
+        break;
+      case kBasicInstrVariable:
+        code[code_size++] = (BasicCode){.op = kCodeVariable, .slot = instr->slot};
+        break;
+      case kBasicInstrStore:
+        code[code_size++] = (BasicCode){.op = kCodeStore, .slot = instr->slot};
+        break;
+      case kBasicInstrLoad:
+        code[code_size++] = (BasicCode){.op = kCodeLoad, .slot = instr->slot};
+        break;
+      case kBasicInstrOperation:
+        code_size = TranslateOperation(instr->op, code, code_size);
+        break;
+    }
+  }
+  code[code_size++] = (BasicCode){.op = kCodeEnd};
+  return code_size;
+}
+
+#ifdef BASIC_INTERP_THREADED
+#   define INTERP_LABEL(name) [kCode##name] = &&Label##name,
+#   define INTERP_CASE(name) Label##name:
+#   define INTERP_NEXT() goto *kLabels[(++pc)->op]
+#else
+#   define INTERP_CASE(name) case kCode##name:
+#   define INTERP_NEXT() ++pc; goto dispatch
+#endif
+
+// Unary operations and those with an operand in the instruction only
+// replace the top value.
+#define INTERP_UNARY(name, expr) \
+  INTERP_CASE(name) \
+  top[0] = expr; \
+  INTERP_NEXT();
+
+#define INTERP_BINARY(name, expr) \
+  INTERP_CASE(name) \
+  --top; \
+  top[0] = expr; \
+  INTERP_NEXT();
+
+// top points at the top value, below the bottom one before the first push.
+double BasicInterpRun(const BasicCode* code, const double* vars, double* stack, size_t temps) {
+  const BasicCode* pc = code;
+  double* top = stack + temps - 1;
+#ifdef BASIC_INTERP_THREADED
+  static const void* const kLabels[] = {INTERP_OPS(INTERP_LABEL)};
+  goto *kLabels[pc->op];
+#else
+dispatch:
+  switch (pc->op) {
+#endif
+  INTERP_CASE(Number)
+  *++top = pc->number;
+  INTERP_NEXT();
+  INTERP_CASE(Variable)
+  *++top = vars[pc->slot];
+  INTERP_NEXT();
+  INTERP_CASE(NegVariable)
+  *++top = -vars[pc->slot];
+  INTERP_NEXT();
+  INTERP_CASE(Store)
+  stack[pc->slot] = top[0];
+  INTERP_NEXT();
+  INTERP_CASE(Load)
+  *++top = stack[pc->slot];
+  INTERP_NEXT();
+
+  INTERP_UNARY(UnaryMinus, -top[0])
+  INTERP_UNARY(Sqrt, sqrt(top[0]))
+  INTERP_UNARY(Sin, sin(top[0]))
+  INTERP_UNARY(Cos, cos(top[0]))
+  INTERP_UNARY(Tan, tan(top[0]))
+  INTERP_UNARY(Asin, asin(top[0]))
+  INTERP_UNARY(Acos, acos(top[0]))
+  INTERP_UNARY(Atan, atan(top[0]))
+  INTERP_UNARY(Ln, log(top[0]))
+  INTERP_UNARY(Log, log10(top[0]))
+
+  INTERP_BINARY(Power, pow(top[0], top[1]))
+  INTERP_BINARY(Multiply, top[0] * top[1])
+  INTERP_BINARY(Division, BasicDivide(top[0], top[1]))
+  INTERP_BINARY(Fmod, BasicFmod(top[0], top[1]))
+  INTERP_BINARY(Plus, top[0] + top[1])
+  INTERP_BINARY(Minus, top[0] - top[1])
+
+  INTERP_UNARY(PowerNumber, pow(top[0], pc->number))
+  INTERP_UNARY(MultiplyNumber, top[0] * pc->number)
+  INTERP_UNARY(DivisionNumber, BasicDivide(top[0], pc->number))
+  INTERP_UNARY(PlusNumber, top[0] + pc->number)
+  INTERP_UNARY(MinusNumber, top[0] - pc->number)
+  INTERP_UNARY(MultiplyVariable, top[0] * vars[pc->slot])
+  INTERP_UNARY(DivisionVariable, BasicDivide(top[0], vars[pc->slot]))
+  INTERP_UNARY(PlusVariable, top[0] + vars[pc->slot])
+  INTERP_UNARY(MinusVariable, top[0] - vars[pc->slot])
+
+  INTERP_CASE(MultiplyPlus)
+  top -= 2;
+  top[0] = top[0] + top[1] * top[2];
+  INTERP_NEXT();
+  INTERP_CASE(MultiplyMinus)
+  top -= 2;
+  top[0] = top[0] - top[1] * top[2];
+  INTERP_NEXT();
+
+  INTERP_CASE(End)
+  return top[0];
+#ifndef BASIC_INTERP_THREADED
+  }
+  return top[0];
+#endif
+}
@@ -0,0 +1,304 @@
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#   define BASIC_JIT_X86_64
+#   ifndef _DEFAULT_SOURCE
+#     define _DEFAULT_SOURCE
+#   endif
+#endif
+
+#include "basic_jit.h"
+#include "basic_calc.h"
+#include "util/counters.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef BASIC_JIT_X86_64
+#   include <sys/mman.h>
+#   include <unistd.h>
+#endif
+
+enum { kJitDefaultThreshold = 1000 };
+
+static atomic_size_t jit_threshold = kJitDefaultThreshold;
+
+#ifdef BASIC_JIT_X86_64
+
+typedef double (*BasicJitFn)(const double* vars);
+
+struct BasicJitCode {
+  BasicJitFn fn;
+  size_t size;
+};
+
+// Enough for the longest sequence a single instruction emits (division).
+enum { kJitMaxInstrBytes = 64, kJitMaxFrame = 64 * 1024 };
+
+typedef struct {
+  unsigned char* ptr;
+  size_t size;
+} JitBuf;
+
+static inline void EmitBytes(JitBuf* buf, const unsigned char* bytes, size_t size) {
+  memcpy(buf->ptr + buf->size, bytes, size);
+  buf->size += size;
+}
+
+static inline void EmitU32(JitBuf* buf, uint32_t val) {
+  memcpy(buf->ptr + buf->size, &val, sizeof(val));
+  buf->size += sizeof(val);
+}
+
+static inline void EmitU64(JitBuf* buf, uint64_t val) {
+  memcpy(buf->ptr + buf->size, &val, sizeof(val));
+  buf->size += sizeof(val);
+}
+
+// movsd xmm(reg), [rsp + disp]
+static void EmitLoadSlot(JitBuf* buf, int reg, uint32_t disp) {
+  EmitBytes(buf, (const unsigned char[]){0xF2, 0x0F, 0x10, (unsigned char)(0x84 | reg << 3), 0x24}, 5);
+  EmitU32(buf, disp);
+}
+
+// movsd [rsp + disp], xmm(reg)
+static void EmitStoreSlot(JitBuf* buf, int reg, uint32_t disp) {
+  EmitBytes(buf, (const unsigned char[]){0xF2, 0x0F, 0x11, (unsigned char)(0x84 | reg << 3), 0x24}, 5);
+  EmitU32(buf, disp);
+}
+
+// movsd xmm(reg), [rdi + disp]
+static void EmitLoadArg(JitBuf* buf, int reg, uint32_t disp) {
+  EmitBytes(buf, (const unsigned char[]){0xF2, 0x0F, 0x10, (unsigned char)(0x87 | reg << 3)}, 4);
+  EmitU32(buf, disp);
+}
+
+// movabs rax, bits; movq xmm(reg), rax
+static void EmitLoadBits(JitBuf* buf, int reg, uint64_t bits) {
+  EmitBytes(buf, (const unsigned char[]){0x48, 0xB8}, 2);
+  EmitU64(buf, bits);
+  EmitBytes(buf, (const unsigned char[]){0x66, 0x48, 0x0F, 0x6E, (unsigned char)(0xC0 | reg << 3)}, 5);
+}
+
+static void EmitLoadNumber(JitBuf* buf, double num) {
+  uint64_t bits;
+  memcpy(&bits, &num, sizeof(bits));
+  EmitLoadBits(buf, 0, bits);
+}
+
+// movabs rax, fn; call rax
+static void EmitCall(JitBuf* buf, const void* fn) {
+  EmitBytes(buf, (const unsigned char[]){0x48, 0xB8}, 2);
+  EmitU64(buf, (uint64_t)(uintptr_t)fn);
+  EmitBytes(buf, (const unsigned char[]){0xFF, 0xD0}, 2);
+}
+
+// Division inlined with the DBL_MAX result of DivisionFunction:
+//   xorpd xmm2, xmm2; ucomisd xmm1, xmm2; jp div; jne div
+//   movabs rax, DBL_MAX; movq xmm0, rax; jmp done
+//   div: divsd xmm0, xmm1
+//   done:
+static void EmitDivision(JitBuf* buf) {
+  static const double kDblMax = 1.7976931348623157e308;
+  uint64_t bits;
+  memcpy(&bits, &kDblMax, sizeof(bits));
+  EmitBytes(buf, (const unsigned char[]){0x66, 0x0F, 0x57, 0xD2,
+                                         0x66, 0x0F, 0x2E, 0xCA,
+                                         0x7A, 19,
+                                         0x75, 17}, 12);
+  EmitLoadBits(buf, 0, bits);
+  EmitBytes(buf, (const unsigned char[]){0xEB, 4,
+                                         0xF2, 0x0F, 0x5E, 0xC1}, 6);
+}
+
+static void EmitOperation(JitBuf* buf, enum MathOperationIdx op) {
+  switch (op) {
+    case kUnaryPlus:
+      break;
+    case kUnaryMinus:
+      // xorpd with the sign bit, same bits as -num.
+      EmitLoadBits(buf, 1, 0x8000000000000000ULL);
+      EmitBytes(buf, (const unsigned char[]){0x66, 0x0F, 0x57, 0xC1}, 4);
+      break;
+    case kPlus:
+      EmitBytes(buf, (const unsigned char[]){0xF2, 0x0F, 0x58, 0xC1}, 4);
+      break;
+    case kMinus:
+      EmitBytes(buf, (const unsigned char[]){0xF2, 0x0F, 0x5C, 0xC1}, 4);
+      break;
+    case kMultiply:
+      EmitBytes(buf, (const unsigned char[]){0xF2, 0x0F, 0x59, 0xC1}, 4);
+      break;
+    case kDivision:
+      EmitDivision(buf);
+      break;
+    default: {
+      // libm functions, pow and fmod are called directly, with their
+      // arguments already in xmm0 and xmm1.
+      const MathOperation* operation = BasicOperationGet(op);
+      if (operation->type == kUnary) {
+        EmitCall(buf, (const void*)operation->function.unary);
+      } else {
+        EmitCall(buf, (const void*)operation->function.binary);
+      }
+      break;
+    }
+  }
+}
+
+// The value on top of the stack is kept in xmm0, the rest of the stack,
+// the temp slots and the variables live in the frame. Stack entry i is
+// at rsp + 8 * i. Variables are copied in on entry, since rdi does not
+// survive the libm calls.
+static void EmitProgram(JitBuf* buf, const BasicProgram* program, uint32_t frame) {
+  uint32_t temps_off = (uint32_t)(program->depth * sizeof(double));
+  uint32_t vars_off = temps_off + (uint32_t)(program->temps * sizeof(double));
+  // push rbp; mov rbp, rsp; sub rsp, frame
+  EmitBytes(buf, (const unsigned char[]){0x55, 0x48, 0x89, 0xE5, 0x48, 0x81, 0xEC}, 7);
+  EmitU32(buf, frame);
+  for (size_t i = 0; i < program->vars; ++i) {
+    EmitLoadArg(buf, 0, (uint32_t)(i * sizeof(double)));
+    EmitStoreSlot(buf, 0, vars_off + (uint32_t)(i * sizeof(double)));
+  }
+  size_t depth = 0;
+  for (size_t i = 0; i < program->size; ++i) {
+    const BasicInstr* instr = program->instrs + i;
+    switch (instr->type) {
+      case kBasicInstrNumber:
+      case kBasicInstrVariable:
+      case kBasicInstrLoad:
+        if (depth) {
+          EmitStoreSlot(buf, 0, (uint32_t)((depth - 1) * sizeof(double)));
+        }
+        if (instr->type == kBasicInstrNumber) {
+          EmitLoadNumber(buf, instr->number);
+        } else if (instr->type == kBasicInstrVariable) {
+          EmitLoadSlot(buf, 0, vars_off + (uint32_t)(instr->slot * sizeof(double)));
+        } else {
+          EmitLoadSlot(buf, 0, temps_off + (uint32_t)(instr->slot * sizeof(double)));
+        }
+        ++depth;
+        break;
+      case kBasicInstrStore:
+        EmitStoreSlot(buf, 0, temps_off + (uint32_t)(instr->slot * sizeof(double)));
+        break;
+      case kBasicInstrOperation:
+        if (!MathOperationIsUnary(instr->op)) {
+          // movsd xmm1, xmm0; movsd xmm0, lhs
+          EmitBytes(buf, (const unsigned char[]){0xF2, 0x0F, 0x10, 0xC8}, 4);
+          EmitLoadSlot(buf, 0, (uint32_t)((depth - 2) * sizeof(double)));
+          --depth;
+        }
+        EmitOperation(buf, instr->op);
+        break;
+    }
+  }
+  // leave; ret
+  EmitBytes(buf, (const unsigned char[]){0xC9, 0xC3}, 2);
+}
+
+static BasicJitCode* JitCompile(const BasicProgram* program) {
+  size_t frame = (program->depth + program->temps + program->vars) * sizeof(double);
+  frame = (frame + 15) & ~(size_t)15;
+  if (frame > kJitMaxFrame) {
+    return NULL;
+  }
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t bound = (program->size + program->vars + 2) * kJitMaxInstrBytes;
+  size_t size = (bound + page - 1) / page * page;
+  BasicJitCode* code = (BasicJitCode*)CountersMalloc(sizeof(BasicJitCode));
+  if (!code) {
+    return NULL;
+  }
+  void* mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    free(code);
+    return NULL;
+  }
+  JitBuf buf = {.ptr = (unsigned char*)mem};
+  EmitProgram(&buf, program, (uint32_t)frame);
+  if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(mem, size);
+    free(code);
+    return NULL;
+  }
+  *code = (BasicJitCode){.fn = (BasicJitFn)mem, .size = size};
+  return code;
+}
+
+static inline double JitCall(const BasicJitCode* code, const double* vars) {
+  return code->fn(vars);
+}
+
+static void JitFree(BasicJitCode* code) {
+  munmap((void*)code->fn, code->size);
+  free(code);
+}
+
+#else
+
+struct BasicJitCode {
+  int unused;
+};
+
+static BasicJitCode* JitCompile(const BasicProgram* program) {
+  (void)program;
+  return NULL;
+}
+
+static inline double JitCall(const BasicJitCode* code, const double* vars) {
+  (void)code;
+  (void)vars;
+  return 0.0;
+}
+
+static void JitFree(BasicJitCode* code) {
+  (void)code;
+}
+
+#endif // BASIC_JIT_X86_64
+
+bool BasicJitTryEval(const BasicProgram* program, const double* vars, double* res) {
+  BasicJitState* state = program->jit;
+  if (!state) {
+    return false;
+  }
+  BasicJitCode* code = atomic_load_explicit(&state->code, memory_order_acquire);
+  if (!code) {
+    size_t threshold = atomic_load_explicit(&jit_threshold, memory_order_relaxed);
+    if (threshold == 0) {
+      return false;
+    }
+    // Only the evaluation that hits the threshold compiles, so a program
+    // is compiled at most once even when many threads share it.
+    size_t evals = atomic_fetch_add_explicit(&state->evals, 1, memory_order_relaxed) + 1;
+    if (evals != threshold) {
+      return false;
+    }
+    code = JitCompile(program);
+    if (!code) {
+      return false;
+    }
+    atomic_store_explicit(&state->code, code, memory_order_release);
+  }
+  *res = JitCall(code, vars);
+  return true;
+}
+
+void BasicJitStateDestroy(BasicJitState* state) {
+  BasicJitCode* code = atomic_load_explicit(&state->code, memory_order_acquire);
+  if (code) {
+    JitFree(code);
+  }
+}
+
+void BasicJitStateReset(BasicJitState* state) {
+  BasicJitCode* code = atomic_exchange_explicit(&state->code, NULL, memory_order_acq_rel);
+  if (code) {
+    JitFree(code);
+  }
+  atomic_store_explicit(&state->evals, 0, memory_order_relaxed);
+}
+
+void CALL_CONV BasicSetJitThreshold(size_t threshold) {
+  atomic_store_explicit(&jit_threshold, threshold, memory_order_relaxed);
+}
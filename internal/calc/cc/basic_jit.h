@@ -0,0 +1,26 @@
+#ifndef SMARTCALC_INTERNAL_CALC_CC_CORE_BASIC_JIT_H_
+#define SMARTCALC_INTERNAL_CALC_CC_CORE_BASIC_JIT_H_
+
+#include "basic_program.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct BasicJitCode BasicJitCode;
+
+// Tiering state of a program handle. Every evaluation is counted and the
+// one that reaches the threshold compiles the program, later evaluations
+// call the native code once it is published.
+typedef struct BasicJitState {
+  atomic_size_t evals;
+  _Atomic(BasicJitCode*) code;
+} BasicJitState;
+
+extern bool BasicJitTryEval(const BasicProgram* program, const double* vars, double* res);
+extern void BasicJitStateDestroy(BasicJitState* state);
+// Drops the native code of a program whose instructions changed, it is
+// compiled again from the new ones once the threshold is reached.
+extern void BasicJitStateReset(BasicJitState* state);
+
+#endif // SMARTCALC_INTERNAL_CALC_CC_CORE_BASIC_JIT_H_
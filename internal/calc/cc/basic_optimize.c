@@ -0,0 +1,236 @@
+#include "basic_calc.h"
+#include "basic_jit.h"
+#include "basic_program.h"
+#include "util/counters.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const size_t kNoNode = SIZE_MAX;
+
+// Node of the expression graph rebuilt from the postfix program.
+// Operands always have smaller indices than the node using them.
+typedef struct {
+  BasicInstr instr;
+  size_t lhs;
+  size_t rhs;
+  size_t uses;
+  size_t slot;
+} OptimizeNode;
+
+typedef struct {
+  OptimizeNode* nodes;
+  size_t size;
+  size_t* table;
+  size_t table_mask;
+} OptimizeGraph;
+
+typedef struct {
+  size_t node;
+  int stage;
+} OptimizeFrame;
+
+static inline uint64_t HashMix(uint64_t hash, uint64_t val) {
+  hash ^= val + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+  return hash;
+}
+
+static inline uint64_t NodeHash(const OptimizeNode* node) {
+  uint64_t hash = HashMix(0, (uint64_t)node->instr.type);
+  if (node->instr.type == kBasicInstrNumber) {
+    uint64_t bits;
+    memcpy(&bits, &node->instr.number, sizeof(bits));
+    hash = HashMix(hash, bits);
+  } else if (node->instr.type == kBasicInstrOperation) {
+    hash = HashMix(hash, (uint64_t)node->instr.op);
+  } else if (node->instr.type == kBasicInstrVariable) {
+    hash = HashMix(hash, (uint64_t)node->instr.slot);
+  }
+  hash = HashMix(hash, (uint64_t)node->lhs);
+  return HashMix(hash, (uint64_t)node->rhs);
+}
+
+static inline bool NodeEqual(const OptimizeNode* lhs, const OptimizeNode* rhs) {
+  if (lhs->instr.type != rhs->instr.type || lhs->lhs != rhs->lhs || lhs->rhs != rhs->rhs) {
+    return false;
+  }
+  if (lhs->instr.type == kBasicInstrNumber) {
+    return memcmp(&lhs->instr.number, &rhs->instr.number, sizeof(double)) == 0;
+  }
+  if (lhs->instr.type == kBasicInstrOperation) {
+    return lhs->instr.op == rhs->instr.op;
+  }
+  if (lhs->instr.type == kBasicInstrVariable) {
+    return lhs->instr.slot == rhs->instr.slot;
+  }
+  return true;
+}
+
+// Returns the index of a node equal to the given one, adding it first if
+// there is none yet. Equal operations over equal operands are merged here.
+static size_t GraphIntern(OptimizeGraph* graph, const OptimizeNode* node) {
+  size_t idx = (size_t)NodeHash(node) & graph->table_mask;
+  for (; graph->table[idx] != kNoNode; idx = (idx + 1) & graph->table_mask) {
+    if (NodeEqual(graph->nodes + graph->table[idx], node)) {
+      return graph->table[idx];
+    }
+  }
+  graph->nodes[graph->size] = *node;
+  graph->table[idx] = graph->size;
+  return graph->size++;
+}
+
+static inline bool IsNumber(const OptimizeGraph* graph, size_t idx) {
+  return idx == kNoNode || graph->nodes[idx].instr.type == kBasicInstrNumber;
+}
+
+// Folds operations whose operands are all numbers. The values are computed
+// with the same functions the evaluator calls, so results stay bit-identical.
+// Stores and loads of an already optimized program become edges again.
+static size_t GraphBuild(OptimizeGraph* graph, const BasicProgram* program, size_t* stack, size_t* temps) {
+  size_t top = 0;
+  for (size_t i = 0; i < program->size; ++i) {
+    OptimizeNode node = {.instr = program->instrs[i], .lhs = kNoNode, .rhs = kNoNode};
+    if (node.instr.type == kBasicInstrStore) {
+      temps[node.instr.slot] = stack[top - 1];
+      continue;
+    }
+    if (node.instr.type == kBasicInstrLoad) {
+      stack[top++] = temps[node.instr.slot];
+      continue;
+    }
+    if (node.instr.type == kBasicInstrOperation) {
+      node.rhs = stack[--top];
+      if (!MathOperationIsUnary(node.instr.op)) {
+        node.lhs = stack[--top];
+      }
+      if (IsNumber(graph, node.lhs) && IsNumber(graph, node.rhs)) {
+        double lhs = (node.lhs == kNoNode) ? 0.0 : graph->nodes[node.lhs].instr.number;
+        double rhs = graph->nodes[node.rhs].instr.number;
+        node = (OptimizeNode){
+          .instr = {.type = kBasicInstrNumber,
+                    .number = BasicOperationApply(node.instr.op, lhs, rhs)},
+          .lhs = kNoNode,
+          .rhs = kNoNode
+        };
+      }
+    }
+    stack[top++] = GraphIntern(graph, &node);
+  }
+  return stack[0];
+}
+
+static void GraphCountUses(OptimizeGraph* graph, size_t root) {
+  graph->nodes[root].uses = 1;
+  for (size_t i = root + 1; i-- > 0;) {
+    OptimizeNode* node = graph->nodes + i;
+    if (node->uses == 0) {
+      continue;
+    }
+    if (node->lhs != kNoNode) {
+      ++graph->nodes[node->lhs].uses;
+    }
+    if (node->rhs != kNoNode) {
+      ++graph->nodes[node->rhs].uses;
+    }
+  }
+}
+
+static inline bool IsLeaf(const OptimizeNode* node) {
+  return node->instr.type != kBasicInstrOperation;
+}
+
+// Writes the graph back in postfix order. A shared operation is computed
+// once and kept in a temp slot, every later use loads it from there.
+static void GraphEmit(OptimizeGraph* graph, size_t root, OptimizeFrame* frames, BasicProgram* program) {
+  size_t size = 0, depth = 0, max_depth = 0, temps = 0;
+  size_t top = 0;
+  frames[top++] = (OptimizeFrame){.node = root};
+  while (top) {
+    OptimizeFrame* frame = frames + top - 1;
+    OptimizeNode* node = graph->nodes + frame->node;
+    if (frame->stage == 0 && (IsLeaf(node) || node->slot)) {
+      if (IsLeaf(node)) {
+        program->instrs[size++] = node->instr;
+      } else {
+        program->instrs[size++] = (BasicInstr){.type = kBasicInstrLoad, .slot = node->slot - 1};
+      }
+      if (++depth > max_depth) {
+        max_depth = depth;
+      }
+      --top;
+    } else if (frame->stage == 0) {
+      frame->stage = 1;
+      if (node->lhs != kNoNode) {
+        frames[top++] = (OptimizeFrame){.node = node->lhs};
+      }
+    } else if (frame->stage == 1) {
+      frame->stage = 2;
+      frames[top++] = (OptimizeFrame){.node = node->rhs};
+    } else {
+      program->instrs[size++] = node->instr;
+      if (node->lhs != kNoNode) {
+        --depth;
+      }
+      if (node->uses > 1) {
+        node->slot = ++temps;
+        program->instrs[size++] = (BasicInstr){.type = kBasicInstrStore, .slot = node->slot - 1};
+      }
+      --top;
+    }
+  }
+  program->size = size;
+  program->depth = max_depth;
+  program->temps = temps;
+}
+
+static size_t CountOperations(const BasicProgram* program) {
+  size_t count = 0;
+  for (size_t i = 0; i < program->size; ++i) {
+    count += program->instrs[i].type == kBasicInstrOperation;
+  }
+  return count;
+}
+
+BasicCalcError CALL_CONV BasicProgramOptimize(BasicProgram* program, size_t* removed) {
+  size_t table_size = 1;
+  while (table_size < program->size * 2) {
+    table_size <<= 1;
+  }
+  // The graph never has more nodes than the program has instructions, and
+  // the rewritten program is never longer than the original, since a load
+  // replaces a subtree of at least two instructions.
+  void* block = CountersMalloc(program->size * (sizeof(OptimizeNode) + sizeof(OptimizeFrame)) +
+                       (table_size + program->temps) * sizeof(size_t));
+  if (!block) {
+    return kBasicCalcAllocationFail;
+  }
+  OptimizeGraph graph = {
+    .nodes = (OptimizeNode*)block,
+    .table = (size_t*)((OptimizeNode*)block + program->size),
+    .table_mask = table_size - 1
+  };
+  size_t* temps = graph.table + table_size;
+  OptimizeFrame* frames = (OptimizeFrame*)(temps + program->temps);
+  for (size_t i = 0; i < table_size; ++i) {
+    graph.table[i] = kNoNode;
+  }
+  size_t ops_before = CountOperations(program);
+  // The frames memory doubles as the operand stack while building.
+  size_t root = GraphBuild(&graph, program, (size_t*)frames, temps);
+  GraphCountUses(&graph, root);
+  GraphEmit(&graph, root, frames, program);
+  // The program only got shorter, its bytecode still fits where it was.
+  if (program->code) {
+    BasicInterpTranslate(program->instrs, program->size, program->code);
+  }
+  if (program->jit) {
+    BasicJitStateReset(program->jit);
+  }
+  if (removed) {
+    *removed = ops_before - CountOperations(program);
+  }
+  free(block);
+  return kBasicCalcErrorSuccess;
+}
@@ -0,0 +1,92 @@
+#ifndef SMARTCALC_INTERNAL_CALC_CC_CORE_BASIC_PROGRAM_H_
+#define SMARTCALC_INTERNAL_CALC_CC_CORE_BASIC_PROGRAM_H_
+
+#include "basic_calc.h"
+#include "util/math_operation.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+  kBasicInstrNumber,
+  kBasicInstrVariable,
+  kBasicInstrOperation,
+  kBasicInstrStore,
+  kBasicInstrLoad
+} BasicInstrType;
+
+// Variable pushes the value bound to slot. Store copies the top of the
+// stack into temp slot without popping it, Load pushes the slot back.
+// The optimizer uses them for subexpressions that are shared.
+typedef struct {
+  BasicInstrType type;
+  union {
+    double number;
+    enum MathOperationIdx op;
+    size_t slot;
+  };
+} BasicInstr;
+
+// Instruction of the bytecode interpreter, made from the postfix program
+// by BasicInterpTranslate. Opcodes are private to basic_interp.c.
+typedef struct {
+  unsigned op;
+  union {
+    double number;
+    size_t slot;
+  };
+} BasicCode;
+
+// Flat postfix form of an expression. Every instruction is checked
+// at compile time, so evaluation never underflows and never needs
+// more than depth stack slots plus temps slots for stored values.
+// vars is the number of values an evaluation binds, x takes slot 0.
+struct BasicProgram {
+  BasicInstr* instrs;
+  size_t size;
+  size_t depth;
+  size_t temps;
+  size_t vars;
+  // Only set for handles made by BasicCompileExpr and BasicCompileVars.
+  struct BasicJitState* jit;
+  BasicCode* code;
+};
+
+extern BasicCalcError BasicProgramInit(const char* math_expr, bool allow_x, BasicProgram* program);
+extern void BasicProgramDestroy(BasicProgram* program);
+// What BasicCalculateExpr and BasicCalculateEquation do, with x already parsed.
+extern BasicCalcError BasicCalculate(const char* math_expr, bool allow_x, double x, double* res);
+
+extern const MathOperation* BasicOperationGet(enum MathOperationIdx op);
+// Applies a single operation, unary operations take their operand in rhs.
+extern double BasicOperationApply(enum MathOperationIdx op, double lhs, double rhs);
+
+// Division and mod by zero give DBL_MAX and DBL_MIN, every evaluator
+// goes through these.
+static inline double BasicDivide(double lhs, double rhs) {
+  return rhs == 0 ? DBL_MAX : lhs / rhs;
+}
+
+static inline double BasicFmod(double lhs, double rhs) {
+  return rhs == 0 ? DBL_MIN : fmod(lhs, rhs);
+}
+
+// Fills code, which has room for size + 1 entries, and returns how many
+// it used. Operands and negations are folded into the operations using
+// them, the last entry ends the program.
+extern size_t BasicInterpTranslate(const BasicInstr* instrs, size_t size, BasicCode* code);
+// stack holds temps + depth values of the program code was made from.
+extern double BasicInterpRun(const BasicCode* code, const double* vars, double* stack, size_t temps);
+
+// '^' is right associative: it leaves a pending '^' on the stack so that
+// a^b^c reduces as a^(b^c). Everything else is left associative.
+static inline bool BasicReducesBefore(const MathOperation* op, const MathOperation* top) {
+  if (op->priority == kExponent) {
+    return op->priority < top->priority;
+  }
+  return op->priority <= top->priority;
+}
+
+#endif // SMARTCALC_INTERNAL_CALC_CC_CORE_BASIC_PROGRAM_H_
@@ -0,0 +1,239 @@
+#include "basic_calc.h"
+#include "basic_program.h"
+#include "util/counters.h"
+#include "util/simd.h"
+
+#include <float.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { kRangeBlockSize = 256 };
+
+static inline void ColumnApply(double (*function)(double), double* restrict col, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    col[i] = function(col[i]);
+  }
+}
+
+static inline uint64_t DoubleBits(double num) {
+  uint64_t bits;
+  memcpy(&bits, &num, sizeof(bits));
+  return bits;
+}
+
+static inline bool IsZero(double num) {
+  return (DoubleBits(num) << 1) == 0;
+}
+
+// Integer blend of two doubles. gcc will not if-convert a ?: on doubles
+// under -ftrapping-math, this form lets the division loop vectorize.
+static inline double Select(bool cond, double if_true, double if_false) {
+  uint64_t mask = -(uint64_t)cond;
+  uint64_t bits = (DoubleBits(if_true) & mask) | (DoubleBits(if_false) & ~mask);
+  double num;
+  memcpy(&num, &bits, sizeof(num));
+  return num;
+}
+
+SIMD_DISPATCH
+static void ColumnUnary(enum MathOperationIdx op, double* restrict col, size_t size) {
+  switch (op) {
+    case kUnaryMinus:
+      for (size_t i = 0; i < size; ++i) {
+        col[i] = -col[i];
+      }
+      break;
+    case kSqrt:
+      ColumnApply(sqrt, col, size);
+      break;
+    case kSin:
+      ColumnApply(sin, col, size);
+      break;
+    case kCos:
+      ColumnApply(cos, col, size);
+      break;
+    case kTan:
+      ColumnApply(tan, col, size);
+      break;
+    case kAsin:
+      ColumnApply(asin, col, size);
+      break;
+    case kAcos:
+      ColumnApply(acos, col, size);
+      break;
+    case kAtan:
+      ColumnApply(atan, col, size);
+      break;
+    case kLn:
+      ColumnApply(log, col, size);
+      break;
+    case kLog:
+      ColumnApply(log10, col, size);
+      break;
+    default:
+      break;
+  }
+}
+
+// Mirrors the scalar functions of op_map in basic_calc.c, including the
+// DBL_MAX and DBL_MIN results on a zero divisor, so both evaluators agree
+// bit for bit.
+SIMD_DISPATCH
+static void ColumnBinary(enum MathOperationIdx op,
+                         double* restrict lhs,
+                         const double* restrict rhs,
+                         size_t size) {
+  switch (op) {
+    case kPower:
+      for (size_t i = 0; i < size; ++i) {
+        lhs[i] = pow(lhs[i], rhs[i]);
+      }
+      break;
+    case kMultiply:
+      for (size_t i = 0; i < size; ++i) {
+        lhs[i] = lhs[i] * rhs[i];
+      }
+      break;
+    case kDivision:
+      for (size_t i = 0; i < size; ++i) {
+        lhs[i] = Select(IsZero(rhs[i]), DBL_MAX, lhs[i] / rhs[i]);
+      }
+      break;
+    case kFmod:
+      for (size_t i = 0; i < size; ++i) {
+        lhs[i] = (rhs[i] == 0) ? DBL_MIN : fmod(lhs[i], rhs[i]);
+      }
+      break;
+    case kPlus:
+      for (size_t i = 0; i < size; ++i) {
+        lhs[i] = lhs[i] + rhs[i];
+      }
+      break;
+    case kMinus:
+      for (size_t i = 0; i < size; ++i) {
+        lhs[i] = lhs[i] - rhs[i];
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+static void EvalBlock(const BasicProgram* program, const double* x, size_t size, double* cols, double* res) {
+  double* temps = cols;
+  double* bottom = cols + program->temps * kRangeBlockSize;
+  // Columns on the value stack, the top one is bottom + (depth - 1) blocks.
+  size_t depth = 0;
+  for (size_t i = 0; i < program->size; ++i) {
+    const BasicInstr* instr = program->instrs + i;
+    double* top = bottom + depth * kRangeBlockSize;
+    if (instr->type == kBasicInstrNumber) {
+      for (size_t j = 0; j < size; ++j) {
+        top[j] = instr->number;
+      }
+      ++depth;
+    } else if (instr->type == kBasicInstrVariable) {
+      memcpy(top, x, size * sizeof(double));
+      ++depth;
+    } else if (instr->type == kBasicInstrStore) {
+      memcpy(temps + instr->slot * kRangeBlockSize, top - kRangeBlockSize, size * sizeof(double));
+    } else if (instr->type == kBasicInstrLoad) {
+      memcpy(top, temps + instr->slot * kRangeBlockSize, size * sizeof(double));
+      ++depth;
+    } else if (MathOperationIsUnary(instr->op)) {
+      ColumnUnary(instr->op, top - kRangeBlockSize, size);
+    } else {
+      --depth;
+      ColumnBinary(instr->op, top - 2 * kRangeBlockSize, top - kRangeBlockSize, size);
+    }
+  }
+  memcpy(res, bottom, size * sizeof(double));
+}
+
+// Evaluates the program column-wise, kRangeBlockSize points at a time.
+// Temp slots take the first columns, the value stack the ones after.
+// When x is NULL the points are x_start + i * x_step.
+static BasicCalcError EvalRange(const BasicProgram* program,
+                                const double* x,
+                                double x_start,
+                                double x_step,
+                                size_t size,
+                                double* res) {
+  size_t cols_size = program->temps + program->depth;
+  double* cols = (double*)CountersMalloc((cols_size + 1) * kRangeBlockSize * sizeof(double));
+  if (!cols) {
+    return kBasicCalcAllocationFail;
+  }
+  double* x_col = cols + cols_size * kRangeBlockSize;
+  for (size_t offset = 0; offset < size; offset += kRangeBlockSize) {
+    size_t block_size = size - offset < kRangeBlockSize ? size - offset : kRangeBlockSize;
+    if (x) {
+      memcpy(x_col, x + offset, block_size * sizeof(double));
+    } else {
+      for (size_t i = 0; i < block_size; ++i) {
+        x_col[i] = x_start + (double)(offset + i) * x_step;
+      }
+    }
+    EvalBlock(program, x_col, block_size, cols, res + offset);
+  }
+  free(cols);
+  return kBasicCalcErrorSuccess;
+}
+
+static void FillErrors(BasicCalcError* errors, size_t size, BasicCalcError error) {
+  if (!errors) {
+    return;
+  }
+  for (size_t i = 0; i < size; ++i) {
+    errors[i] = error;
+  }
+}
+
+static BasicCalcError EvaluateRange(const char* math_expr,
+                                    const double* x,
+                                    double x_start,
+                                    double x_step,
+                                    size_t size,
+                                    double* res,
+                                    BasicCalcError* errors) {
+  BasicProgram program;
+  BasicCalcError error = BasicProgramInit(math_expr, true, &program);
+  if (error == kBasicCalcErrorSuccess) {
+    // Parts of the expression that do not depend on x fold into
+    // constants here, so they are computed once and not once per point.
+    error = BasicProgramOptimize(&program, NULL);
+    if (error == kBasicCalcErrorSuccess) {
+      error = EvalRange(&program, x, x_start, x_step, size, res);
+    }
+    BasicProgramDestroy(&program);
+  }
+  FillErrors(errors, size, error);
+  return error;
+}
+
+BasicCalcError CALL_CONV BasicProgramEvalRange(const BasicProgram* program, const double* x, size_t size, double* res) {
+  if (program->vars > 1) {
+    return kBasicCalcErrorInvalidArgument;
+  }
+  return EvalRange(program, x, 0.0, 0.0, size, res);
+}
+
+BasicCalcError CALL_CONV BasicEvaluateRange(const char* math_expr,
+                                            const double* x,
+                                            size_t size,
+                                            double* res,
+                                            BasicCalcError* errors) {
+  return EvaluateRange(math_expr, x, 0.0, 0.0, size, res, errors);
+}
+
+BasicCalcError CALL_CONV BasicEvaluateLinspace(const char* math_expr,
+                                               double x_start,
+                                               double x_step,
+                                               size_t size,
+                                               double* res,
+                                               BasicCalcError* errors) {
+  return EvaluateRange(math_expr, NULL, x_start, x_step, size, res, errors);
+}
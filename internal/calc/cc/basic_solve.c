@@ -0,0 +1,209 @@
+#include "basic_calc.h"
+#include "basic_program.h"
+#include "util/counters.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+enum { kSolveSegments = 1024, kSolveMaxIter = 100 };
+
+// Value of a subexpression together with its derivative by x.
+typedef struct {
+  double val;
+  double der;
+} Dual;
+
+static double DualDerivative(enum MathOperationIdx op, Dual lhs, Dual rhs, double res) {
+  double u = lhs.val, v = rhs.val;
+  switch (op) {
+    case kUnaryMinus:
+      return -rhs.der;
+    case kUnaryPlus:
+      return rhs.der;
+    case kSqrt:
+      return rhs.der / (2 * res);
+    case kSin:
+      return cos(v) * rhs.der;
+    case kCos:
+      return -sin(v) * rhs.der;
+    case kTan:
+      return rhs.der / (cos(v) * cos(v));
+    case kAsin:
+      return rhs.der / sqrt(1 - v * v);
+    case kAcos:
+      return -rhs.der / sqrt(1 - v * v);
+    case kAtan:
+      return rhs.der / (1 + v * v);
+    case kLn:
+      return rhs.der / v;
+    case kLog:
+      return rhs.der / (v * log(10.0));
+    case kPower:
+      if (rhs.der == 0) {
+        return v * pow(u, v - 1) * lhs.der;
+      }
+      return res * (rhs.der * log(u) + v * lhs.der / u);
+    case kMultiply:
+      return lhs.der * v + u * rhs.der;
+    case kDivision:
+      return (lhs.der * v - u * rhs.der) / (v * v);
+    case kFmod:
+      return lhs.der - trunc(u / v) * rhs.der;
+    case kPlus:
+      return lhs.der + rhs.der;
+    case kMinus:
+      return lhs.der - rhs.der;
+    default:
+      return NAN;
+  }
+}
+
+static inline Dual DualApply(enum MathOperationIdx op, Dual lhs, Dual rhs) {
+  Dual res = {.val = BasicOperationApply(op, lhs.val, rhs.val)};
+  // Parts that do not depend on x stay exact zeros, so sqrt(0) and the
+  // like never turn a constant into a NaN slope.
+  if (lhs.der != 0 || rhs.der != 0) {
+    res.der = DualDerivative(op, lhs, rhs, res.val);
+  }
+  return res;
+}
+
+// Forward mode evaluation, the derivative is carried through every
+// instruction alongside the value. stack holds temps + depth entries.
+static Dual DualEval(const BasicProgram* program, double x, Dual* stack) {
+  Dual* top = stack + program->temps;
+  for (size_t i = 0; i < program->size; ++i) {
+    const BasicInstr* instr = program->instrs + i;
+    switch (instr->type) {
+      case kBasicInstrNumber:
+        *top++ = (Dual){.val = instr->number};
+        break;
+      case kBasicInstrVariable:
+        *top++ = (Dual){.val = x, .der = 1};
+        break;
+      case kBasicInstrStore:
+        stack[instr->slot] = top[-1];
+        break;
+      case kBasicInstrLoad:
+        *top++ = stack[instr->slot];
+        break;
+      case kBasicInstrOperation:
+        if (MathOperationIsUnary(instr->op)) {
+          top[-1] = DualApply(instr->op, (Dual){0}, top[-1]);
+        } else {
+          --top;
+          top[-1] = DualApply(instr->op, top[-1], top[0]);
+        }
+        break;
+    }
+  }
+  return top[-1];
+}
+
+// Newton iteration kept inside the bracket [a, b], a step that leaves it
+// or does not halve the bracket fast enough is replaced by bisection.
+static bool RefineRoot(const BasicProgram* program,
+                       Dual* stack,
+                       double a, double fa,
+                       double b, double fb,
+                       double tolerance,
+                       double* root) {
+  double lo = fa < 0 ? a : b;
+  double hi = fa < 0 ? b : a;
+  double r = 0.5 * (a + b);
+  double dx_old = fabs(b - a);
+  double dx = dx_old;
+  Dual f = DualEval(program, r, stack);
+  for (size_t iter = 0; iter < kSolveMaxIter && f.val != 0; ++iter) {
+    bool newton = isfinite(f.val) && isfinite(f.der) && f.der != 0;
+    if (newton) {
+      double next = r - f.val / f.der;
+      newton = (next - lo) * (next - hi) < 0 && fabs(2 * f.val) <= fabs(dx_old * f.der);
+    }
+    dx_old = dx;
+    if (newton) {
+      dx = f.val / f.der;
+      r -= dx;
+    } else {
+      dx = 0.5 * (hi - lo);
+      r = lo + dx;
+    }
+    if (fabs(dx) < tolerance) {
+      f = DualEval(program, r, stack);
+      break;
+    }
+    f = DualEval(program, r, stack);
+    if (f.val < 0) {
+      lo = r;
+    } else {
+      hi = r;
+    }
+  }
+  *root = r;
+  // A sign change across a pole, as in tan or 1/x, converges to the pole
+  // where |f| grows instead of vanishing.
+  return fabs(f.val) <= fmin(fabs(fa), fabs(fb));
+}
+
+static inline bool SignChanges(double fa, double fb) {
+  return (fa < 0 && fb > 0) || (fa > 0 && fb < 0);
+}
+
+static BasicCalcError SolveProgram(const BasicProgram* program,
+                                   double x_min,
+                                   double x_max,
+                                   double tolerance,
+                                   double* roots,
+                                   size_t max_roots,
+                                   size_t* count) {
+  // Sample points, their values and the dual stack share one allocation.
+  size_t points = kSolveSegments + 1;
+  void* block = CountersMalloc(2 * points * sizeof(double) + (program->temps + program->depth) * sizeof(Dual));
+  if (!block) {
+    return kBasicCalcAllocationFail;
+  }
+  double* x = (double*)block;
+  double* f = x + points;
+  Dual* stack = (Dual*)(f + points);
+  for (size_t i = 0; i < kSolveSegments; ++i) {
+    x[i] = x_min + (x_max - x_min) * (double)i / kSolveSegments;
+  }
+  x[kSolveSegments] = x_max;
+  BasicCalcError error = BasicProgramEvalRange(program, x, points, f);
+  for (size_t i = 0; error == kBasicCalcErrorSuccess && i < points && *count < max_roots; ++i) {
+    double root;
+    if (f[i] == 0) {
+      roots[(*count)++] = x[i];
+    } else if (i + 1 < points && SignChanges(f[i], f[i + 1]) &&
+               RefineRoot(program, stack, x[i], f[i], x[i + 1], f[i + 1], tolerance, &root)) {
+      roots[(*count)++] = root;
+    }
+  }
+  free(block);
+  return error;
+}
+
+BasicCalcError CALL_CONV BasicSolveEquation(const char* math_expr,
+                                            double x_min,
+                                            double x_max,
+                                            double tolerance,
+                                            double* roots,
+                                            size_t max_roots,
+                                            size_t* count) {
+  *count = 0;
+  if (!isfinite(x_min) || !isfinite(x_max) || !(x_min < x_max) || !(tolerance > 0)) {
+    return kBasicCalcErrorInvalidArgument;
+  }
+  BasicProgram program;
+  BasicCalcError error = BasicProgramInit(math_expr, true, &program);
+  if (error != kBasicCalcErrorSuccess) {
+    return error;
+  }
+  error = BasicProgramOptimize(&program, NULL);
+  if (error == kBasicCalcErrorSuccess) {
+    error = SolveProgram(&program, x_min, x_max, tolerance, roots, max_roots, count);
+  }
+  BasicProgramDestroy(&program);
+  return error;
+}
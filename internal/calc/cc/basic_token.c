@@ -0,0 +1,378 @@
+#include "basic_token.h"
+#include "util/parse_double.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#   include <emmintrin.h>
+#   define TOKEN_SSE2 1
+#   if defined(_MSC_VER) && !defined(__clang__)
+#       include <intrin.h>
+#   endif
+#else
+#   define TOKEN_SSE2 0
+#endif
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ || defined(_WIN32)
+#   define TOKEN_SWAR 1
+#else
+#   define TOKEN_SWAR 0
+#endif
+
+// What the lexer does with a character. Names come last so that a single
+// compare tells whether a bound variable may start there.
+typedef enum {
+  kCharOther = 0,
+  kCharBlank,
+  kCharDigit,
+  kCharPower,
+  kCharMultiply,
+  kCharDivision,
+  kCharPlus,
+  kCharMinus,
+  kCharOpenBrace,
+  kCharCloseBrace,
+  kCharFunction,
+  kCharMod,
+  kCharX,
+  kCharLetter
+} CharClass;
+
+#define BLANK(c) [c] = kCharBlank
+#define LETTERS(a, b, c, d, e, f, g, h) \
+  [a] = kCharLetter, [b] = kCharLetter, [c] = kCharLetter, [d] = kCharLetter, \
+  [e] = kCharLetter, [f] = kCharLetter, [g] = kCharLetter, [h] = kCharLetter
+
+static const unsigned char kCharClass[256] = {
+    BLANK(' '), BLANK('\n'), BLANK('\t'),
+    ['0'] = kCharDigit, ['1'] = kCharDigit, ['2'] = kCharDigit, ['3'] = kCharDigit, ['4'] = kCharDigit,
+    ['5'] = kCharDigit, ['6'] = kCharDigit, ['7'] = kCharDigit, ['8'] = kCharDigit, ['9'] = kCharDigit,
+    ['^'] = kCharPower, ['*'] = kCharMultiply, ['/'] = kCharDivision,
+    ['+'] = kCharPlus, ['-'] = kCharMinus,
+    ['('] = kCharOpenBrace, [')'] = kCharCloseBrace,
+    LETTERS('A', 'B', 'C', 'D', 'E', 'F', 'G', 'H'),
+    LETTERS('I', 'J', 'K', 'L', 'M', 'N', 'O', 'P'),
+    LETTERS('Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X'),
+    ['Y'] = kCharLetter, ['Z'] = kCharLetter, ['_'] = kCharLetter,
+    LETTERS('b', 'd', 'e', 'f', 'g', 'h', 'i', 'j'),
+    LETTERS('k', 'n', 'o', 'p', 'q', 'r', 'u', 'v'),
+    ['w'] = kCharLetter, ['y'] = kCharLetter, ['z'] = kCharLetter,
+    ['a'] = kCharFunction, ['c'] = kCharFunction, ['l'] = kCharFunction,
+    ['s'] = kCharFunction, ['t'] = kCharFunction,
+    ['m'] = kCharMod, ['x'] = kCharX
+};
+
+#undef LETTERS
+#undef BLANK
+
+// Digits that always fit a uint64_t.
+enum { kDecimalDigits = 19 };
+
+typedef struct {
+  const char* name;
+  size_t len;
+  enum MathOperationIdx op;
+} FunctionName;
+
+// Each name carries its opening brace. asqrt( is read as sqrt( because
+// the old matcher skipped an arc prefix before looking at sqrt.
+static const FunctionName kFunctionNames[] = {
+    {"sin(", 4, kSin},
+    {"sqrt(", 5, kSqrt},
+    {"cos(", 4, kCos},
+    {"tan(", 4, kTan},
+    {"ln(", 3, kLn},
+    {"log(", 4, kLog},
+    {"asin(", 5, kAsin},
+    {"acos(", 5, kAcos},
+    {"atan(", 5, kAtan},
+    {"asqrt(", 6, kSqrt}
+};
+
+static inline CharClass ClassOf(char c) {
+  return (CharClass)kCharClass[(unsigned char)c];
+}
+
+static inline bool IsNameChar(char c) {
+  CharClass char_class = ClassOf(c);
+  return char_class >= kCharFunction || char_class == kCharDigit;
+}
+
+static inline int CountTrailingZeros(unsigned val) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctz(val);
+#elif defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, val);
+  return (int)index;
+#else
+  int count = 0;
+  for (; !(val & 1); val >>= 1) {
+    ++count;
+  }
+  return count;
+#endif
+}
+
+// Skips a run of blanks, 16 characters a compare where sse2 is there.
+static const char* SkipBlanks(const char* ptr, const char* end) {
+#if TOKEN_SSE2
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i tab = _mm_set1_epi8('\t');
+  while (end - ptr >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i*)ptr);
+    __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+                                 _mm_or_si128(_mm_cmpeq_epi8(chunk, newline), _mm_cmpeq_epi8(chunk, tab)));
+    unsigned other = ~(unsigned)_mm_movemask_epi8(blank) & 0xFFFF;
+    if (other) {
+      return ptr + CountTrailingZeros(other);
+    }
+    ptr += 16;
+  }
+#endif
+  while (ptr < end && ClassOf(*ptr) == kCharBlank) {
+    ++ptr;
+  }
+  return ptr;
+}
+
+// Length of the run of digits at ptr, 16 characters a compare where sse2
+// is there.
+static size_t DigitRun(const char* ptr, const char* end) {
+  const char* start = ptr;
+#if TOKEN_SSE2
+  const __m128i below = _mm_set1_epi8('0');
+  const __m128i above = _mm_set1_epi8('9');
+  while (end - ptr >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i*)ptr);
+    // Bytes past 0x7F compare as negative, so they are below '0' too.
+    __m128i other = _mm_or_si128(_mm_cmpgt_epi8(below, chunk), _mm_cmpgt_epi8(chunk, above));
+    unsigned mask = (unsigned)_mm_movemask_epi8(other);
+    if (mask) {
+      return (size_t)(ptr - start) + (size_t)CountTrailingZeros(mask);
+    }
+    ptr += 16;
+  }
+#endif
+  while (ptr < end && ClassOf(*ptr) == kCharDigit) {
+    ++ptr;
+  }
+  return (size_t)(ptr - start);
+}
+
+// Adds len digits at ptr to value. Eight of them are read at once with a
+// few multiplications (Mula and Lemire) on little-endian targets.
+static inline uint64_t DigitsValue(const char* ptr, size_t len, uint64_t value) {
+#if TOKEN_SWAR
+  for (; len >= 8; ptr += 8, len -= 8) {
+    uint64_t chunk;
+    memcpy(&chunk, ptr, sizeof(chunk));
+    chunk -= 0x3030303030303030;
+    chunk = chunk * 10 + (chunk >> 8);
+    chunk = ((chunk & 0x000000FF000000FF) * 0x000F424000000064 +
+             ((chunk >> 16) & 0x000000FF000000FF) * 0x0000271000000001) >> 32;
+    value = value * 100000000 + (chunk & 0xFFFFFFFF);
+  }
+#endif
+  for (size_t i = 0; i < len; ++i) {
+    value = value * 10 + (uint64_t)(ptr[i] - '0');
+  }
+  return value;
+}
+
+// Reads a plain decimal number, digits with an optional fraction, when
+// all of its digits fit in a uint64_t. Numbers with an exponent or a hex
+// prefix and longer ones are left to ParseDouble.
+static bool ReadDecimal(const char** ptr_ptr, const char* end, double* number) {
+  const char* ptr = *ptr_ptr;
+  size_t whole = DigitRun(ptr, end);
+  const char* stop = ptr + whole;
+  size_t fraction = 0;
+  if (*stop == '.') {
+    fraction = DigitRun(stop + 1, end);
+    stop += 1 + fraction;
+  }
+  if (whole + fraction > kDecimalDigits || *stop == '.' ||
+      *stop == 'e' || *stop == 'E' || *stop == 'x' || *stop == 'X') {
+    return false;
+  }
+  uint64_t value = DigitsValue(ptr, whole, 0);
+  value = DigitsValue(ptr + whole + 1, fraction, value);
+  *ptr_ptr = stop;
+  *number = DecimalToDouble(value, -(int)fraction);
+  return true;
+}
+
+// Matches the whole name at ptr against the bound names, so "rate" never
+// matches a bound "r" and "mod" or "sin(" stay operators and functions.
+static bool FindVariable(const char** ptr_ptr, const BasicVarNames* vars, size_t* slot) {
+  const char* end = *ptr_ptr;
+  while (IsNameChar(*end)) {
+    ++end;
+  }
+  size_t len = (size_t)(end - *ptr_ptr);
+  for (size_t i = 0; i < vars->size; ++i) {
+    if (strncmp(vars->names[i], *ptr_ptr, len) == 0 && vars->names[i][len] == '\0') {
+      *ptr_ptr = end;
+      *slot = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool FindFunction(const char** ptr_ptr, enum MathOperationIdx* function) {
+  const char* ptr = *ptr_ptr;
+  for (size_t i = 0; i < sizeof(kFunctionNames) / sizeof(kFunctionNames[0]); ++i) {
+    const FunctionName* name = kFunctionNames + i;
+    // The text ends with '\0', which never matches, so this stops in time.
+    size_t len = 0;
+    while (len < name->len && name->name[len] == ptr[len]) {
+      ++len;
+    }
+    if (len == name->len) {
+      *ptr_ptr = ptr + len;
+      *function = name->op;
+      return true;
+    }
+  }
+  return false;
+}
+
+BasicLexer BasicLexerNew(const char* math_expr, bool allow_x, const BasicVarNames* vars) {
+  return (BasicLexer){
+    .ptr = math_expr,
+    .end = math_expr + strlen(math_expr),
+    .allow_x = allow_x,
+    .vars = vars
+  };
+}
+
+static inline BasicToken OperatorToken(enum MathOperationIdx op) {
+  return (BasicToken){.type = kBasicTokenOperator, .op = op};
+}
+
+static inline BasicToken ErrorToken(BasicCalcError error) {
+  return (BasicToken){.type = kBasicTokenError, .error = error};
+}
+
+// ^ * / and mod need an operand on their left, + and - without one are
+// signs.
+static inline BasicToken BinaryToken(bool after_operand, enum MathOperationIdx op) {
+  return after_operand ? OperatorToken(op) : ErrorToken(kBasicCalcErrorIncorrectOperatorUsage);
+}
+
+size_t BasicLex(BasicLexer* lexer, BasicToken* tokens, size_t cap) {
+  const char* ptr = lexer->ptr;
+  const char* end = lexer->end;
+  const BasicVarNames* vars = lexer->vars;
+  bool after_operand = lexer->after_operand;
+  size_t size = 0;
+  while (size < cap && ptr < end) {
+    BasicToken* token = tokens + size;
+    CharClass char_class = ClassOf(*ptr);
+    if (vars && char_class >= kCharFunction && FindVariable(&ptr, vars, &token->slot)) {
+      token->type = kBasicTokenVariable;
+      after_operand = true;
+      ++size;
+      continue;
+    }
+    switch (char_class) {
+      case kCharBlank:
+        ++ptr;
+        if (ptr < end && ClassOf(*ptr) == kCharBlank) {
+          ptr = SkipBlanks(ptr, end);
+        }
+        continue;
+      case kCharDigit:
+        if (!ReadDecimal(&ptr, end, &token->number)) {
+          const char* stop = NULL;
+          token->number = ParseDouble(ptr, &stop);
+          if (stop == ptr) {
+            *token = ErrorToken(kBasicCalcErrorIncorrectNumberUsage);
+            break;
+          }
+          ptr = stop;
+        }
+        token->type = kBasicTokenNumber;
+        after_operand = true;
+        break;
+      case kCharPower:
+        *token = BinaryToken(after_operand, kPower);
+        after_operand = false;
+        ++ptr;
+        break;
+      case kCharMultiply:
+        *token = BinaryToken(after_operand, kMultiply);
+        after_operand = false;
+        ++ptr;
+        break;
+      case kCharDivision:
+        *token = BinaryToken(after_operand, kDivision);
+        after_operand = false;
+        ++ptr;
+        break;
+      case kCharPlus:
+        *token = OperatorToken(after_operand ? kPlus : kUnaryPlus);
+        after_operand = false;
+        ++ptr;
+        break;
+      case kCharMinus:
+        *token = OperatorToken(after_operand ? kMinus : kUnaryMinus);
+        after_operand = false;
+        ++ptr;
+        break;
+      case kCharMod:
+        if (ptr[1] != 'o' || ptr[2] != 'd') {
+          *token = ErrorToken(kBasicCalcErrorIncorrectFunctionUsage);
+          break;
+        }
+        *token = BinaryToken(after_operand, kFmod);
+        after_operand = false;
+        ptr += 3;
+        break;
+      case kCharOpenBrace:
+        token->type = kBasicTokenOpenBrace;
+        ++ptr;
+        break;
+      case kCharCloseBrace:
+        token->type = kBasicTokenCloseBrace;
+        ++ptr;
+        break;
+      case kCharX:
+        if (!lexer->allow_x) {
+          *token = ErrorToken(kBasicCalcErrorInvalidExpr);
+          break;
+        }
+        *token = (BasicToken){.type = kBasicTokenVariable, .slot = 0};
+        after_operand = true;
+        ++ptr;
+        break;
+      case kCharFunction:
+        if (!FindFunction(&ptr, &token->function)) {
+          *token = ErrorToken(kBasicCalcErrorIncorrectFunctionUsage);
+          break;
+        }
+        token->type = kBasicTokenFunction;
+        break;
+      default:
+        *token = ErrorToken(kBasicCalcErrorInvalidExpr);
+        break;
+    }
+    ++size;
+    if (token->type == kBasicTokenError) {
+      ptr = end;
+    }
+  }
+  lexer->ptr = ptr;
+  lexer->after_operand = after_operand;
+  return size;
+}
+
+bool BasicLexNext(BasicLexer* lexer, BasicToken* token, const char** start) {
+  lexer->ptr = SkipBlanks(lexer->ptr, lexer->end);
+  *start = lexer->ptr;
+  return BasicLex(lexer, token, 1) == 1;
+}
@@ -0,0 +1,60 @@
+#ifndef SMARTCALC_INTERNAL_CALC_CC_CORE_BASIC_TOKEN_H_
+#define SMARTCALC_INTERNAL_CALC_CC_CORE_BASIC_TOKEN_H_
+
+#include "basic_calc.h"
+#include "util/math_operation.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Names bound to variable slots, in slot order.
+typedef struct {
+  const char* const* names;
+  size_t size;
+} BasicVarNames;
+
+typedef enum {
+  kBasicTokenNumber,
+  kBasicTokenVariable,
+  // Already told unary from binary by what comes before it.
+  kBasicTokenOperator,
+  // A function name together with its opening brace.
+  kBasicTokenFunction,
+  kBasicTokenOpenBrace,
+  kBasicTokenCloseBrace,
+  // Ends the stream where the text stops being valid, the parser reports
+  // it only after everything in front of it, as the old one-pass loop did.
+  kBasicTokenError
+} BasicTokenType;
+
+typedef struct {
+  BasicTokenType type;
+  union {
+    double number;
+    size_t slot;
+    enum MathOperationIdx op;
+    enum MathOperationIdx function;
+    BasicCalcError error;
+  };
+} BasicToken;
+
+// Without vars, x is the only variable and only when allow_x is set.
+// after_operand says whether the last number, variable or operator read
+// was an operand, braces and functions leave it as it is.
+typedef struct {
+  const char* ptr;
+  const char* end;
+  bool allow_x;
+  bool after_operand;
+  const BasicVarNames* vars;
+} BasicLexer;
+
+extern BasicLexer BasicLexerNew(const char* math_expr, bool allow_x, const BasicVarNames* vars);
+// Fills up to cap tokens and returns how many, fewer than cap once the
+// text is consumed.
+extern size_t BasicLex(BasicLexer* lexer, BasicToken* tokens, size_t cap);
+// Reads a single token, start gets where it begins past the blanks in
+// front of it. Returns false once only blanks are left.
+extern bool BasicLexNext(BasicLexer* lexer, BasicToken* token, const char** start);
+
+#endif // SMARTCALC_INTERNAL_CALC_CC_CORE_BASIC_TOKEN_H_
@@ -0,0 +1,213 @@
+#include "bench.h"
+#include "../util/thread.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <time.h>
+#endif
+
+static const char* bench_filter = "";
+static double bench_time_ns = 1e9;
+static size_t bench_count = 1;
+static bool bench_failed = false;
+
+static volatile double bench_sink;
+
+static uint64_t NowNs(void) {
+#ifdef _WIN32
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER now;
+  if (!freq.QuadPart) {
+    QueryPerformanceFrequency(&freq);
+  }
+  QueryPerformanceCounter(&now);
+  return (uint64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// With glibc the allocator is replaced for the whole process, calls made
+// from the calc library included, to count allocations. Elsewhere the
+// B/op and allocs/op columns are left out.
+#ifdef __GLIBC__
+
+#define BENCH_COUNTS_ALLOCS 1
+
+static atomic_uint_fast64_t alloc_count;
+static atomic_uint_fast64_t alloc_bytes;
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+static inline void CountAlloc(size_t size) {
+  atomic_fetch_add_explicit(&alloc_count, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&alloc_bytes, size, memory_order_relaxed);
+}
+
+void* malloc(size_t size) {
+  CountAlloc(size);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+  CountAlloc(count * size);
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+  CountAlloc(size);
+  return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+  __libc_free(ptr);
+}
+
+static void AllocStats(uint64_t* count, uint64_t* bytes) {
+  *count = atomic_load_explicit(&alloc_count, memory_order_relaxed);
+  *bytes = atomic_load_explicit(&alloc_bytes, memory_order_relaxed);
+}
+
+#else
+
+#define BENCH_COUNTS_ALLOCS 0
+
+static void AllocStats(uint64_t* count, uint64_t* bytes) {
+  *count = *bytes = 0;
+}
+
+#endif // __GLIBC__
+
+void BenchStartTimer(Bench* b) {
+  if (!b->timing) {
+    AllocStats(&b->start_allocs, &b->start_alloc_bytes);
+    b->start_ns = NowNs();
+    b->timing = true;
+  }
+}
+
+void BenchStopTimer(Bench* b) {
+  if (b->timing) {
+    b->elapsed_ns += NowNs() - b->start_ns;
+    uint64_t allocs, bytes;
+    AllocStats(&allocs, &bytes);
+    b->allocs += allocs - b->start_allocs;
+    b->alloc_bytes += bytes - b->start_alloc_bytes;
+    b->timing = false;
+  }
+}
+
+void BenchResetTimer(Bench* b) {
+  if (b->timing) {
+    AllocStats(&b->start_allocs, &b->start_alloc_bytes);
+    b->start_ns = NowNs();
+  }
+  b->elapsed_ns = b->allocs = b->alloc_bytes = 0;
+}
+
+void BenchFail(Bench* b, const char* what, int code) {
+  if (!b->failed) {
+    fprintf(stderr, "    %s failed with code %d\n", what, code);
+  }
+  b->failed = true;
+}
+
+void BenchSink(double value) {
+  bench_sink = value;
+}
+
+bool BenchInit(int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+    char* end = NULL;
+    if (!strcmp(argv[i], "-bench") && value) {
+      bench_filter = value;
+    } else if (!strcmp(argv[i], "-benchtime") && value) {
+      bench_time_ns = strtod(value, &end) * 1e9;
+      if (end == value || *end || !(bench_time_ns > 0)) {
+        return false;
+      }
+    } else if (!strcmp(argv[i], "-count") && value) {
+      bench_count = strtoul(value, &end, 10);
+      if (end == value || *end || bench_count == 0) {
+        return false;
+      }
+    } else {
+      fprintf(stderr, "usage: %s [-bench substring] [-benchtime seconds] [-count n]\n", argv[0]);
+      return false;
+    }
+    ++i;
+  }
+  printf("pkg: calc_bench\n");
+  printf("cpus: %zu\n", ThreadHardwareConcurrency());
+  return true;
+}
+
+static void RunN(Bench* b, BenchFn fn, const void* arg, size_t n) {
+  *b = (Bench){.n = n};
+  BenchStartTimer(b);
+  fn(b, arg);
+  BenchStopTimer(b);
+}
+
+// Grows n like the go test runner does until one run lasts -benchtime.
+static void RunOnce(const char* name, BenchFn fn, const void* arg) {
+  Bench b;
+  size_t n = 1;
+  RunN(&b, fn, arg, n);
+  while (!b.failed && (double)b.elapsed_ns < bench_time_ns && n < 1000000000u) {
+    double per_op = b.elapsed_ns ? (double)b.elapsed_ns / (double)n : 1.0;
+    double next = 1.2 * bench_time_ns / per_op;
+    if (next > 100.0 * (double)n) {
+      next = 100.0 * (double)n;
+    }
+    if (next > 1e9) {
+      next = 1e9;
+    }
+    n = next > (double)n ? (size_t)next : n + 1;
+    RunN(&b, fn, arg, n);
+  }
+  if (b.failed) {
+    printf("--- FAIL: Benchmark%s\n", name);
+    bench_failed = true;
+    return;
+  }
+  double ns_per_op = (double)b.elapsed_ns / (double)b.n;
+  printf("Benchmark%s\t%10zu\t%14.1f ns/op", name, b.n, ns_per_op);
+  if (b.bytes) {
+    printf("\t%10.2f MB/s", (double)b.bytes * 1e3 / ns_per_op);
+  }
+  if (BENCH_COUNTS_ALLOCS) {
+    printf("\t%8.0f B/op\t%8.1f allocs/op", (double)b.alloc_bytes / (double)b.n, (double)b.allocs / (double)b.n);
+  }
+  if (b.items) {
+    printf("\t%12.0f items/s", (double)b.items * 1e9 / ns_per_op);
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+void BenchRun(const char* name, BenchFn fn, const void* arg) {
+  if (!strstr(name, bench_filter)) {
+    return;
+  }
+  for (size_t i = 0; i < bench_count; ++i) {
+    RunOnce(name, fn, arg);
+  }
+}
+
+int BenchFinish(void) {
+  printf(bench_failed ? "FAIL\n" : "PASS\n");
+  return bench_failed ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+#ifndef SMARTCALC_INTERNAL_CALC_CC_BENCH_BENCH_H_
+#define SMARTCALC_INTERNAL_CALC_CC_BENCH_BENCH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// State of one benchmark run, the function under test repeats its body
+// n times. Results are printed in the format of go test -bench, so runs
+// of different commits can be compared with benchstat.
+typedef struct {
+  size_t n;
+  // Per op, for the MB/s and items/s columns. 0 leaves a column out.
+  size_t bytes;
+  size_t items;
+
+  bool timing;
+  bool failed;
+  uint64_t start_ns;
+  uint64_t elapsed_ns;
+  uint64_t start_allocs;
+  uint64_t start_alloc_bytes;
+  uint64_t allocs;
+  uint64_t alloc_bytes;
+} Bench;
+
+typedef void (*BenchFn)(Bench* b, const void* arg);
+
+extern void BenchStartTimer(Bench* b);
+extern void BenchStopTimer(Bench* b);
+extern void BenchResetTimer(Bench* b);
+extern void BenchFail(Bench* b, const char* what, int code);
+
+// Parses -bench, -benchtime and -count. Returns false on a bad argument.
+extern bool BenchInit(int argc, char** argv);
+// Runs fn if name matches the -bench filter and prints its results.
+extern void BenchRun(const char* name, BenchFn fn, const void* arg);
+// 0 if every benchmark that ran succeeded.
+extern int BenchFinish(void);
+
+// Keeps a result alive so the call producing it is not optimized out.
+extern void BenchSink(double value);
+
+#endif // SMARTCALC_INTERNAL_CALC_CC_BENCH_BENCH_H_
@@ -0,0 +1,1247 @@
+#include "bench.h"
+#include "../basic_calc.h"
+#include "../credit_calc.h"
+#include "../defs.h"
+#include "../deposit_calc.h"
+#include "../util/thread.h"
+#include "../util/vector.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  kNestedDepth = 64,
+  kPowerTerms = 64,
+  kPowerChainSmall = 10 * 1024,
+  kPowerChainLarge = 100 * 1024,
+  kLongTerms = 2048,
+  kSumShortTerms = 26,
+  kSumLongTerms = 2501,
+  kArithTerms = 256,
+  kFormattedLines = 512,
+  kRangePoints = 4096,
+  kBatchSize = 4096,
+  kCurvePixels = 1000,
+  kCurveMaxPoints = 1 << 16,
+  kDepositStressCases = 2048,
+  kSweepRates = 8,
+  kSweepTerms = 6,
+  kSweepFreqs = 6,
+  kSweepPoints = kSweepRates * kSweepTerms * kSweepFreqs
+};
+
+static const char* const kEquationX = "1.5";
+static const double kEquationXValue = 1.5;
+
+typedef struct {
+  const char* name;
+  // Same shape, the equation has x in place of some numbers.
+  char* expr;
+  char* equation;
+} ExprCase;
+
+typedef struct {
+  char* data;
+  size_t size;
+  size_t cap;
+} Text;
+
+static void TextReserve(Text* text, size_t size) {
+  if (size + 1 > text->cap) {
+    text->cap = (size + 1) * 2;
+    text->data = (char*)realloc(text->data, text->cap);
+    if (!text->data) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+  }
+}
+
+static void TextAppend(Text* text, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  int size = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+  TextReserve(text, text->size + (size_t)size);
+  va_start(args, format);
+  vsnprintf(text->data + text->size, (size_t)size + 1, format, args);
+  va_end(args);
+  text->size += (size_t)size;
+}
+
+static void TextReplace(Text* text, size_t pos, size_t removed, const char* typed) {
+  size_t size = strlen(typed);
+  TextReserve(text, text->size - removed + size);
+  memmove(text->data + pos + size, text->data + pos + removed, text->size - pos - removed + 1);
+  memcpy(text->data + pos, typed, size);
+  text->size = text->size - removed + size;
+}
+
+static char* TextCopy(const char* str) {
+  Text text = {0};
+  TextAppend(&text, "%s", str);
+  return text.data;
+}
+
+static char* NestedExpr(const char* leaf) {
+  Text text = {0};
+  for (int i = 0; i < kNestedDepth; ++i) {
+    TextAppend(&text, "(");
+  }
+  TextAppend(&text, "%s", leaf);
+  for (int i = 0; i < kNestedDepth; ++i) {
+    TextAppend(&text, "+%d)*0.5", i % 7 + 1);
+  }
+  return text.data;
+}
+
+static char* PowerExpr(bool with_x) {
+  Text text = {0};
+  for (int i = 0; i < kPowerTerms; ++i) {
+    if (with_x) {
+      TextAppend(&text, "%sx^1.%02d^0.5", i ? "+" : "", i);
+    } else {
+      TextAppend(&text, "%s%d.5^1.%02d^0.5", i ? "+" : "", i % 9 + 1, i);
+    }
+  }
+  return text.data;
+}
+
+// A single right associative chain 1^1^...^1 of about size bytes, with x
+// as its base in the equation.
+static char* PowerChainExpr(size_t size, bool with_x) {
+  Text text = {0};
+  TextAppend(&text, "%s", with_x ? "x" : "1");
+  while (text.size + 2 <= size) {
+    TextAppend(&text, "^1");
+  }
+  return text.data;
+}
+
+// 1+1+...+1, a single chain of sums over the whole text.
+static char* SumChainExpr(size_t terms) {
+  Text text = {0};
+  TextAppend(&text, "1");
+  for (size_t i = 1; i < terms; ++i) {
+    TextAppend(&text, "+1");
+  }
+  return text.data;
+}
+
+static char* LongExpr(bool with_x) {
+  Text text = {0};
+  for (int i = 0; i < kLongTerms; ++i) {
+    const char* arg = with_x ? "x" : "0.75";
+    switch (i % 4) {
+      case 0:
+        TextAppend(&text, "%ssin(%s)*%d", i ? "+" : "", arg, i);
+        break;
+      case 1:
+        TextAppend(&text, "-cos(%d.25)/%s", i, arg);
+        break;
+      case 2:
+        TextAppend(&text, "+ln(%d)^2", i);
+        break;
+      default:
+        TextAppend(&text, "-%s mod %d", arg, i % 13 + 2);
+        break;
+    }
+  }
+  return text.data;
+}
+
+// Only + - * / and negation, what the interpreter dispatch costs most on.
+static char* ArithExpr(bool with_x) {
+  Text text = {0};
+  const char* arg = with_x ? "x" : "0.75";
+  for (int i = 0; i < kArithTerms; ++i) {
+    TextAppend(&text, "%s%d.5*%s*%s-%s/%d+(-%s)*%d.25", i ? "+" : "", i % 9 + 1, arg, arg, arg, i % 5 + 2, arg, i % 7);
+  }
+  return text.data;
+}
+
+static void CheckBasic(Bench* b, const char* what, BasicCalcError error) {
+  if (error != kBasicCalcErrorSuccess) {
+    BenchFail(b, what, (int)error);
+  }
+}
+
+static void BenchCalculateExpr(Bench* b, const void* arg) {
+  const ExprCase* expr = (const ExprCase*)arg;
+  b->bytes = strlen(expr->expr);
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    double res;
+    CheckBasic(b, "BasicCalculateExpr", BasicCalculateExpr(expr->expr, &res));
+    BenchSink(res);
+  }
+}
+
+static void BenchCalculateEquation(Bench* b, const void* arg) {
+  const ExprCase* expr = (const ExprCase*)arg;
+  b->bytes = strlen(expr->equation);
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    double res;
+    CheckBasic(b, "BasicCalculateEquation", BasicCalculateEquation(expr->equation, kEquationX, &res));
+    BenchSink(res);
+  }
+}
+
+typedef struct {
+  const char* expr;
+  double value;
+} PrecedenceCase;
+
+// Operator precedence the parser has to keep. 2^3 mod 3 gave 1 before '^'
+// got its own priority, the exponent took the whole 3 mod 3.
+static const PrecedenceCase kPrecedenceCases[] = {
+  {"2^3 mod 3", 2.0},
+  {"3 mod 2^2", 3.0},
+  {"2^3*2", 16.0},
+  {"2*3^2", 18.0},
+  {"2^3^2", 512.0},
+  {"-2^2", 4.0},
+  {"2^2 mod 3 mod 2", 1.0},
+  {"2+3*4 mod 5", 4.0}
+};
+
+static void BenchCalculatePrecedence(Bench* b, const void* arg) {
+  (void)arg;
+  size_t size = sizeof(kPrecedenceCases) / sizeof(kPrecedenceCases[0]);
+  b->items = size;
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    for (size_t j = 0; j < size && !b->failed; ++j) {
+      double res;
+      CheckBasic(b, kPrecedenceCases[j].expr, BasicCalculateExpr(kPrecedenceCases[j].expr, &res));
+      if (!b->failed && res != kPrecedenceCases[j].value) {
+        BenchFail(b, kPrecedenceCases[j].expr, 0);
+      }
+      BenchSink(res);
+    }
+  }
+}
+
+static void BenchCalculateCached(Bench* b, const void* arg) {
+  const ExprCase* expr = (const ExprCase*)arg;
+  BenchStopTimer(b);
+  BasicCacheConfigure(true, 64);
+  double res;
+  BasicCalculateEquation(expr->equation, kEquationX, &res);
+  BenchStartTimer(b);
+  BenchCalculateEquation(b, arg);
+  BenchStopTimer(b);
+  BasicCacheConfigure(false, 0);
+}
+
+static void BenchCompileExpr(Bench* b, const void* arg) {
+  const ExprCase* expr = (const ExprCase*)arg;
+  b->bytes = strlen(expr->equation);
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    BasicProgram* program = NULL;
+    CheckBasic(b, "BasicCompileExpr", BasicCompileExpr(expr->equation, &program));
+    BasicProgramFree(program);
+  }
+}
+
+// Types a digit in the middle of the text and takes it back, as a
+// live preview does on every keystroke.
+static void BenchEditorReplace(Bench* b, const void* arg) {
+  const ExprCase* expr = (const ExprCase*)arg;
+  BenchStopTimer(b);
+  size_t size = strlen(expr->expr);
+  size_t pos = size / 2;
+  while (pos < size && (expr->expr[pos] < '1' || expr->expr[pos] > '9')) {
+    ++pos;
+  }
+  BasicEditor* editor;
+  double res;
+  CheckBasic(b, "BasicEditorNew", BasicEditorNew(&editor));
+  if (b->failed) {
+    return;
+  }
+  CheckBasic(b, "BasicEditorReplace", BasicEditorReplace(editor, 0, 0, expr->expr, size, &res));
+  b->bytes = size;
+  BenchStartTimer(b);
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    CheckBasic(b, "BasicEditorReplace", BasicEditorReplace(editor, pos, 1, "7", 1, &res));
+    CheckBasic(b, "BasicEditorReplace", BasicEditorReplace(editor, pos, 1, expr->expr + pos, 1, &res));
+    BenchSink(res);
+  }
+  BenchStopTimer(b);
+  BasicEditorFree(editor);
+}
+
+typedef struct {
+  const char* name;
+  const char* text;
+  size_t pos;
+  size_t removed;
+  const char* typed;
+  // Makes random edits instead, see RandomEdits.
+  bool random;
+} EditCase;
+
+enum { kRandomEdits = 64, kRandomPending = 8 };
+
+// Pieces a random edit types, most of them leave the text in error.
+static const char* const kRandomPieces[] = {"1", "3", "0.5", "+", "-", "*", "/", "^", " mod ", "(", ")",
+                                            "1e", "e1*", "+7*(", "sin(", "2)", " ", "-3"};
+
+typedef struct {
+  size_t pos;
+  size_t size;
+} TypedPiece;
+
+static uint64_t NextRandom(uint64_t* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+// Types random pieces into the text the editor holds, half of them near
+// its start, and takes typed pieces back out in any order, so that edits
+// are made while the text is in error and then fix it. Every result has
+// to be what BasicCalculateExpr gives for the whole text. The text is put
+// back at the end.
+static void RandomEdits(Bench* b, BasicEditor* editor, const char* start, uint64_t* state, double* res) {
+  Text text = {0};
+  TextAppend(&text, "%s", start);
+  TypedPiece pending[kRandomPending];
+  size_t pending_size = 0;
+  for (size_t i = 0; i < kRandomEdits && !b->failed; ++i) {
+    uint64_t r = NextRandom(state);
+    size_t pos;
+    size_t removed = 0;
+    const char* typed = "";
+    if (r % 3 == 0 && pending_size) {
+      size_t j = (size_t)(r >> 8) % pending_size;
+      pos = pending[j].pos;
+      removed = pending[j].size;
+      pending[j] = pending[--pending_size];
+    } else {
+      size_t reach = r >> 2 & 1 || text.size < 32 ? text.size : 32;
+      pos = (size_t)(r >> 8) % (reach + 1);
+      typed = kRandomPieces[(r >> 40) % (sizeof(kRandomPieces) / sizeof(kRandomPieces[0]))];
+    }
+    size_t size = strlen(typed);
+    // Pieces behind the edit move with it, one it lands in stays typed.
+    for (size_t j = 0; j < pending_size; ++j) {
+      if (pending[j].pos >= pos + removed) {
+        pending[j].pos = pending[j].pos + size - removed;
+      } else if (pending[j].pos + pending[j].size > pos) {
+        pending[j--] = pending[--pending_size];
+      }
+    }
+    if (size && pending_size < kRandomPending) {
+      pending[pending_size++] = (TypedPiece){pos, size};
+    }
+    TextReplace(&text, pos, removed, typed);
+    BasicCalcError error = BasicEditorReplace(editor, pos, removed, typed, size, res);
+    BenchStopTimer(b);
+    double want;
+    BasicCalcError want_error = BasicCalculateExpr(text.data, &want);
+    if (error != want_error ||
+        (error == kBasicCalcErrorSuccess && *res != want && !(*res != *res && want != want))) {
+      BenchFail(b, "BasicEditorReplace matching BasicCalculateExpr", (int)error);
+    }
+    BenchStartTimer(b);
+  }
+  CheckBasic(b, "BasicEditorReplace", BasicEditorReplace(editor, 0, text.size, start, strlen(start), res));
+  free(text.data);
+}
+
+// Types typed over the removed bytes a character at a time and puts them
+// back. What the text evaluates to in between is not checked, it may be
+// an error, the text put back has to give what BasicCalculateExpr does.
+// A random case makes RandomEdits instead of typing.
+static void BenchEditorType(Bench* b, const void* arg) {
+  const EditCase* edit = (const EditCase*)arg;
+  BenchStopTimer(b);
+  size_t typed = edit->random ? 0 : strlen(edit->typed);
+  double want;
+  CheckBasic(b, "BasicCalculateExpr", BasicCalculateExpr(edit->text, &want));
+  BasicEditor* editor;
+  CheckBasic(b, "BasicEditorNew", BasicEditorNew(&editor));
+  if (b->failed) {
+    return;
+  }
+  double res;
+  CheckBasic(b, "BasicEditorReplace", BasicEditorReplace(editor, 0, 0, edit->text, strlen(edit->text), &res));
+  b->items = edit->random ? kRandomEdits + 1 : typed + 1;
+  uint64_t state = 0x9E3779B97F4A7C15u;
+  BenchStartTimer(b);
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    if (edit->random) {
+      RandomEdits(b, editor, edit->text, &state, &res);
+    }
+    for (size_t j = 0; j < typed && !b->failed; ++j) {
+      BasicCalcError error = BasicEditorReplace(editor, edit->pos + j, j ? 0 : edit->removed, edit->typed + j, 1, &res);
+      if (error == kBasicCalcAllocationFail) {
+        BenchFail(b, "BasicEditorReplace", (int)error);
+      }
+    }
+    if (!edit->random) {
+      CheckBasic(b, "BasicEditorReplace", BasicEditorReplace(editor, edit->pos, typed, edit->text + edit->pos, edit->removed, &res));
+    }
+    if (!b->failed && res != want) {
+      BenchFail(b, "BasicEditorReplace matching BasicCalculateExpr", 0);
+    }
+    BenchSink(res);
+  }
+  BenchStopTimer(b);
+  BasicEditorFree(editor);
+}
+
+static void BenchProgramOptimize(Bench* b, const void* arg) {
+  const ExprCase* expr = (const ExprCase*)arg;
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    BenchStopTimer(b);
+    BasicProgram* program = NULL;
+    CheckBasic(b, "BasicCompileExpr", BasicCompileExpr(expr->equation, &program));
+    BenchStartTimer(b);
+    if (program) {
+      CheckBasic(b, "BasicProgramOptimize", BasicProgramOptimize(program, NULL));
+    }
+    BasicProgramFree(program);
+  }
+}
+
+static void ProgramEval(Bench* b, const ExprCase* expr, size_t jit_threshold) {
+  BenchStopTimer(b);
+  BasicSetJitThreshold(jit_threshold);
+  BasicProgram* program = NULL;
+  CheckBasic(b, "BasicCompileExpr", BasicCompileExpr(expr->equation, &program));
+  BenchStartTimer(b);
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    double res;
+    CheckBasic(b, "BasicProgramEval", BasicProgramEval(program, kEquationXValue + (double)(i & 7), &res));
+    BenchSink(res);
+  }
+  BenchStopTimer(b);
+  BasicProgramFree(program);
+}
+
+static void BenchProgramEvalInterp(Bench* b, const void* arg) {
+  ProgramEval(b, (const ExprCase*)arg, 0);
+}
+
+static void BenchProgramEvalJit(Bench* b, const void* arg) {
+  ProgramEval(b, (const ExprCase*)arg, 1);
+}
+
+static void BenchProgramEvalVars(Bench* b, const void* arg) {
+  (void)arg;
+  static const char* const kNames[] = {"a", "b", "c", "x"};
+  BenchStopTimer(b);
+  BasicProgram* program = NULL;
+  CheckBasic(b, "BasicCompileVars", BasicCompileVars("a*x^2+b*x+c-sqrt(a*a+b*b)", kNames, 4, &program));
+  BenchStartTimer(b);
+  double values[] = {1.5, -2.0, 0.25, 0.0};
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    double res;
+    values[3] = (double)(i & 15);
+    CheckBasic(b, "BasicProgramEvalVars", BasicProgramEvalVars(program, values, &res));
+    BenchSink(res);
+  }
+  BenchStopTimer(b);
+  BasicProgramFree(program);
+}
+
+static void BenchEvaluateRange(Bench* b, const void* arg) {
+  const ExprCase* expr = (const ExprCase*)arg;
+  BenchStopTimer(b);
+  double* x = (double*)malloc(2 * kRangePoints * sizeof(double));
+  double* res = x + kRangePoints;
+  for (size_t i = 0; i < kRangePoints; ++i) {
+    x[i] = -10.0 + 20.0 * (double)i / kRangePoints;
+  }
+  b->items = kRangePoints;
+  BenchStartTimer(b);
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    CheckBasic(b, "BasicEvaluateRange", BasicEvaluateRange(expr->equation, x, kRangePoints, res, NULL));
+    BenchSink(res[i % kRangePoints]);
+  }
+  BenchStopTimer(b);
+  free(x);
+}
+
+static void BenchEvaluateLinspace(Bench* b, const void* arg) {
+  const ExprCase* expr = (const ExprCase*)arg;
+  BenchStopTimer(b);
+  double* res = (double*)malloc(kRangePoints * sizeof(double));
+  b->items = kRangePoints;
+  BenchStartTimer(b);
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    CheckBasic(b, "BasicEvaluateLinspace",
+               BasicEvaluateLinspace(expr->equation, -10.0, 20.0 / kRangePoints, kRangePoints, res, NULL));
+    BenchSink(res[i % kRangePoints]);
+  }
+  BenchStopTimer(b);
+  free(res);
+}
+
+static void BenchSolveEquation(Bench* b, const void* arg) {
+  (void)arg;
+  double roots[64];
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    size_t count;
+    CheckBasic(b, "BasicSolveEquation", BasicSolveEquation("sin(x)*x-0.5", -50, 50, 1e-12, roots, 64, &count));
+    BenchSink((double)count);
+  }
+}
+
+static void BenchSampleCurve(Bench* b, const void* arg) {
+  (void)arg;
+  BenchStopTimer(b);
+  BasicPoint* points = (BasicPoint*)malloc(kCurveMaxPoints * sizeof(BasicPoint));
+  BenchStartTimer(b);
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    size_t count;
+    CheckBasic(b, "BasicSampleCurve",
+               BasicSampleCurve("tan(x)+sqrt(x)", -10, 10, -5, 5, kCurvePixels, points, kCurveMaxPoints, &count));
+    BenchSink((double)count);
+  }
+  BenchStopTimer(b);
+  free(points);
+}
+
+typedef struct {
+  const char* const* exprs;
+  const double* x;
+  size_t threads;
+} BatchCase;
+
+static void BenchCalculateBatch(Bench* b, const void* arg) {
+  const BatchCase* batch = (const BatchCase*)arg;
+  BenchStopTimer(b);
+  BasicSetBatchThreads(batch->threads);
+  double* res = (double*)malloc(kBatchSize * (sizeof(double) + sizeof(BasicCalcError)));
+  BasicCalcError* errors = (BasicCalcError*)(res + kBatchSize);
+  // Starts the pool outside the timed part.
+  BasicCalculateBatch(batch->exprs, batch->x, kBatchSize, res, errors);
+  b->items = kBatchSize;
+  BenchStartTimer(b);
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    CheckBasic(b, "BasicCalculateBatch", BasicCalculateBatch(batch->exprs, batch->x, kBatchSize, res, errors));
+    BenchSink(res[i % kBatchSize]);
+  }
+  BenchStopTimer(b);
+  free(res);
+}
+
+static void BenchCreditCalculate(Bench* b, const void* arg) {
+  const CreditConditions* conds = (const CreditConditions*)arg;
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    CreditData data = {0};
+    CreditCalcError error = CreditCalculate(conds, &data);
+    if (error != kCreditCalcErrorSuccess) {
+      BenchFail(b, "CreditCalculate", (int)error);
+    }
+    BenchSink(data.total);
+    CreditDestroyData(&data);
+  }
+}
+
+static void BenchDepositCalculate(Bench* b, const void* arg) {
+  const DepositConditions* conds = (const DepositConditions*)arg;
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    DepositData data;
+    DepositCalcError error = DepositCalculate(conds, &data);
+    if (error != kDepositCalcErrorSuccess) {
+      BenchFail(b, "DepositCalculate", (int)error);
+      continue;
+    }
+    BenchSink(data.total);
+    DepositDestroyData(&data);
+  }
+}
+
+typedef struct {
+  size_t rows;
+  double sum;
+} RowCount;
+
+static void CountRow(void* ctx, const DepositRow* row) {
+  RowCount* count = (RowCount*)ctx;
+  ++count->rows;
+  count->sum += row->sum;
+}
+
+// The first op also checks the totals and the number of rows against
+// DepositCalculate.
+static void BenchDepositStream(Bench* b, const void* arg) {
+  const DepositConditions* conds = (const DepositConditions*)arg;
+  BenchStopTimer(b);
+  DepositData expected, data;
+  RowCount count = {0};
+  if (DepositCalculate(conds, &expected) != kDepositCalcErrorSuccess ||
+      DepositCalculateStream(conds, CountRow, &count, &data) != kDepositCalcErrorSuccess) {
+    BenchFail(b, "DepositCalculateStream", 0);
+    return;
+  }
+  size_t rows = VectorSize(expected.payments) + VectorSize(expected.taxes) + VectorSize(expected.replen);
+  if (count.rows != rows || memcmp(&data.eff_rate, &expected.eff_rate, 4 * sizeof(double)) != 0) {
+    BenchFail(b, "DepositCalculateStream matching DepositCalculate", 0);
+  }
+  DepositDestroyData(&expected);
+  BenchStartTimer(b);
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    count = (RowCount){0};
+    if (DepositCalculateStream(conds, CountRow, &count, &data) != kDepositCalcErrorSuccess) {
+      BenchFail(b, "DepositCalculateStream", 0);
+    }
+    BenchSink(count.sum + data.total);
+  }
+  BenchStopTimer(b);
+}
+
+typedef struct {
+  const DepositConditions* conds;
+  // What a serial run gave for every case.
+  const DepositData* expected;
+  size_t threads;
+} DepositStressCase;
+
+typedef struct {
+  const DepositStressCase* stress;
+  atomic_size_t next;
+  atomic_bool failed;
+} DepositStressRun;
+
+static bool SameArray(const void* lhs, const void* rhs, size_t elem_size) {
+  return VectorSize((void*)lhs) == VectorSize((void*)rhs) &&
+         memcmp(lhs, rhs, VectorSize((void*)lhs) * elem_size) == 0;
+}
+
+// Payouts have padding after the date, so they are compared field by field.
+static bool SamePayouts(const DepositPayout* lhs, const DepositPayout* rhs) {
+  if (VectorSize((void*)lhs) != VectorSize((void*)rhs)) {
+    return false;
+  }
+  for (size_t i = 0; i < VectorSize((void*)lhs); ++i) {
+    if (!DateEqual(&lhs[i].date, &rhs[i].date) || memcmp(&lhs[i].sum, &rhs[i].sum, sizeof(double)) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool SameDeposit(const DepositData* lhs, const DepositData* rhs) {
+  return memcmp(&lhs->eff_rate, &rhs->eff_rate, 4 * sizeof(double)) == 0 &&
+         DateEqual(&lhs->start_date, &rhs->start_date) && DateEqual(&lhs->finish_date, &rhs->finish_date) &&
+         SamePayouts(lhs->replen, rhs->replen) &&
+         SameArray(lhs->pay_dates, rhs->pay_dates, sizeof(Date)) &&
+         SameArray(lhs->payments, rhs->payments, sizeof(double)) &&
+         SameArray(lhs->taxes, rhs->taxes, sizeof(double));
+}
+
+static void* DepositStressWorker(void* arg) {
+  DepositStressRun* run = (DepositStressRun*)arg;
+  for (;;) {
+    size_t i = atomic_fetch_add_explicit(&run->next, 1, memory_order_relaxed);
+    if (i >= kDepositStressCases) {
+      break;
+    }
+    DepositData data;
+    if (DepositCalculate(run->stress->conds + i, &data) != kDepositCalcErrorSuccess) {
+      atomic_store(&run->failed, true);
+      continue;
+    }
+    if (!SameDeposit(&data, run->stress->expected + i)) {
+      atomic_store(&run->failed, true);
+    }
+    DepositDestroyData(&data);
+  }
+  return NULL;
+}
+
+// Every op computes all the cases on threads threads, each result has to
+// match the serial one bit for bit.
+static void BenchDepositConcurrent(Bench* b, const void* arg) {
+  const DepositStressCase* stress = (const DepositStressCase*)arg;
+  Thread* threads = (Thread*)malloc(stress->threads * sizeof(Thread));
+  b->items = kDepositStressCases;
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    DepositStressRun run = {.stress = stress};
+    size_t started = 0;
+    while (started + 1 < stress->threads && ThreadCreate(threads + started, DepositStressWorker, &run)) {
+      ++started;
+    }
+    DepositStressWorker(&run);
+    for (size_t j = 0; j < started; ++j) {
+      ThreadJoin(threads[j]);
+    }
+    if (atomic_load(&run.failed)) {
+      BenchFail(b, "DepositCalculate matching the serial run", 0);
+    }
+  }
+  free(threads);
+}
+
+static void CheckDeposit(Bench* b, const char* what, DepositCalcError error) {
+  if (error != kDepositCalcErrorSuccess) {
+    BenchFail(b, what, (int)error);
+  }
+}
+
+typedef struct {
+  const DepositStressCase* stress;
+  // Flows of a single threaded batch, NULL to leave them out.
+  const DepositBatch* reference;
+} DepositBatchCase;
+
+static bool SameBatch(const DepositBatch* batch, const DepositBatchCase* batch_case) {
+  for (size_t i = 0; i < batch->size; ++i) {
+    if (!SameDeposit(batch->data + i, batch_case->stress->expected + i)) {
+      return false;
+    }
+  }
+  const DepositBatch* reference = batch_case->reference;
+  return !reference || (batch->flows_size == reference->flows_size &&
+                        memcmp(batch->flows, reference->flows, batch->flows_size * sizeof(DepositFlow)) == 0);
+}
+
+// The first op also checks every result against the serial run and the
+// flows against the single threaded batch.
+static void BenchDepositBatch(Bench* b, const void* arg) {
+  const DepositBatchCase* batch_case = (const DepositBatchCase*)arg;
+  bool flows = batch_case->reference != NULL;
+  BenchStopTimer(b);
+  BasicSetBatchThreads(batch_case->stress->threads);
+  DepositBatch batch;
+  CheckDeposit(b, "DepositCalculateBatch",
+               DepositCalculateBatch(batch_case->stress->conds, kDepositStressCases, flows, &batch));
+  if (!b->failed && !SameBatch(&batch, batch_case)) {
+    BenchFail(b, "DepositCalculateBatch matching the serial run", 0);
+  }
+  DepositDestroyBatch(&batch);
+  b->items = kDepositStressCases;
+  BenchStartTimer(b);
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    CheckDeposit(b, "DepositCalculateBatch",
+                 DepositCalculateBatch(batch_case->stress->conds, kDepositStressCases, flows, &batch));
+    BenchSink(batch.total);
+    DepositDestroyBatch(&batch);
+  }
+  BenchStopTimer(b);
+}
+
+typedef struct {
+  const DepositConditions* base;
+  const DepositSweep* sweep;
+  // What DepositCalculate gives for every point.
+  const DepositSweepResult* expected;
+  size_t threads;
+} DepositSweepCase;
+
+static DepositConditions SweepConditions(const DepositSweepCase* sweep_case, size_t point) {
+  DepositConditions conds = *sweep_case->base;
+  conds.intr_rate = sweep_case->sweep->intr_rates[point / (kSweepTerms * kSweepFreqs)];
+  conds.term = sweep_case->sweep->terms[point / kSweepFreqs % kSweepTerms];
+  conds.pay_freq = sweep_case->sweep->pay_freqs[point % kSweepFreqs];
+  return conds;
+}
+
+// The grid one DepositCalculate at a time, as it was done before the
+// sweep.
+static void BenchDepositGrid(Bench* b, const void* arg) {
+  const DepositSweepCase* sweep_case = (const DepositSweepCase*)arg;
+  b->items = kSweepPoints;
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    for (size_t p = 0; p < kSweepPoints; ++p) {
+      DepositConditions conds = SweepConditions(sweep_case, p);
+      DepositData data;
+      CheckDeposit(b, "DepositCalculate", DepositCalculate(&conds, &data));
+      if (b->failed) {
+        break;
+      }
+      BenchSink(data.total);
+      DepositDestroyData(&data);
+    }
+  }
+}
+
+// The first op also checks every point against DepositCalculate.
+static void BenchDepositSweep(Bench* b, const void* arg) {
+  const DepositSweepCase* sweep_case = (const DepositSweepCase*)arg;
+  DepositSweepResult res[kSweepPoints];
+  BenchStopTimer(b);
+  BasicSetBatchThreads(sweep_case->threads);
+  CheckDeposit(b, "DepositCalculateSweep", DepositCalculateSweep(sweep_case->base, sweep_case->sweep, res, NULL));
+  if (!b->failed && memcmp(res, sweep_case->expected, sizeof(res)) != 0) {
+    BenchFail(b, "DepositCalculateSweep matching DepositCalculate", 0);
+  }
+  b->items = kSweepPoints;
+  BenchStartTimer(b);
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    CheckDeposit(b, "DepositCalculateSweep", DepositCalculateSweep(sweep_case->base, sweep_case->sweep, res, NULL));
+    BenchSink(res[kSweepPoints - 1].total);
+  }
+  BenchStopTimer(b);
+}
+
+static DepositTransaction* Transactions(const DepositTransaction* list, size_t size) {
+  DepositTransaction* transactions = VectorNew(DepositTransaction);
+  for (size_t i = 0; transactions && i < size; ++i) {
+    if (!VectorPush(transactions, list[i])) {
+      transactions = NULL;
+    }
+  }
+  if (!transactions) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  return transactions;
+}
+
+typedef struct {
+  const char* name;
+  DepositTermType term_type;
+  unsigned short term;
+  int capt;
+  DepositPayFreq pay_freq;
+  double tax_rate;
+  double key_rate;
+  double sum;
+  double intr_rate;
+  double non_taking_rem;
+  int start_date[3];
+  // Taken every month from its date on, none with a zero sum.
+  int wth_date[3];
+  double wth_sum;
+  // Results of the day by day loop, as hex floats so every bit counts.
+  double perc_sum;
+  double tax_sum;
+  double total;
+  size_t payments;
+  double first_payment;
+  double last_payment;
+} DepositGoldenCase;
+
+// Accruing from event to event has to give the results of the day by day
+// loop bit for bit. The ties cases put 366% on 2^44 (1 + 2^-45) over
+// the leap year 2024: a day accrues the sum itself, which is half an ulp
+// off the grid once the interest passes 2^52, so every day from there on
+// rounds to even, and a step taken wrong shows in the payment.
+static const DepositGoldenCase kDepositGoldenCases[] = {
+  {
+    .name = "daily-capitalization-50y",
+    .term_type = kDepositTermTypeYear, .term = 50, .capt = 1, .pay_freq = kDepositPayFreqEvDay,
+    .tax_rate = 13.0, .key_rate = 16.0, .sum = 1000000.0, .intr_rate = 15.0, .non_taking_rem = 0.0,
+    .start_date = {2024, 1, 15},
+    .perc_sum = 0x1.ae2d33f23332bp+30, .tax_sum = 0x1.bd5c9479eb853p+27, .total = 0x1.ae6a3cf23332bp+30,
+    .payments = 18263, .first_payment = 0x1.99d70a3d70a3ep+8, .last_payment = 0x1.6a1b78f5c28f6p+19
+  },
+  {
+    .name = "binade-ties",
+    .term_type = kDepositTermTypeYear, .term = 1, .capt = 0, .pay_freq = kDepositPayFreqEvYear,
+    .tax_rate = 13.0, .key_rate = 16.0, .sum = 0x1.000000000008p+44, .intr_rate = 366.0, .non_taking_rem = 0.0,
+    .start_date = {2023, 12, 31},
+    .perc_sum = 0x1.d47ae147ae1ecp+45, .tax_sum = 0x1.e7381d696f533p+42, .total = 0x1.2a3d70a3d7116p+46,
+    .payments = 1, .first_payment = 0x1.d47ae147ae1ecp+45, .last_payment = 0x1.d47ae147ae1ecp+45
+  },
+  {
+    .name = "binade-ties-capitalization",
+    .term_type = kDepositTermTypeYear, .term = 3, .capt = 1, .pay_freq = kDepositPayFreqEvYear,
+    .tax_rate = 13.0, .key_rate = 16.0, .sum = 0x1.000000000008p+44, .intr_rate = 366.0, .non_taking_rem = 0.0,
+    .start_date = {2023, 12, 31},
+    .perc_sum = 0x1.90c75e6362abap+50, .tax_sum = 0x1.a0cf57ea9398ep+47, .total = 0x1.94c75e6362abcp+50,
+    .payments = 3, .first_payment = 0x1.d47ae147ae1ecp+45, .last_payment = 0x1.3dea98244e97cp+50
+  },
+  {
+    .name = "negative-balance",
+    .term_type = kDepositTermTypeMonth, .term = 24, .capt = 0, .pay_freq = kDepositPayFreqEvMon,
+    .tax_rate = 13.0, .key_rate = 16.0, .sum = 10000.0, .intr_rate = 10.0, .non_taking_rem = -100000.0,
+    .start_date = {2024, 1, 15},
+    .wth_date = {2024, 2, 15}, .wth_sum = 3000.0,
+    .perc_sum = -0x1.3302b851eb852p+12, .tax_sum = 0.0, .total = -0x1.05602b851eb85p+16,
+    .payments = 24, .first_payment = 0x1.52ccccccccccdp+6, .last_payment = -0x1.f51999999999ap+8
+  },
+  {
+    .name = "month-end",
+    .term_type = kDepositTermTypeMonth, .term = 48, .capt = 1, .pay_freq = kDepositPayFreqEvMon,
+    .tax_rate = 13.0, .key_rate = 16.0, .sum = 100000.0, .intr_rate = 12.0, .non_taking_rem = 0.0,
+    .start_date = {2024, 1, 31},
+    .perc_sum = 0x1.de4c9eb851ebap+15, .tax_sum = 0.0, .total = 0x1.3ae327ae147aep+17,
+    .payments = 48, .first_payment = 0x1.fc31eb851eb85p+9, .last_payment = 0x1.7bap+10
+  },
+  {
+    .name = "feb-29",
+    .term_type = kDepositTermTypeYear, .term = 8, .capt = 1, .pay_freq = kDepositPayFreqEvYear,
+    .tax_rate = 13.0, .key_rate = 16.0, .sum = 100000.0, .intr_rate = 12.0, .non_taking_rem = 0.0,
+    .start_date = {2024, 2, 29},
+    .perc_sum = 0x1.204627ae147aep+17, .tax_sum = 0.0, .total = 0x1.e39627ae147aep+17,
+    .payments = 8, .first_payment = 0x1.772b1eb851eb8p+13, .last_payment = 0x1.9e5628f5c28f6p+14
+  }
+};
+
+static void BenchDepositGolden(Bench* b, const void* arg) {
+  (void)arg;
+  size_t size = sizeof(kDepositGoldenCases) / sizeof(kDepositGoldenCases[0]);
+  BenchStopTimer(b);
+  DepositConditions conds[sizeof(kDepositGoldenCases) / sizeof(kDepositGoldenCases[0])];
+  for (size_t j = 0; j < size; ++j) {
+    const DepositGoldenCase* golden = kDepositGoldenCases + j;
+    const DepositTransaction wth = {
+      .payout = {.date = DateNewFromArray(golden->wth_date), .sum = golden->wth_sum},
+      .freq = kDepositTransactionFreqEvMon
+    };
+    conds[j] = (DepositConditions){
+      .term_type = golden->term_type,
+      .term = golden->term,
+      .capt = golden->capt,
+      .pay_freq = golden->pay_freq,
+      .tax_rate = golden->tax_rate,
+      .key_rate = golden->key_rate,
+      .sum = golden->sum,
+      .intr_rate = golden->intr_rate,
+      .non_taking_rem = golden->non_taking_rem,
+      .start_date = DateNewFromArray(golden->start_date),
+      .fund = Transactions(NULL, 0),
+      .wth = Transactions(&wth, golden->wth_sum != 0.0)
+    };
+  }
+  b->items = size;
+  BenchStartTimer(b);
+  for (size_t i = 0; i < b->n && !b->failed; ++i) {
+    for (size_t j = 0; j < size && !b->failed; ++j) {
+      const DepositGoldenCase* golden = kDepositGoldenCases + j;
+      DepositData data;
+      CheckDeposit(b, golden->name, DepositCalculate(conds + j, &data));
+      if (b->failed) {
+        break;
+      }
+      size_t payments = VectorSize(data.payments);
+      if (data.perc_sum != golden->perc_sum || data.tax_sum != golden->tax_sum || data.total != golden->total ||
+          payments != golden->payments || data.payments[0] != golden->first_payment ||
+          data.payments[payments - 1] != golden->last_payment) {
+        BenchFail(b, golden->name, 0);
+      }
+      BenchSink(data.total);
+      DepositDestroyData(&data);
+    }
+  }
+  BenchStopTimer(b);
+  for (size_t j = 0; j < size; ++j) {
+    VectorDelete(conds[j].fund);
+    VectorDelete(conds[j].wth);
+  }
+}
+
+// Machine written text: one term per indented line and full precision
+// numbers, so the time goes to blanks and digits more than to operators.
+static char* FormattedExpr(bool with_x) {
+  Text text = {0};
+  double value = 0.1;
+  for (int i = 0; i < kFormattedLines; ++i) {
+    value = value * 1.7 + 0.3;
+    if (value > 100.0) {
+      value /= 97.0;
+    }
+    TextAppend(&text, "%s        %.17g * (%s + %.17g)\n",
+               i ? "+" : "", value, with_x ? "x" : "0.75", 1.0 / (i + 3));
+  }
+  return text.data;
+}
+
+static void RunBasic(void) {
+  ExprCase cases[] = {
+    {.name = "short", .expr = TextCopy("2+3*4-5/6"), .equation = TextCopy("x^2+3*x-5/x")},
+    {.name = "nested", .expr = NestedExpr("1.5"), .equation = NestedExpr("x")},
+    {.name = "power", .expr = PowerExpr(false), .equation = PowerExpr(true)},
+    {.name = "long", .expr = LongExpr(false), .equation = LongExpr(true)},
+    {.name = "formatted", .expr = FormattedExpr(false), .equation = FormattedExpr(true)},
+    {.name = "arith", .expr = ArithExpr(false), .equation = ArithExpr(true)}
+  };
+  // The batch mixes the short shapes only.
+  size_t batch_cases = 3;
+  size_t size = sizeof(cases) / sizeof(cases[0]);
+  static const struct {
+    const char* group;
+    BenchFn fn;
+  } kGroups[] = {
+    {"CalculateExpr", BenchCalculateExpr},
+    {"CalculateEquation", BenchCalculateEquation},
+    {"CalculateEquationCached", BenchCalculateCached},
+    {"CompileExpr", BenchCompileExpr},
+    {"EditorReplace", BenchEditorReplace},
+    {"ProgramOptimize", BenchProgramOptimize},
+    {"ProgramEvalInterp", BenchProgramEvalInterp},
+    {"ProgramEvalJit", BenchProgramEvalJit},
+    {"EvaluateRange", BenchEvaluateRange},
+    {"EvaluateLinspace", BenchEvaluateLinspace}
+  };
+  char name[128];
+  for (size_t g = 0; g < sizeof(kGroups) / sizeof(kGroups[0]); ++g) {
+    for (size_t i = 0; i < size; ++i) {
+      snprintf(name, sizeof(name), "%s/%s", kGroups[g].group, cases[i].name);
+      BenchRun(name, kGroups[g].fn, cases + i);
+    }
+  }
+  // Back to the default of the library.
+  BasicSetJitThreshold(1000);
+  ExprCase chains[] = {
+    {.name = "power-chain-10KB",
+     .expr = PowerChainExpr(kPowerChainSmall, false),
+     .equation = PowerChainExpr(kPowerChainSmall, true)},
+    {.name = "power-chain-100KB",
+     .expr = PowerChainExpr(kPowerChainLarge, false),
+     .equation = PowerChainExpr(kPowerChainLarge, true)}
+  };
+  for (size_t i = 0; i < sizeof(chains) / sizeof(chains[0]); ++i) {
+    snprintf(name, sizeof(name), "CalculateExpr/%s", chains[i].name);
+    BenchRun(name, BenchCalculateExpr, chains + i);
+    snprintf(name, sizeof(name), "CalculateEquation/%s", chains[i].name);
+    BenchRun(name, BenchCalculateEquation, chains + i);
+    snprintf(name, sizeof(name), "CompileExpr/%s", chains[i].name);
+    BenchRun(name, BenchCompileExpr, chains + i);
+    free(chains[i].expr);
+    free(chains[i].equation);
+  }
+  // Edits near the start and through an error, on short and long texts.
+  // An edit near the start of a sum recomputes every partial sum after it.
+  const size_t sum_terms[] = {kSumShortTerms, kSumLongTerms};
+  for (size_t i = 0; i < sizeof(sum_terms) / sizeof(sum_terms[0]); ++i) {
+    char* sum = SumChainExpr(sum_terms[i]);
+    size_t size = strlen(sum);
+    // Right behind a 1 in the middle.
+    size_t middle = size / 2 | 1;
+    const EditCase edits[] = {
+      {.name = "digit-at-start", .text = sum, .pos = 0, .removed = 1, .typed = "7"},
+      {.name = "brace-at-start", .text = sum, .pos = 0, .removed = 1, .typed = "("},
+      {.name = "error-in-middle", .text = sum, .pos = middle, .removed = 0, .typed = "*sin(2)"},
+      {.name = "random", .text = sum, .random = true}
+    };
+    for (size_t j = 0; j < sizeof(edits) / sizeof(edits[0]); ++j) {
+      snprintf(name, sizeof(name), "EditorType/%s/%zuB", edits[j].name, size);
+      BenchRun(name, BenchEditorType, edits + j);
+    }
+    free(sum);
+  }
+  BenchRun("CalculatePrecedence", BenchCalculatePrecedence, NULL);
+  BenchRun("ProgramEvalVars", BenchProgramEvalVars, NULL);
+  BenchRun("SolveEquation", BenchSolveEquation, NULL);
+  BenchRun("SampleCurve", BenchSampleCurve, NULL);
+
+  // Half of the expressions with x.
+  const char** exprs = (const char**)malloc(kBatchSize * sizeof(const char*));
+  double* x = (double*)malloc(kBatchSize * sizeof(double));
+  for (size_t i = 0; i < kBatchSize; ++i) {
+    const ExprCase* expr = cases + i % batch_cases;
+    exprs[i] = i & 1 ? expr->equation : expr->expr;
+    x[i] = kEquationXValue + (double)(i % 10);
+  }
+  size_t cpus = ThreadHardwareConcurrency();
+  for (size_t threads = 1;; threads *= 2) {
+    if (threads > cpus) {
+      threads = cpus;
+    }
+    BatchCase batch = {.exprs = exprs, .x = x, .threads = threads};
+    snprintf(name, sizeof(name), "CalculateBatch/threads=%zu", threads);
+    BenchRun(name, BenchCalculateBatch, &batch);
+    if (threads == cpus) {
+      break;
+    }
+  }
+  // Stops the pool threads.
+  BasicSetBatchThreads(1);
+  free(x);
+  free((void*)exprs);
+  for (size_t i = 0; i < size; ++i) {
+    free(cases[i].expr);
+    free(cases[i].equation);
+  }
+}
+
+static void RunCredit(void) {
+  CreditConditions conds = {
+    .sum = 1000000.0,
+    .int_rate = 12.5,
+    .term = kDateLimitsMonthMax,
+    .term_type = kCreditTermTypeMonth,
+    .credit_type = kCreditTypeAnnuit
+  };
+  BenchRun("CreditCalculate/annuity", BenchCreditCalculate, &conds);
+  conds.credit_type = kCreditTypeDiff;
+  BenchRun("CreditCalculate/diff", BenchCreditCalculate, &conds);
+}
+
+static void RunDeposit(void) {
+  Date start = DateNew(2024, 1, 15);
+  const DepositTransaction funds[] = {
+    {.payout = {.date = DateNew(2024, 2, 1), .sum = 5000.0}, .freq = kDepositTransactionFreqEvMon},
+    {.payout = {.date = DateNew(2024, 3, 10), .sum = 20000.0}, .freq = kDepositTransactionFreqQuart},
+    {.payout = {.date = DateNew(2024, 12, 25), .sum = 100000.0}, .freq = kDepositTransactionFreqEvYear},
+    {.payout = {.date = DateNew(2030, 6, 1), .sum = 250000.0}, .freq = kDepositTransactionFreqOnce}
+  };
+  const DepositTransaction withdrawals[] = {
+    {.payout = {.date = DateNew(2024, 4, 20), .sum = 3000.0}, .freq = kDepositTransactionFreqEv2Mon},
+    {.payout = {.date = DateNew(2025, 7, 1), .sum = 50000.0}, .freq = kDepositTransactionFreqEvHalfYear}
+  };
+  DepositConditions conds = {
+    .term_type = kDepositTermTypeYear,
+    .term = kDateLimitsYearMax,
+    .capt = 1,
+    .pay_freq = kDepositPayFreqEvDay,
+    .tax_rate = 13.0,
+    .key_rate = 16.0,
+    .sum = 1000000.0,
+    .intr_rate = 15.0,
+    .non_taking_rem = 10000.0,
+    .start_date = start,
+    .fund = Transactions(funds, sizeof(funds) / sizeof(funds[0])),
+    .wth = Transactions(withdrawals, sizeof(withdrawals) / sizeof(withdrawals[0]))
+  };
+  BenchRun("DepositCalculate/daily-capitalization-50y", BenchDepositCalculate, &conds);
+  BenchRun("DepositCalculate/golden", BenchDepositGolden, NULL);
+  BenchRun("DepositCalculateStream/daily-capitalization-50y", BenchDepositStream, &conds);
+
+  DepositConditions simple = {
+    .term_type = kDepositTermTypeMonth,
+    .term = 12,
+    .pay_freq = kDepositPayFreqEvMon,
+    .tax_rate = 13.0,
+    .key_rate = 16.0,
+    .sum = 100000.0,
+    .intr_rate = 15.0,
+    .start_date = start,
+    .fund = Transactions(NULL, 0),
+    .wth = Transactions(NULL, 0)
+  };
+  BenchRun("DepositCalculate/monthly-1y", BenchDepositCalculate, &simple);
+
+  DepositConditions yearly = simple;
+  yearly.term_type = kDepositTermTypeYear;
+  yearly.term = kDateLimitsYearMax;
+  yearly.pay_freq = kDepositPayFreqEvYear;
+  BenchRun("DepositCalculate/yearly-50y", BenchDepositCalculate, &yearly);
+
+  // Every term type and pay frequency over a spread of start dates, all
+  // sharing the transactions of the first case.
+  DepositConditions* stress_conds = (DepositConditions*)malloc(kDepositStressCases * sizeof(DepositConditions));
+  DepositData* expected = (DepositData*)malloc(kDepositStressCases * sizeof(DepositData));
+  if (!stress_conds || !expected) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  static const unsigned short kTerms[] = {730, 36, 3};
+  for (size_t i = 0; i < kDepositStressCases; ++i) {
+    stress_conds[i] = conds;
+    stress_conds[i].term_type = (DepositTermType)(i % 3);
+    stress_conds[i].term = (unsigned short)(kTerms[i % 3] / (1 + i % 4));
+    stress_conds[i].pay_freq = (DepositPayFreq)(i % 6);
+    stress_conds[i].capt = (int)(i / 6 % 2);
+    stress_conds[i].sum = 100000.0 + 37.0 * (double)i;
+    stress_conds[i].intr_rate = 5.0 + (double)(i % 11);
+    stress_conds[i].start_date = DateNew(2023 + (int)(i % 3), 1 + (int)(i % 12), 1 + (int)(i % 31));
+    if (DepositCalculate(stress_conds + i, expected + i) != kDepositCalcErrorSuccess) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+  }
+  size_t cpus = ThreadHardwareConcurrency();
+  char name[128];
+  for (size_t threads = 1;; threads *= 2) {
+    if (threads > cpus) {
+      threads = cpus;
+    }
+    DepositStressCase stress = {.conds = stress_conds, .expected = expected, .threads = threads};
+    snprintf(name, sizeof(name), "DepositCalculate/concurrent/threads=%zu", threads);
+    BenchRun(name, BenchDepositConcurrent, &stress);
+    if (threads == cpus) {
+      break;
+    }
+  }
+  DepositStressCase serial = {.conds = stress_conds, .expected = expected, .threads = 1};
+  DepositBatch reference;
+  BasicSetBatchThreads(1);
+  if (DepositCalculateBatch(stress_conds, kDepositStressCases, true, &reference) != kDepositCalcErrorSuccess) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  for (int flows = 0; flows < 2; ++flows) {
+    for (size_t threads = 1;; threads *= 2) {
+      if (threads > cpus) {
+        threads = cpus;
+      }
+      DepositStressCase stress = serial;
+      stress.threads = threads;
+      DepositBatchCase batch_case = {.stress = &stress, .reference = flows ? &reference : NULL};
+      snprintf(name, sizeof(name), "DepositCalculateBatch/%s/threads=%zu", flows ? "flows" : "results", threads);
+      BenchRun(name, BenchDepositBatch, &batch_case);
+      if (threads == cpus) {
+        break;
+      }
+    }
+  }
+
+  // Rates, terms in months and pay frequencies over the conditions of the
+  // first case.
+  static const double kRates[kSweepRates] = {4.0, 6.0, 8.0, 10.0, 12.0, 14.0, 16.0, 18.0};
+  static const unsigned short kSweepTermMonths[kSweepTerms] = {3, 6, 12, 36, 60, 120};
+  static const DepositPayFreq kFreqs[kSweepFreqs] = {
+    kDepositPayFreqEvDay, kDepositPayFreqEvWeek, kDepositPayFreqEvMon,
+    kDepositPayFreqEvQuart, kDepositPayFreqEvHalfYear, kDepositPayFreqEvYear
+  };
+  DepositSweep sweep = {
+    .intr_rates = kRates,
+    .intr_rates_size = kSweepRates,
+    .terms = kSweepTermMonths,
+    .terms_size = kSweepTerms,
+    .pay_freqs = kFreqs,
+    .pay_freqs_size = kSweepFreqs
+  };
+  DepositConditions sweep_base = conds;
+  sweep_base.term_type = kDepositTermTypeMonth;
+  static DepositSweepResult sweep_expected[kSweepPoints];
+  DepositSweepCase sweep_case = {.base = &sweep_base, .sweep = &sweep, .expected = sweep_expected};
+  for (size_t p = 0; p < kSweepPoints; ++p) {
+    DepositConditions point = SweepConditions(&sweep_case, p);
+    DepositData data;
+    if (DepositCalculate(&point, &data) != kDepositCalcErrorSuccess) {
+      fprintf(stderr, "out of memory\n");
+      exit(1);
+    }
+    sweep_expected[p] = (DepositSweepResult){
+      .perc_sum = data.perc_sum, .tax_sum = data.tax_sum, .total = data.total, .eff_rate = data.eff_rate
+    };
+    DepositDestroyData(&data);
+  }
+  BenchRun("DepositCalculate/grid", BenchDepositGrid, &sweep_case);
+  for (size_t threads = 1;; threads *= 2) {
+    if (threads > cpus) {
+      threads = cpus;
+    }
+    sweep_case.threads = threads;
+    snprintf(name, sizeof(name), "DepositCalculateSweep/threads=%zu", threads);
+    BenchRun(name, BenchDepositSweep, &sweep_case);
+    if (threads == cpus) {
+      break;
+    }
+  }
+  // Stops the pool threads.
+  BasicSetBatchThreads(1);
+  DepositDestroyBatch(&reference);
+  for (size_t i = 0; i < kDepositStressCases; ++i) {
+    DepositDestroyData(expected + i);
+  }
+  free(expected);
+  free(stress_conds);
+  VectorDelete(conds.fund);
+  VectorDelete(conds.wth);
+  VectorDelete(simple.fund);
+  VectorDelete(simple.wth);
+}
+
+int main(int argc, char** argv) {
+  if (!BenchInit(argc, argv)) {
+    return 2;
+  }
+  RunBasic();
+  RunCredit();
+  RunDeposit();
+  return BenchFinish();
+}
@@ -0,0 +1,194 @@
+#include "calc_pool.h"
+#include "util/counters.h"
+#include "util/thread.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+enum { kPoolCacheLine = 64 };
+
+// Share of the job a worker starts with. The owner and thieves take
+// chunks from the same counter, so a worker that runs out of its own
+// share helps the slowest one until every share is empty.
+typedef struct {
+  atomic_size_t next;
+  size_t end;
+  // Keeps counters of different workers off the same cache line.
+  char pad[kPoolCacheLine - sizeof(atomic_size_t) - sizeof(size_t)];
+} PoolRange;
+
+typedef struct {
+  CalcPoolFn fn;
+  void* arg;
+  size_t chunk;
+  PoolRange* ranges;
+  size_t workers;
+} PoolJob;
+
+typedef struct {
+  Mutex mutex;
+  Cond work_cond;
+  Cond done_cond;
+  Thread* threads;
+  // Pool threads, the calling thread is one more worker.
+  size_t size;
+  size_t wanted;
+  // Worker count the threads were started for, even when fewer came up.
+  size_t started;
+  size_t generation;
+  size_t active;
+  bool stop;
+  PoolJob* job;
+} Pool;
+
+static Pool pool;
+static Once pool_once = ONCE_INIT;
+// Held by the job running on the pool, others run on their own thread.
+static Mutex job_mutex;
+
+static void PoolInit(void) {
+  MutexInit(&pool.mutex);
+  MutexInit(&job_mutex);
+  CondInit(&pool.work_cond);
+  CondInit(&pool.done_cond);
+}
+
+static bool RangeTake(PoolRange* range, size_t chunk, size_t* begin, size_t* end) {
+  size_t next = atomic_fetch_add_explicit(&range->next, chunk, memory_order_relaxed);
+  if (next >= range->end) {
+    return false;
+  }
+  *begin = next;
+  *end = next + chunk < range->end ? next + chunk : range->end;
+  return true;
+}
+
+static void PoolWork(PoolJob* job, size_t worker) {
+  for (size_t i = 0; i < job->workers; ++i) {
+    PoolRange* range = job->ranges + (worker + i) % job->workers;
+    size_t begin, end;
+    while (RangeTake(range, job->chunk, &begin, &end)) {
+      job->fn(job->arg, worker, begin, end);
+    }
+  }
+}
+
+static void* PoolMain(void* arg) {
+  size_t worker = (size_t)arg;
+  size_t seen = 0;
+  MutexLock(&pool.mutex);
+  for (;;) {
+    while (!pool.stop && pool.generation == seen) {
+      CondWait(&pool.work_cond, &pool.mutex);
+    }
+    if (pool.stop) {
+      break;
+    }
+    seen = pool.generation;
+    PoolJob* job = pool.job;
+    MutexUnlock(&pool.mutex);
+    PoolWork(job, worker);
+    MutexLock(&pool.mutex);
+    if (--pool.active == 0) {
+      CondSignal(&pool.done_cond);
+    }
+  }
+  MutexUnlock(&pool.mutex);
+  return NULL;
+}
+
+static void PoolStop(void) {
+  MutexLock(&pool.mutex);
+  pool.stop = true;
+  CondBroadcast(&pool.work_cond);
+  MutexUnlock(&pool.mutex);
+  for (size_t i = 0; i < pool.size; ++i) {
+    ThreadJoin(pool.threads[i]);
+  }
+  free(pool.threads);
+  pool.threads = NULL;
+  pool.size = 0;
+  pool.started = 0;
+  pool.stop = false;
+  // Threads started later begin waiting for generation 1.
+  pool.generation = 0;
+}
+
+// Starts the pool threads if the wanted count changed. A failure leaves
+// fewer threads, which only costs speed. The pool keeps them until the
+// wanted count changes again rather than retrying on every job.
+static void PoolStart(void) {
+  size_t wanted = pool.wanted ? pool.wanted : ThreadHardwareConcurrency();
+  if (wanted == pool.started) {
+    return;
+  }
+  PoolStop();
+  pool.started = wanted;
+  if (wanted < 2) {
+    return;
+  }
+  pool.threads = (Thread*)CountersMalloc((wanted - 1) * sizeof(Thread));
+  if (!pool.threads) {
+    return;
+  }
+  while (pool.size < wanted - 1 && ThreadCreate(pool.threads + pool.size, PoolMain, (void*)(pool.size + 1))) {
+    ++pool.size;
+  }
+}
+
+size_t CalcPoolAcquire(bool parallel) {
+  OnceCall(&pool_once, PoolInit);
+  if (!parallel || !MutexTryLock(&job_mutex)) {
+    return 1;
+  }
+  PoolStart();
+  if (!pool.size) {
+    MutexUnlock(&job_mutex);
+    return 1;
+  }
+  return pool.size + 1;
+}
+
+void CalcPoolRun(size_t workers, CalcPoolFn fn, void* arg, size_t size, size_t chunk) {
+  PoolRange* ranges = workers > 1 ? (PoolRange*)CountersMalloc(workers * sizeof(PoolRange)) : NULL;
+  if (!ranges) {
+    fn(arg, 0, 0, size);
+    return;
+  }
+  for (size_t i = 0; i < workers; ++i) {
+    atomic_init(&ranges[i].next, size * i / workers);
+    ranges[i].end = size * (i + 1) / workers;
+  }
+  PoolJob job = {.fn = fn, .arg = arg, .chunk = chunk, .ranges = ranges, .workers = workers};
+  MutexLock(&pool.mutex);
+  pool.job = &job;
+  pool.active = pool.size;
+  ++pool.generation;
+  CondBroadcast(&pool.work_cond);
+  MutexUnlock(&pool.mutex);
+  PoolWork(&job, 0);
+  MutexLock(&pool.mutex);
+  while (pool.active) {
+    CondWait(&pool.done_cond, &pool.mutex);
+  }
+  MutexUnlock(&pool.mutex);
+  free(ranges);
+}
+
+void CalcPoolRelease(size_t workers) {
+  if (workers > 1) {
+    MutexUnlock(&job_mutex);
+  }
+}
+
+void CalcPoolSetThreads(size_t threads) {
+  OnceCall(&pool_once, PoolInit);
+  MutexLock(&job_mutex);
+  pool.wanted = threads;
+  // With a single thread nothing runs in the background, which is also
+  // the way to stop the pool before the library is unloaded.
+  if (threads == 1) {
+    PoolStop();
+  }
+  MutexUnlock(&job_mutex);
+}
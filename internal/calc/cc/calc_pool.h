@@ -0,0 +1,24 @@
+#ifndef SMARTCALC_INTERNAL_CALC_CC_CORE_CALC_POOL_H_
+#define SMARTCALC_INTERNAL_CALC_CC_CORE_CALC_POOL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Runs items [begin, end) of a job on the given worker, 0 being the
+// calling thread. Workers get disjoint ranges, so per worker state needs
+// no locking.
+typedef void (*CalcPoolFn)(void* arg, size_t worker, size_t begin, size_t end);
+
+// Takes the pool threads for one job and returns how many workers its
+// runs get, the calling thread included. Only one job holds the pool,
+// any other, and one that is not parallel, gets the calling thread only.
+extern size_t CalcPoolAcquire(bool parallel);
+// Runs fn over [0, size) in chunks, on workers threads taken by
+// CalcPoolAcquire. Returns once every item ran.
+extern void CalcPoolRun(size_t workers, CalcPoolFn fn, void* arg, size_t size, size_t chunk);
+extern void CalcPoolRelease(size_t workers);
+// Threads used by a job, the calling one included. 0 uses every
+// processor, 1 stops the pool threads.
+extern void CalcPoolSetThreads(size_t threads);
+
+#endif // SMARTCALC_INTERNAL_CALC_CC_CORE_CALC_POOL_H_
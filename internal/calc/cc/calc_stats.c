@@ -0,0 +1,48 @@
+#include "calc_stats.h"
+#include "util/counters.h"
+#include "util/thread.h"
+
+static Once stats_once = ONCE_INIT;
+static Mutex stats_mutex;
+// What CalcStatsReset saw, subtracted from every later snapshot.
+static CalcStats stats_base;
+
+static void InitStats(void) {
+  MutexInit(&stats_mutex);
+}
+
+static void PhaseSub(CalcStatsPhase* phase, const CalcStatsPhase* base) {
+  phase->calls -= base->calls;
+  for (size_t i = 0; i < kCalcStatsErrorCodes; ++i) {
+    phase->errors[i] -= base->errors[i];
+  }
+  phase->ns -= base->ns;
+  phase->iterations -= base->iterations;
+}
+
+void CALL_CONV CalcStatsEnable(bool enabled) {
+  atomic_store_explicit(&counters_enabled, enabled, memory_order_relaxed);
+}
+
+void CALL_CONV CalcStatsSnapshot(CalcStats* stats) {
+  *stats = (CalcStats){.enabled = CountersEnabled()};
+  OnceCall(&stats_once, InitStats);
+  // Summed under the lock, a reset in between would leave a base above
+  // the sum.
+  MutexLock(&stats_mutex);
+  CountersSum(stats);
+  stats->allocs -= stats_base.allocs;
+  stats->alloc_bytes -= stats_base.alloc_bytes;
+  for (size_t i = 0; i < kCalcStatsPhaseCount; ++i) {
+    PhaseSub(stats->phases + i, stats_base.phases + i);
+  }
+  MutexUnlock(&stats_mutex);
+}
+
+void CALL_CONV CalcStatsReset(void) {
+  OnceCall(&stats_once, InitStats);
+  MutexLock(&stats_mutex);
+  stats_base = (CalcStats){0};
+  CountersSum(&stats_base);
+  MutexUnlock(&stats_mutex);
+}
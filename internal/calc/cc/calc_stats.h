@@ -0,0 +1,60 @@
+#ifndef SMARTCALC_INTERNAL_CALC_CC_CORE_CALC_STATS_H_
+#define SMARTCALC_INTERNAL_CALC_CC_CORE_CALC_STATS_H_
+
+#include "api.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Room for the error codes of every calculator.
+enum { kCalcStatsErrorCodes = 16 };
+
+typedef enum {
+  // BasicCalculateExpr and BasicCalculateEquation, batches included.
+  kCalcStatsPhaseCalculate = 0,
+  // Parsing an expression into a program, for any caller.
+  kCalcStatsPhaseCompile,
+  // A single evaluation of a compiled program.
+  kCalcStatsPhaseEval,
+  kCalcStatsPhaseCredit,
+  kCalcStatsPhaseDeposit,
+  kCalcStatsPhaseCount
+} CalcStatsPhaseIdx;
+
+// iterations are cache hits for calculate, tokens for compile,
+// instructions for eval, payments for credit and days for deposit.
+typedef struct {
+  uint64_t calls;
+  // Failed calls by the error code of the phase, success stays 0.
+  uint64_t errors[kCalcStatsErrorCodes];
+  uint64_t ns;
+  uint64_t iterations;
+} CalcStatsPhase;
+
+typedef struct {
+  bool enabled;
+  // Threads that counted anything since the library was loaded.
+  size_t threads;
+  uint64_t allocs;
+  uint64_t alloc_bytes;
+  CalcStatsPhase phases[kCalcStatsPhaseCount];
+} CalcStats;
+
+// Counting is off by default. Every thread counts into its own block, so
+// counting costs no shared writes, only a clock read around each phase.
+extern CALC_API void CalcStatsEnable(bool enabled);
+// Sums the blocks of all threads, counts still running may be missed.
+extern CALC_API void CalcStatsSnapshot(CalcStats* stats);
+// Later snapshots only count what happened after the reset.
+extern CALC_API void CalcStatsReset(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // SMARTCALC_INTERNAL_CALC_CC_CORE_CALC_STATS_H_
@@ -1,5 +1,6 @@
 #include "credit_calc.h"
 #include "defs.h"
+#include "util/counters.h"
 
 #include <stdlib.h>
 #include <math.h>
@@ -32,10 +33,12 @@ static void CalculateDiff(const CreditConditions* conds, CreditData* data)  {
 }
 
 CreditCalcError CALL_CONV CreditCalculate(const CreditConditions* conds, CreditData* data) {
+  uint64_t start = CountersStart();
   data->payments_size = (conds->term_type == kCreditTermTypeYear) ? conds->term * kDatesConstsMonthInYear
                                                                   : conds->term;
-  data->payments = (double*)malloc(data->payments_size * sizeof(double));
+  data->payments = (double*)CountersMalloc(data->payments_size * sizeof(double));
   if (!data->payments) {
+    CountersEnd(kCalcStatsPhaseCredit, start, kCreditCalcErrorAllocationFail, 0);
     return kCreditCalcErrorAllocationFail;
   }
   if (conds->credit_type == kCreditTypeAnnuit) {
@@ -43,6 +46,7 @@ CreditCalcError CALL_CONV CreditCalculate(const CreditConditions* conds, CreditD
   } else {
     CalculateDiff(conds, data);
   }
+  CountersEnd(kCalcStatsPhaseCredit, start, kCreditCalcErrorSuccess, data->payments_size);
   return kCreditCalcErrorSuccess;
 }
 
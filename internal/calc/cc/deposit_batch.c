@@ -0,0 +1,336 @@
+#include "deposit_calc.h"
+#include "calc_pool.h"
+#include "deposit_engine.h"
+#include "util/counters.h"
+
+#define VECTOR_MALLOC CountersMalloc
+#define VECTOR_REALLOC CountersRealloc
+#include "util/vector.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+  kDepositBatchChunk = 4,
+  // A deposit takes microseconds, a few of them already pay for waking
+  // the pool.
+  kDepositBatchMinParallel = 4 * kDepositBatchChunk,
+  // Days of the timeline one bitmap word covers.
+  kFlowWordDays = 64,
+  // Days of the timeline one worker merges at a time.
+  kFlowSliceDays = 64 * kFlowWordDays
+};
+
+// Vectors in the blocks keep their header, so VectorSize works on them.
+static const size_t kVectorHeader = 3 * sizeof(size_t);
+
+typedef struct {
+  DepositDataLayout layout;
+  int32_t start_day;
+  int32_t finish_day;
+  // Where the vectors of the result start in the block.
+  size_t block_offset;
+  // Flows of the deposit in the scratch block, until they are merged.
+  size_t flows_offset;
+  DepositFlow* flows;
+} BatchItem;
+
+typedef struct {
+  const DepositConditions* conds;
+  BatchItem* items;
+  size_t size;
+  bool flows;
+  atomic_bool failed;
+  // The results in one block: the data of every deposit, the merged
+  // flows, then the vectors of every deposit.
+  char* block;
+  DepositData* data;
+  DepositFlow* merged;
+  // What only lives during the batch: the runs of every worker, the
+  // flows of every deposit, then the days with a flow and their ranks.
+  char* scratch;
+  size_t runs_bytes;
+  int32_t first_day;
+  int32_t last_day;
+  // A bit per day of the timeline with a flow on it, set as the deposits
+  // are calculated, and the number of such days before every word.
+  atomic_uint_least64_t* days;
+  size_t* ranks;
+  size_t words;
+} BatchJob;
+
+static inline size_t Align(size_t size) {
+  return (size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+}
+
+static inline int PopCount(uint64_t val) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(val);
+#else
+  int count = 0;
+  for (; val; val &= val - 1) {
+    ++count;
+  }
+  return count;
+#endif
+}
+
+static inline int CountTrailingZeros(uint64_t val) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(val);
+#else
+  int count = 0;
+  for (; !(val & 1); val >>= 1) {
+    ++count;
+  }
+  return count;
+#endif
+}
+
+static void BatchMeasure(void* arg, size_t worker_idx, size_t begin, size_t end) {
+  BatchJob* job = (BatchJob*)arg;
+  (void)worker_idx;
+  for (size_t i = begin; i < end; ++i) {
+    BatchItem* item = job->items + i;
+    Date finish_date = DepositFinishDate(job->conds + i);
+    item->layout = DepositDataMeasure(job->conds + i);
+    item->start_day = job->conds[i].start_date.days;
+    item->finish_day = finish_date.days;
+  }
+}
+
+// Empty flows vector with room for size flows at bytes.
+static DepositFlow* PlaceFlows(char* bytes, size_t size) {
+  size_t* header = (size_t*)bytes;
+  header[0] = 0;
+  header[1] = size;
+  header[2] = sizeof(DepositFlow);
+  return (DepositFlow*)(bytes + kVectorHeader);
+}
+
+// Sets the bits of the days the deposit has flows on, a word at a time
+// since the flows are in date order.
+static void MarkFlowDays(BatchJob* job, const DepositFlow* flows) {
+  size_t size = VectorSize((void*)flows);
+  size_t word = 0;
+  uint64_t bits = 0;
+  for (size_t i = 0; i < size; ++i) {
+    size_t day = (size_t)(flows[i].date.days - job->first_day);
+    if (bits && day / kFlowWordDays != word) {
+      atomic_fetch_or_explicit(job->days + word, bits, memory_order_relaxed);
+      bits = 0;
+    }
+    word = day / kFlowWordDays;
+    bits |= UINT64_C(1) << (day % kFlowWordDays);
+  }
+  if (bits) {
+    atomic_fetch_or_explicit(job->days + word, bits, memory_order_relaxed);
+  }
+}
+
+// Calculates every deposit straight into its place in the block.
+static void BatchCalculate(void* arg, size_t worker_idx, size_t begin, size_t end) {
+  BatchJob* job = (BatchJob*)arg;
+  void* runs = job->runs_bytes ? job->scratch + worker_idx * job->runs_bytes : NULL;
+  for (size_t i = begin; i < end && !atomic_load_explicit(&job->failed, memory_order_relaxed); ++i) {
+    BatchItem* item = job->items + i;
+    DepositData* data = job->data + i;
+    DepositDataPlace(data, &item->layout, job->block + item->block_offset);
+    if (job->flows) {
+      item->flows = PlaceFlows(job->scratch + item->flows_offset, item->layout.flows);
+    }
+    uint64_t start = CountersStart();
+    size_t days = 0;
+    DepositCalcError error =
+        DepositCalculateInto(job->conds + i, data, job->flows ? &item->flows : NULL, runs, &days);
+    CountersEnd(kCalcStatsPhaseDeposit, start, error, days);
+    if (error != kDepositCalcErrorSuccess) {
+      atomic_store_explicit(&job->failed, true, memory_order_relaxed);
+      return;
+    }
+    if (job->flows) {
+      MarkFlowDays(job, item->flows);
+    }
+  }
+}
+
+// Index of the merged flow of day, counted from the first day.
+static inline size_t FlowRank(const BatchJob* job, size_t day) {
+  size_t word = day / kFlowWordDays;
+  uint64_t below = (UINT64_C(1) << (day % kFlowWordDays)) - 1;
+  uint64_t bits = atomic_load_explicit(job->days + word, memory_order_relaxed);
+  return job->ranks[word] + (size_t)PopCount(bits & below);
+}
+
+// Adds the flows of every deposit within one slice of the timeline, in
+// the order of the deposits, so each date sums the same way whatever the
+// number of threads. Every date goes to its rank among the days with a
+// flow, so the slices fill the merged flows side by side.
+static void BatchMerge(void* arg, size_t worker_idx, size_t begin, size_t end) {
+  BatchJob* job = (BatchJob*)arg;
+  (void)worker_idx;
+  const size_t slice_words = kFlowSliceDays / kFlowWordDays;
+  for (size_t s = begin; s < end; ++s) {
+    size_t last_word = (s + 1) * slice_words < job->words ? (s + 1) * slice_words : job->words;
+    for (size_t w = s * slice_words; w < last_word; ++w) {
+      DepositFlow* flow = job->merged + job->ranks[w];
+      for (uint64_t bits = atomic_load_explicit(job->days + w, memory_order_relaxed); bits; bits &= bits - 1) {
+        int32_t day = (int32_t)(w * kFlowWordDays) + CountTrailingZeros(bits);
+        *flow++ = (DepositFlow){.date = {.days = job->first_day + day}};
+      }
+    }
+    int32_t first = job->first_day + (int32_t)(s * kFlowSliceDays);
+    int32_t last = first + kFlowSliceDays - 1 < job->last_day ? first + kFlowSliceDays - 1 : job->last_day;
+    for (size_t i = 0; i < job->size; ++i) {
+      const BatchItem* item = job->items + i;
+      if (item->start_day > last || item->finish_day < first) {
+        continue;
+      }
+      const DepositFlow* flows = item->flows;
+      size_t size = VectorSize((void*)flows);
+      size_t lo = 0, hi = size;
+      while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (flows[mid].date.days < first) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      for (; lo < size && flows[lo].date.days <= last; ++lo) {
+        DepositFlow* flow = job->merged + FlowRank(job, (size_t)(flows[lo].date.days - job->first_day));
+        flow->interest += flows[lo].interest;
+        flow->tax += flows[lo].tax;
+        flow->replen += flows[lo].replen;
+      }
+    }
+  }
+}
+
+// Lays out the block with the capacity every result needs and the
+// scratch the calculation and the merge use.
+static bool BatchAllocate(BatchJob* job, size_t workers) {
+  job->first_day = job->items[0].start_day;
+  job->last_day = job->items[0].finish_day;
+  size_t runs_bytes = 0;
+  size_t flows_bound = 0;
+  for (size_t i = 0; i < job->size; ++i) {
+    const BatchItem* item = job->items + i;
+    if (item->start_day < job->first_day) {
+      job->first_day = item->start_day;
+    }
+    if (item->finish_day > job->last_day) {
+      job->last_day = item->finish_day;
+    }
+    size_t bytes = DepositRunsBytes(job->conds + i);
+    if (bytes > runs_bytes) {
+      runs_bytes = bytes;
+    }
+    flows_bound += item->layout.flows;
+  }
+  size_t timeline = job->flows ? (size_t)(job->last_day - job->first_day) + 1 : 0;
+  // No more merged flows than days, nor than the deposits have between
+  // them.
+  size_t merged_size = timeline < flows_bound ? timeline : flows_bound;
+  size_t bytes = job->size * sizeof(DepositData) + merged_size * sizeof(DepositFlow);
+  for (size_t i = 0; i < job->size; ++i) {
+    job->items[i].block_offset = bytes;
+    bytes += job->items[i].layout.bytes;
+  }
+  job->block = (char*)CountersMalloc(bytes);
+  if (!job->block) {
+    return false;
+  }
+  job->data = (DepositData*)job->block;
+  job->merged = (DepositFlow*)(job->block + job->size * sizeof(DepositData));
+
+  job->runs_bytes = Align(runs_bytes);
+  size_t scratch_bytes = workers * job->runs_bytes;
+  size_t days_offset = 0, ranks_offset = 0;
+  if (job->flows) {
+    for (size_t i = 0; i < job->size; ++i) {
+      job->items[i].flows_offset = scratch_bytes;
+      scratch_bytes += kVectorHeader + job->items[i].layout.flows * sizeof(DepositFlow);
+    }
+    job->words = (timeline + kFlowWordDays - 1) / kFlowWordDays;
+    days_offset = scratch_bytes;
+    scratch_bytes += job->words * sizeof(atomic_uint_least64_t);
+    ranks_offset = scratch_bytes;
+    scratch_bytes += (job->words + 1) * sizeof(size_t);
+  }
+  if (!scratch_bytes) {
+    return true;
+  }
+  job->scratch = (char*)CountersMalloc(scratch_bytes);
+  if (!job->scratch) {
+    return false;
+  }
+  if (job->flows) {
+    job->days = (atomic_uint_least64_t*)(job->scratch + days_offset);
+    job->ranks = (size_t*)(job->scratch + ranks_offset);
+    for (size_t w = 0; w < job->words; ++w) {
+      atomic_init(job->days + w, 0);
+    }
+  }
+  return true;
+}
+
+static bool BatchRun(BatchJob* job, size_t workers, DepositBatch* batch) {
+  CalcPoolRun(workers, BatchMeasure, job, job->size, kDepositBatchChunk);
+  if (!BatchAllocate(job, workers)) {
+    return false;
+  }
+  CalcPoolRun(workers, BatchCalculate, job, job->size, kDepositBatchChunk);
+  if (atomic_load_explicit(&job->failed, memory_order_relaxed)) {
+    return false;
+  }
+  batch->data = job->data;
+  batch->size = job->size;
+  if (job->flows) {
+    job->ranks[0] = 0;
+    for (size_t w = 0; w < job->words; ++w) {
+      job->ranks[w + 1] = job->ranks[w] + (size_t)PopCount(atomic_load_explicit(job->days + w, memory_order_relaxed));
+    }
+    size_t slices = (job->words * kFlowWordDays + kFlowSliceDays - 1) / kFlowSliceDays;
+    CalcPoolRun(workers, BatchMerge, job, slices, 1);
+    batch->flows = job->merged;
+    batch->flows_size = job->ranks[job->words];
+  }
+  for (size_t i = 0; i < job->size; ++i) {
+    batch->perc_sum += job->data[i].perc_sum;
+    batch->tax_sum += job->data[i].tax_sum;
+    batch->total += job->data[i].total;
+  }
+  return true;
+}
+
+DepositCalcError CALL_CONV DepositCalculateBatch(const DepositConditions* conds,
+                                                 size_t size,
+                                                 bool flows,
+                                                 DepositBatch* batch) {
+  *batch = (DepositBatch){0};
+  if (size == 0) {
+    return kDepositCalcErrorSuccess;
+  }
+  BatchJob job = {.conds = conds, .size = size, .flows = flows};
+  atomic_init(&job.failed, false);
+  size_t workers = CalcPoolAcquire(size >= kDepositBatchMinParallel);
+  job.items = (BatchItem*)CountersCalloc(size, sizeof(BatchItem));
+  bool done = job.items && BatchRun(&job, workers, batch);
+  CalcPoolRelease(workers);
+  free(job.items);
+  free(job.scratch);
+  if (!done) {
+    free(job.block);
+    *batch = (DepositBatch){0};
+    return kDepositCalcErrorAllocationFail;
+  }
+  return kDepositCalcErrorSuccess;
+}
+
+void CALL_CONV DepositDestroyBatch(DepositBatch* batch) {
+  free(batch->data);
+  *batch = (DepositBatch){0};
+}
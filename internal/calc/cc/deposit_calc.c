@@ -1,15 +1,18 @@
 #include "deposit_calc.h"
 #include "defs.h"
+#include "deposit_engine.h"
+#include "util/counters.h"
+
+#define VECTOR_MALLOC CountersMalloc
+#define VECTOR_REALLOC CountersRealloc
 #include "util/vector.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
-static inline bool LastDayOfTheYear(Date* date) {
-  return DateGetDay(date) == 31 && DateGetMonth(date) == 12;
-}
-
 static inline Date NextPayDate(Date pay_date, int freq) {
   static const int incr[] = {1, 7, 1, 3, 6, 12};
   if (freq < kDepositPayFreqEvMon) {
@@ -20,63 +23,275 @@ static inline Date NextPayDate(Date pay_date, int freq) {
   return pay_date;
 }
 
-static DepositCalcError AddReplenishment(DepositPayout** replen,
-                                         Date* start_date,
-                                         Date* finish_date,
-                                         const DepositTransaction* transaction) {
-  Date transact_date = transaction->payout.date;
-  while (DateLessEqual(&transact_date, finish_date)) {
-    if (DateGreaterEqual(&transact_date, start_date)) {
-      DepositPayout payout = {.date = transact_date,
-                              .sum = transaction->payout.sum
-      };
-      if (!VectorPush(*replen, payout)) {
-        return kDepositCalcErrorAllocationFail;
-      }
-      if (transaction->freq == kDepositTransactionFreqOnce) {
-        break;
-      }
+// Next replenishment of one transaction, past the finish date once it
+// has no more.
+typedef struct {
+  Date date;
+  double sum;
+  DepositTransactionFreq freq;
+} ReplenRun;
+
+// Replenishments from the start to the finish date in date order. They
+// are read from a sorted array or merged from the transactions as the
+// walk goes, equal dates in the order of the transactions, funds first.
+typedef struct {
+  const DepositPayout* payouts;
+  size_t size;
+  size_t next;
+  ReplenRun* runs;
+  size_t runs_size;
+  // Run with the earliest date.
+  size_t head;
+  Date finish_date;
+} ReplenCursor;
+
+static void CursorFindHead(ReplenCursor* cursor) {
+  cursor->head = 0;
+  for (size_t i = 1; i < cursor->runs_size; ++i) {
+    if (DateLess(&cursor->runs[i].date, &cursor->runs[cursor->head].date)) {
+      cursor->head = i;
     }
-    DateAddMonths(&transact_date, transaction->freq);
   }
-  return kDepositCalcErrorSuccess;
 }
 
-static DepositCalcError CalculateDeposit(DepositData* data, const DepositConditions* conds) {
+static inline size_t TransactionsSize(const DepositConditions* conds) {
+  return VectorSize(conds->fund) + VectorSize(conds->wth);
+}
+
+// Run of transaction i, funds first, then withdrawals with the sum
+// negated. A single transaction dated before the start never happens.
+static ReplenRun TransactionRun(const DepositConditions* conds, size_t i, Date finish_date) {
+  size_t funds = VectorSize(conds->fund);
+  const DepositTransaction* transaction = i < funds ? conds->fund + i : conds->wth + (i - funds);
+  ReplenRun run = {
+    .date = transaction->payout.date,
+    .sum = i < funds ? transaction->payout.sum : -transaction->payout.sum,
+    .freq = transaction->freq
+  };
+  if (run.freq == kDepositTransactionFreqOnce) {
+    if (DateLess(&run.date, &conds->start_date)) {
+      run.date = finish_date;
+      DateAddDays(&run.date, 1);
+    }
+    return run;
+  }
+  while (DateLess(&run.date, &conds->start_date)) {
+    DateAddMonths(&run.date, run.freq);
+  }
+  return run;
+}
+
+// runs has room for every transaction.
+static void CursorFromTransactions(ReplenCursor* cursor,
+                                   const DepositConditions* conds,
+                                   Date finish_date,
+                                   ReplenRun* runs) {
+  *cursor = (ReplenCursor){.runs = runs, .runs_size = TransactionsSize(conds), .finish_date = finish_date};
+  for (size_t i = 0; i < cursor->runs_size; ++i) {
+    runs[i] = TransactionRun(conds, i, finish_date);
+  }
+  CursorFindHead(cursor);
+}
+
+// Sets payout to the next replenishment, false once there are no more.
+static bool CursorPeek(const ReplenCursor* cursor, DepositPayout* payout) {
+  if (cursor->runs_size) {
+    const ReplenRun* run = cursor->runs + cursor->head;
+    *payout = (DepositPayout){.date = run->date, .sum = run->sum};
+  } else if (cursor->next < cursor->size) {
+    *payout = cursor->payouts[cursor->next];
+  } else {
+    return false;
+  }
+  return DateLessEqual(&payout->date, &cursor->finish_date);
+}
+
+static void CursorPop(ReplenCursor* cursor) {
+  if (!cursor->runs_size) {
+    ++cursor->next;
+    return;
+  }
+  ReplenRun* run = cursor->runs + cursor->head;
+  if (run->freq == kDepositTransactionFreqOnce) {
+    run->date = cursor->finish_date;
+    DateAddDays(&run->date, 1);
+  } else {
+    DateAddMonths(&run->date, run->freq);
+  }
+  CursorFindHead(cursor);
+}
+
+// Spans shorter than this are summed day by day, a sum starting from
+// zero goes through a new binade every time it doubles and jumping does
+// not pay off.
+enum { kAccrueLoopDays = 64 };
+
+static inline uint64_t DoubleBits(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static inline double DoubleFromBits(uint64_t bits) {
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Adds daily to sum days times, rounding after every addition as a day
+// by day loop does. While sum stays in one binade each addition rounds
+// to the same grid, so from the second step inside it on every step adds
+// the same amount, ties to even included, and the steps left before the
+// edge of the binade are taken with one multiplication.
+static double AccrueDays(double sum, double daily, int days) {
+  if (days < kAccrueLoopDays) {
+    for (int i = 0; i < days; ++i) {
+      sum += daily;
+    }
+    return sum;
+  }
+  // Sign and biased exponent, equal for two values in the same binade.
+  uint64_t prev_binade = 0, binade = DoubleBits(sum) >> 52;
+  while (days > 0) {
+    double next = sum + daily;
+    uint64_t next_binade = DoubleBits(next) >> 52;
+    uint64_t exp = binade & 0x7ff;
+    --days;
+    bool settled = next_binade == binade && binade == prev_binade && exp > 53 && exp < 0x7fe;
+    double prev = sum;
+    sum = next;
+    prev_binade = binade;
+    binade = next_binade;
+    if (!settled || days == 0) {
+      continue;
+    }
+    // Exact, both are on the grid of the binade.
+    double step = sum - prev;
+    double ulp = DoubleFromBits((exp - 52) << 52);
+    double room = signbit(daily) == signbit(sum)
+                  ? DoubleFromBits((exp + 1) << 52) - fabs(sum) - fabs(daily) - ulp
+                  : fabs(sum) - fabs(daily) - ulp - DoubleFromBits(exp << 52);
+    double steps = step == 0.0 ? (double)days : room / fabs(step) - 3.0;
+    if (steps >= 1.0) {
+      int n = steps < (double)days ? (int)steps : days;
+      sum += (double)n * step;
+      days -= n;
+    }
+  }
+  return sum;
+}
+
+// Adds to the last flow when it is on date, flows are pushed in date
+// order.
+static bool AddFlow(DepositFlow** flows, Date date, double interest, double tax, double replen) {
+  if (!flows) {
+    return true;
+  }
+  size_t size = VectorSize(*flows);
+  if (size && DateEqual(&(*flows)[size - 1].date, &date)) {
+    DepositFlow* last = *flows + size - 1;
+    last->interest += interest;
+    last->tax += tax;
+    last->replen += replen;
+    return true;
+  }
+  DepositFlow flow = {.date = date, .interest = interest, .tax = tax, .replen = replen};
+  return VectorPush(*flows, flow);
+}
+
+// Where rows go besides the vectors of the data, both may be NULL.
+typedef struct {
+  DepositFlow** flows;
+  DepositSink sink;
+  void* ctx;
+} RowOutput;
+
+static inline void SinkRow(const RowOutput* out, DepositRowType type, Date date, double sum) {
+  if (out->sink) {
+    DepositRow row = {.type = type, .date = date, .sum = sum};
+    out->sink(out->ctx, &row);
+  }
+}
+
+// Keeps a replenishment of the schedule, taken or not.
+static bool KeepReplen(DepositData* data, const RowOutput* out, DepositPayout payout) {
+  if (data->replen && !VectorPush(data->replen, payout)) {
+    return false;
+  }
+  SinkRow(out, kDepositRowReplen, payout.date, payout.sum);
+  return true;
+}
+
+// Every row goes to the vector of data it belongs to unless that is NULL,
+// and to out. days gets the number of days accrued, for the counters.
+static DepositCalcError CalculateDeposit(DepositData* data,
+                                         const DepositConditions* conds,
+                                         ReplenCursor* replen,
+                                         const RowOutput* out,
+                                         size_t* days) {
   Date start_date = conds->start_date;
   Date finish_date = data->finish_date;
   int am_days = DateDaysTo(&start_date, &finish_date);
 
-
   Date curr_date = conds->start_date;
   DateAddDays(&curr_date, 1);
+  // Only pay dates go through the calendar, the walk itself compares
+  // day numbers and moves on to the next year end once it reaches one.
+  int year = DateGetYear(&curr_date);
+  int days_in_year = DateDaysInYearOf(year);
+  Date year_end = DateYearEnd(&curr_date);
 
   Date pay_date = NextPayDate(start_date, conds->pay_freq);
-  if (!VectorPush(data->pay_dates, pay_date)) {
+  if (data->pay_dates && !VectorPush(data->pay_dates, pay_date)) {
     return kDepositCalcErrorAllocationFail;
   }
 
-  size_t i = 0, j = 0;
-  for (; j < VectorSize(data->replen) && DateGreater(&curr_date, &data->replen[j].date); ++j) {
-    if (conds->sum + data->replen[j].sum >= conds->non_taking_rem) {
-      data->total += data->replen[j].sum;
+  DepositPayout payout;
+  for (; CursorPeek(replen, &payout) && DateGreater(&curr_date, &payout.date); CursorPop(replen)) {
+    if (!KeepReplen(data, out, payout)) {
+      return kDepositCalcErrorAllocationFail;
+    }
+    if (conds->sum + payout.sum >= conds->non_taking_rem) {
+      data->total += payout.sum;
+      if (!AddFlow(out->flows, payout.date, 0.0, 0.0, payout.sum)) {
+        return kDepositCalcErrorAllocationFail;
+      }
     }
   }
+  size_t taxes = 0;
   double add_sum = 0.0, cap_sum = 0.0, pay = 0.0;
   double year_perc = 0.0, non_add_pay = 0.0, non_add_perc = 0.0;
-  for(;DateLessEqual(&curr_date, &finish_date); DateAddDays(&curr_date, 1)) {
-    pay += (conds->sum + add_sum + cap_sum) * conds->intr_rate / DateDaysInYear(&curr_date);
-    non_add_pay += (conds->sum + non_add_perc) * conds->intr_rate / DateDaysInYear(&curr_date);
+  // Between two events, a pay date, a replenishment, a year end or the
+  // finish date, every day accrues the same interest, so the walk goes
+  // from one event to the next.
+  while (DateLessEqual(&curr_date, &finish_date)) {
+    Date event = finish_date;
+    if (DateLess(&pay_date, &event)) {
+      event = pay_date;
+    }
+    if (CursorPeek(replen, &payout) && DateLess(&payout.date, &event)) {
+      event = payout.date;
+    }
+    if (DateLess(&year_end, &event)) {
+      event = year_end;
+    }
+    int span = DateDaysTo(&curr_date, &event) + 1;
+    pay = AccrueDays(pay, (conds->sum + add_sum + cap_sum) * conds->intr_rate / days_in_year, span);
+    non_add_pay = AccrueDays(non_add_pay, (conds->sum + non_add_perc) * conds->intr_rate / days_in_year, span);
+    *days += span;
+    curr_date = event;
 
-    if (DateEqual(&curr_date, &data->pay_dates[i]) || DateEqual(&curr_date, &finish_date)) {
+    if (DateEqual(&curr_date, &pay_date) || DateEqual(&curr_date, &finish_date)) {
       pay_date = NextPayDate(curr_date, conds->pay_freq);
       double payment = round(pay) * 0.01;
       double non_add_payment = round(non_add_pay) * 0.01;
 
-      if (!VectorPush(data->pay_dates, pay_date) ||
-          !VectorPush(data->payments, payment)) {
+      if ((data->pay_dates && !VectorPush(data->pay_dates, pay_date)) ||
+          (data->payments && !VectorPush(data->payments, payment)) ||
+          !AddFlow(out->flows, curr_date, payment, 0.0, 0.0)) {
         return kDepositCalcErrorAllocationFail;
       }
+      SinkRow(out, kDepositRowPayment, curr_date, payment);
       data->perc_sum += payment;
       year_perc += payment;
       non_add_pay = pay = 0.0;
@@ -84,24 +299,37 @@ static DepositCalcError CalculateDeposit(DepositData* data, const DepositConditi
         non_add_perc += non_add_payment;
         cap_sum = data->perc_sum;
       }
-      ++i;
     }
-    for (; j < VectorSize(data->replen) && DateEqual(&curr_date, &data->replen[j].date); ++j) {
-      if (conds->sum + data->replen[j].sum + add_sum + cap_sum >= conds->non_taking_rem) {
-        add_sum += data->replen[j].sum;
+    for (; CursorPeek(replen, &payout) && DateEqual(&curr_date, &payout.date); CursorPop(replen)) {
+      if (!KeepReplen(data, out, payout)) {
+        return kDepositCalcErrorAllocationFail;
+      }
+      if (conds->sum + payout.sum + add_sum + cap_sum >= conds->non_taking_rem) {
+        add_sum += payout.sum;
+        if (!AddFlow(out->flows, curr_date, 0.0, 0.0, payout.sum)) {
+          return kDepositCalcErrorAllocationFail;
+        }
       }
     }
-    if (LastDayOfTheYear(&curr_date) || (DateEqual(&curr_date, &finish_date) && VectorSize(data->taxes))) {
+    bool last_day_of_year = DateEqual(&curr_date, &year_end);
+    if (last_day_of_year || (DateEqual(&curr_date, &finish_date) && taxes)) {
       double tax_inc = year_perc - conds->key_rate * 10000.0;
       year_perc = 0.0;
       if (tax_inc > 0.0) {
         double tax = round(tax_inc * conds->tax_rate) * 0.01;
-        if (!VectorPush(data->taxes, tax)) {
+        if ((data->taxes && !VectorPush(data->taxes, tax)) || !AddFlow(out->flows, curr_date, 0.0, tax, 0.0)) {
           return kDepositCalcErrorAllocationFail;
         }
+        SinkRow(out, kDepositRowTax, curr_date, tax);
         data->tax_sum += tax;
+        ++taxes;
       }
     }
+    if (last_day_of_year) {
+      days_in_year = DateDaysInYearOf(++year);
+      DateAddDays(&year_end, days_in_year);
+    }
+    DateAddDays(&curr_date, 1);
   }
   if (conds->capt) {
     data->eff_rate = (non_add_perc * (double)kDatesConstsAvgDaysInYear * 100.0) / (conds->sum * am_days);
@@ -122,73 +350,237 @@ static Date CalcFinishDate(Date start_date, DepositTermType term_type, int term)
   return start_date;
 }
 
-static int ComparePayouts(const void* lhs, const void* rhs) {
-  DepositPayout* lhs_payout = (DepositPayout*)lhs;
-  DepositPayout* rhs_payout = (DepositPayout*)rhs;
-  if (DateLess(&lhs_payout->date, &rhs_payout->date)) {
-    return -1;
+Date DepositFinishDate(const DepositConditions* conds) {
+  return CalcFinishDate(conds->start_date, conds->term_type, conds->term);
+}
+
+// Allocates the runs of a cursor over the transactions of conds, NULL
+// is also returned when there are none.
+static DepositCalcError AllocateRuns(const DepositConditions* conds, ReplenRun** runs) {
+  size_t size = TransactionsSize(conds);
+  *runs = size ? (ReplenRun*)CountersMalloc(size * sizeof(ReplenRun)) : NULL;
+  return size && !*runs ? kDepositCalcErrorAllocationFail : kDepositCalcErrorSuccess;
+}
+
+DepositCalcError DepositReplenishments(const DepositConditions* conds, Date finish_date, DepositPayout** replen) {
+  ReplenRun* runs;
+  DepositCalcError error = AllocateRuns(conds, &runs);
+  if (error != kDepositCalcErrorSuccess) {
+    return error;
   }
-  if (DateGreater(&lhs_payout->date, &rhs_payout->date)) {
-    return 1;
+  ReplenCursor cursor;
+  CursorFromTransactions(&cursor, conds, finish_date, runs);
+  DepositPayout payout;
+  for (; error == kDepositCalcErrorSuccess && CursorPeek(&cursor, &payout); CursorPop(&cursor)) {
+    if (!VectorPush(*replen, payout)) {
+      error = kDepositCalcErrorAllocationFail;
+    }
   }
-  return 0;
+  free(runs);
+  return error;
 }
 
-static DepositCalcError SetReplenishments(DepositData* data, const DepositConditions* conds) {
-  Date start_date = data->start_date;
-  Date finish_date = data->finish_date;
+static const size_t kDataMemberSizes[kDepositDataArrays] = {
+  [kDepositDataReplen] = sizeof(DepositPayout),
+  [kDepositDataPayDates] = sizeof(Date),
+  [kDepositDataPayments] = sizeof(double),
+  [kDepositDataTaxes] = sizeof(double)
+};
 
-  for (size_t i = 0; i < VectorSize(conds->fund); ++i) {
-    DepositCalcError error = AddReplenishment(&data->replen, &start_date, &finish_date, conds->fund + i);
-    if (error != kDepositCalcErrorSuccess) {
-      return error;
-    }
+// Vectors in a block keep their header, so VectorSize works on them.
+static const size_t kVectorHeader = 3 * sizeof(size_t);
+
+static inline size_t AlignSize(size_t size) {
+  return (size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+}
+
+// Interest is paid on every pay date before the finish date and on the
+// finish date.
+static size_t PaymentsSize(Date start_date, Date finish_date, int freq) {
+  int days = DateDaysTo(&start_date, &finish_date);
+  if (days <= 0) {
+    return 0;
   }
-  for(size_t i = 0; i < VectorSize(conds->wth); ++i) {
-    DepositTransaction wth = conds->wth[i];
-    wth.payout.sum = -wth.payout.sum;
-    DepositCalcError error = AddReplenishment(&data->replen, &start_date, &finish_date, &wth);
-    if (error != kDepositCalcErrorSuccess) {
-      return error;
-    }
+  if (freq < kDepositPayFreqEvMon) {
+    int step = freq == kDepositPayFreqEvDay ? 1 : 7;
+    return (size_t)((days + step - 1) / step);
+  }
+  size_t size = 0;
+  for (Date pay_date = start_date; DateLess(&pay_date, &finish_date); pay_date = NextPayDate(pay_date, freq)) {
+    ++size;
   }
-  qsort(data->replen, VectorSize(data->replen), sizeof(DepositPayout), ComparePayouts);
+  return size;
+}
 
-  return kDepositCalcErrorSuccess;
+// Tax is charged at most on every year end and on the finish date, one
+// less when the finish date is a year end.
+static size_t TaxesSize(Date start_date, Date finish_date) {
+  DateAddDays(&start_date, 1);
+  if (DateGreater(&start_date, &finish_date)) {
+    return 0;
+  }
+  return (size_t)(DateGetYear(&finish_date) - DateGetYear(&start_date) + 1);
 }
 
-DepositCalcError CALL_CONV DepositCalculate(const DepositConditions* conds, DepositData* data) {
-  *data = (DepositData){
-    .start_date = conds->start_date,
-    .finish_date = CalcFinishDate(conds->start_date, conds->term_type, conds->term)
-  };
-  data->pay_dates = VectorNew(Date);
-  if (!data->pay_dates) {
-    return kDepositCalcErrorAllocationFail;
+DepositDataLayout DepositDataMeasure(const DepositConditions* conds) {
+  Date finish_date = DepositFinishDate(conds);
+  DepositDataLayout layout = {0};
+  size_t* sizes = layout.sizes;
+  for (size_t i = 0; i < TransactionsSize(conds); ++i) {
+    ReplenRun run = TransactionRun(conds, i, finish_date);
+    while (DateLessEqual(&run.date, &finish_date)) {
+      ++sizes[kDepositDataReplen];
+      if (run.freq == kDepositTransactionFreqOnce) {
+        break;
+      }
+      DateAddMonths(&run.date, run.freq);
+    }
   }
-  data->replen = VectorNew(DepositPayout);
-  if (!data->replen) {
-    return kDepositCalcErrorAllocationFail;
+  sizes[kDepositDataPayments] = PaymentsSize(conds->start_date, finish_date, conds->pay_freq);
+  // The pay date after the last payment is kept as well.
+  sizes[kDepositDataPayDates] = sizes[kDepositDataPayments] + 1;
+  sizes[kDepositDataTaxes] = TaxesSize(conds->start_date, finish_date);
+  layout.flows = sizes[kDepositDataReplen] + sizes[kDepositDataPayments] + sizes[kDepositDataTaxes];
+  for (size_t k = 0; k < kDepositDataArrays; ++k) {
+    layout.bytes += kVectorHeader + AlignSize(sizes[k] * kDataMemberSizes[k]);
   }
-  data->payments = VectorNew(double);
-  if (!data->payments) {
-    return kDepositCalcErrorAllocationFail;
+  return layout;
+}
+
+void DepositDataPlace(DepositData* data, const DepositDataLayout* layout, void* block) {
+  void* vectors[kDepositDataArrays];
+  char* next = (char*)block;
+  for (size_t k = 0; k < kDepositDataArrays; ++k) {
+    size_t* header = (size_t*)next;
+    header[0] = 0;
+    header[1] = layout->sizes[k];
+    header[2] = kDataMemberSizes[k];
+    vectors[k] = next + kVectorHeader;
+    next += kVectorHeader + AlignSize(layout->sizes[k] * kDataMemberSizes[k]);
   }
-  data->taxes = VectorNew(double);
-  if (!data->taxes) {
+  data->replen = (DepositPayout*)vectors[kDepositDataReplen];
+  data->pay_dates = (Date*)vectors[kDepositDataPayDates];
+  data->payments = (double*)vectors[kDepositDataPayments];
+  data->taxes = (double*)vectors[kDepositDataTaxes];
+}
+
+size_t DepositRunsBytes(const DepositConditions* conds) {
+  return TransactionsSize(conds) * sizeof(ReplenRun);
+}
+
+// Lays out the vectors of data in one block with the capacity every row
+// of conds needs, so they never grow. The runs of a cursor over the
+// transactions follow them unless runs is NULL.
+static DepositCalcError AllocateData(const DepositConditions* conds, DepositData* data, ReplenRun** runs) {
+  DepositDataLayout layout = DepositDataMeasure(conds);
+  char* block = (char*)CountersMalloc(layout.bytes + (runs ? DepositRunsBytes(conds) : 0));
+  if (!block) {
     return kDepositCalcErrorAllocationFail;
   }
-  DepositCalcError error = SetReplenishments(data, conds);
+  DepositDataPlace(data, &layout, block);
+  if (runs) {
+    *runs = (ReplenRun*)(block + layout.bytes);
+  }
+  return kDepositCalcErrorSuccess;
+}
+
+static void ResetData(DepositData* data, const DepositConditions* conds) {
+  data->start_date = conds->start_date;
+  data->finish_date = DepositFinishDate(conds);
+  data->eff_rate = data->perc_sum = data->tax_sum = data->total = 0.0;
+}
+
+// runs has room for every transaction.
+static DepositCalcError CalculateWithRuns(const DepositConditions* conds,
+                                          DepositData* data,
+                                          const RowOutput* out,
+                                          ReplenRun* runs,
+                                          size_t* days) {
+  ResetData(data, conds);
+  ReplenCursor replen;
+  CursorFromTransactions(&replen, conds, data->finish_date, runs);
+  return CalculateDeposit(data, conds, &replen, out, days);
+}
+
+static DepositCalcError CalculateFromTransactions(const DepositConditions* conds,
+                                                  DepositData* data,
+                                                  const RowOutput* out,
+                                                  size_t* days) {
+  ReplenRun* runs;
+  DepositCalcError error = AllocateRuns(conds, &runs);
   if (error != kDepositCalcErrorSuccess) {
     return error;
   }
-  return CalculateDeposit(data, conds);
+  error = CalculateWithRuns(conds, data, out, runs, days);
+  free(runs);
+  return error;
+}
+
+DepositCalcError DepositCalculateInto(const DepositConditions* conds,
+                                      DepositData* data,
+                                      DepositFlow** flows,
+                                      void* runs,
+                                      size_t* days) {
+  RowOutput out = {.flows = flows};
+  return CalculateWithRuns(conds, data, &out, (ReplenRun*)runs, days);
+}
+
+DepositCalcError DepositCalculateShared(const DepositConditions* conds,
+                                        const DepositPayout* replen,
+                                        size_t replen_size,
+                                        DepositData* data,
+                                        size_t* days) {
+  ResetData(data, conds);
+  ReplenCursor cursor = {.payouts = replen, .size = replen_size, .finish_date = data->finish_date};
+  RowOutput out = {0};
+  return CalculateDeposit(data, conds, &cursor, &out, days);
 }
 
+DepositCalcError DepositDataAllocate(const DepositConditions* conds, DepositData* data) {
+  *data = (DepositData){0};
+  ResetData(data, conds);
+  DepositCalcError error = AllocateData(conds, data, NULL);
+  if (error != kDepositCalcErrorSuccess) {
+    *data = (DepositData){0};
+  }
+  return error;
+}
+
+DepositCalcError CALL_CONV DepositCalculate(const DepositConditions* conds, DepositData* data) {
+  uint64_t start = CountersStart();
+  size_t days = 0;
+  *data = (DepositData){0};
+  ResetData(data, conds);
+  ReplenRun* runs;
+  DepositCalcError error = AllocateData(conds, data, &runs);
+  if (error == kDepositCalcErrorSuccess) {
+    RowOutput out = {0};
+    error = CalculateWithRuns(conds, data, &out, runs, &days);
+    if (error != kDepositCalcErrorSuccess) {
+      DepositDestroyData(data);
+    }
+  }
+  CountersEnd(kCalcStatsPhaseDeposit, start, error, days);
+  return error;
+}
+
+DepositCalcError CALL_CONV DepositCalculateStream(const DepositConditions* conds,
+                                                  DepositSink sink,
+                                                  void* ctx,
+                                                  DepositData* data) {
+  uint64_t start = CountersStart();
+  size_t days = 0;
+  *data = (DepositData){0};
+  RowOutput out = {.sink = sink, .ctx = ctx};
+  DepositCalcError error = CalculateFromTransactions(conds, data, &out, &days);
+  CountersEnd(kCalcStatsPhaseDeposit, start, error, days);
+  return error;
+}
+
+// The vectors share the block replen starts, streamed data has none.
 void CALL_CONV DepositDestroyData(DepositData* data) {
-  VectorDelete(data->replen);
-  VectorDelete(data->taxes);
-  VectorDelete(data->payments);
-  VectorDelete(data->pay_dates);
+  if (data->replen) {
+    VectorDelete(data->replen);
+  }
   *data = (DepositData){0};
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "api.h"
 #include "util/date.h"
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #ifdef __cplusplus
@@ -75,8 +76,92 @@ typedef struct {
   DepositTransaction* wth;
 } DepositConditions;
 
+typedef enum { kDepositRowPayment, kDepositRowReplen, kDepositRowTax } DepositRowType;
+
+// One row of a schedule: interest paid out, a replenishment or a
+// withdrawal as DepositData.replen lists them, taken or not, or a tax.
+typedef struct {
+  DepositRowType type;
+  Date date;
+  double sum;
+} DepositRow;
+
+// Gets the rows of DepositCalculateStream in date order, ctx is passed
+// through.
+typedef void (*DepositSink)(void* ctx, const DepositRow* row);
+
+// Money moving on one date: interest paid out, tax charged and the
+// replenishments less withdrawals that were taken.
+typedef struct {
+  Date date;
+  double interest;
+  double tax;
+  double replen;
+} DepositFlow;
+
+// Results of DepositCalculateBatch, all in one block.
+typedef struct {
+  // One per conditions, freed with the batch and not one by one.
+  DepositData* data;
+  size_t size;
+  // Sums over the portfolio, added in the order of the conditions.
+  double perc_sum;
+  double tax_sum;
+  double total;
+  // Flows of every deposit merged by date, ascending. NULL unless asked
+  // for.
+  DepositFlow* flows;
+  size_t flows_size;
+} DepositBatch;
+
+// Values DepositCalculateSweep goes through, every combination is one
+// point. A NULL array keeps the value of the base conditions.
+typedef struct {
+  const double* intr_rates;
+  size_t intr_rates_size;
+  const unsigned short int* terms;
+  size_t terms_size;
+  const DepositPayFreq* pay_freqs;
+  size_t pay_freqs_size;
+} DepositSweep;
+
+typedef struct {
+  double perc_sum;
+  double tax_sum;
+  double total;
+  double eff_rate;
+} DepositSweepResult;
+
+// The vectors of data share one block sized before the calculation,
+// VectorCap gives their capacity: exact for every array but taxes, which
+// has room for one per year end and the finish date.
 extern CALC_API DepositCalcError DepositCalculate(const DepositConditions* conds, DepositData* data);
 extern CALC_API void DepositDestroyData(DepositData* data);
+// Calculates as DepositCalculate but hands every row to sink instead of
+// keeping it. data gets the dates and the sums with NULL vectors, so the
+// memory used does not grow with the term.
+extern CALC_API DepositCalcError DepositCalculateStream(const DepositConditions* conds,
+                                                        DepositSink sink,
+                                                        void* ctx,
+                                                        DepositData* data);
+// Calculates size deposits on the pool shared with BasicCalculateBatch,
+// each as DepositCalculate would. Results and sums do not depend on the
+// number of threads.
+extern CALC_API DepositCalcError DepositCalculateBatch(const DepositConditions* conds,
+                                                       size_t size,
+                                                       bool flows,
+                                                       DepositBatch* batch);
+extern CALC_API void DepositDestroyBatch(DepositBatch* batch);
+// Calculates base for every point of sweep on the pool shared with
+// BasicCalculateBatch, generating the replenishments once for all of
+// them. The point of intr_rates[r], terms[t] and pay_freqs[f] goes to
+// res[(r * terms_size + t) * pay_freqs_size + f], sizes of NULL arrays
+// counting as 1. Unless schedules is NULL, the same element of it gets
+// the point as DepositCalculate fills it, freed with DepositDestroyData.
+extern CALC_API DepositCalcError DepositCalculateSweep(const DepositConditions* base,
+                                                       const DepositSweep* sweep,
+                                                       DepositSweepResult* res,
+                                                       DepositData* schedules);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -0,0 +1,60 @@
+#ifndef SMARTCALC_INTERNAL_CALC_CC_CORE_DEPOSIT_ENGINE_H_
+#define SMARTCALC_INTERNAL_CALC_CC_CORE_DEPOSIT_ENGINE_H_
+
+#include "deposit_calc.h"
+
+#include <stddef.h>
+
+// Vectors of DepositData in the order they follow each other in a block.
+enum {
+  kDepositDataReplen,
+  kDepositDataPayDates,
+  kDepositDataPayments,
+  kDepositDataTaxes,
+  kDepositDataArrays
+};
+
+// Capacity every vector of the data of some conditions needs, and the
+// bytes of the block holding them with their headers.
+typedef struct {
+  size_t sizes[kDepositDataArrays];
+  size_t bytes;
+  // Most flows the rows can add up to.
+  size_t flows;
+} DepositDataLayout;
+
+extern DepositDataLayout DepositDataMeasure(const DepositConditions* conds);
+// Lays out the empty vectors of data in block, which has layout->bytes.
+// They are not freed on their own.
+extern void DepositDataPlace(DepositData* data, const DepositDataLayout* layout, void* block);
+// Allocates the vectors of data in one block as DepositCalculate does,
+// with the capacity the rows of conds need, freed with
+// DepositDestroyData.
+extern DepositCalcError DepositDataAllocate(const DepositConditions* conds, DepositData* data);
+// Scratch DepositCalculateInto needs for the transactions of conds.
+extern size_t DepositRunsBytes(const DepositConditions* conds);
+// Calculates conds into data, keeping the rows in its vectors that are
+// not NULL, which must be empty. Every dated amount also goes to flows,
+// merged per date, unless flows is NULL. runs has DepositRunsBytes and
+// days gets the number of days accrued.
+extern DepositCalcError DepositCalculateInto(const DepositConditions* conds,
+                                             DepositData* data,
+                                             DepositFlow** flows,
+                                             void* runs,
+                                             size_t* days);
+// Finish date of a deposit under conds.
+extern Date DepositFinishDate(const DepositConditions* conds);
+// Pushes the replenishments of conds up to finish_date to replen in date
+// order, equal dates in the order of the transactions.
+extern DepositCalcError DepositReplenishments(const DepositConditions* conds,
+                                              Date finish_date,
+                                              DepositPayout** replen);
+// As DepositCalculateInto without flows, with the replenishments of
+// DepositReplenishments, which may run past the finish date of conds.
+extern DepositCalcError DepositCalculateShared(const DepositConditions* conds,
+                                               const DepositPayout* replen,
+                                               size_t replen_size,
+                                               DepositData* data,
+                                               size_t* days);
+
+#endif // SMARTCALC_INTERNAL_CALC_CC_CORE_DEPOSIT_ENGINE_H_
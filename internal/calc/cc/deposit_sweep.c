@@ -0,0 +1,134 @@
+#include "deposit_calc.h"
+#include "calc_pool.h"
+#include "deposit_engine.h"
+#include "util/counters.h"
+
+#define VECTOR_MALLOC CountersMalloc
+#define VECTOR_REALLOC CountersRealloc
+#include "util/vector.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+enum {
+  kDepositSweepChunk = 4,
+  kDepositSweepMinParallel = 4 * kDepositSweepChunk
+};
+
+typedef struct {
+  const DepositConditions* base;
+  const DepositSweep* sweep;
+  size_t terms_size;
+  size_t pay_freqs_size;
+  // Replenishments up to the finish date of the longest term, every
+  // point takes the ones up to its own.
+  const DepositPayout* replen;
+  size_t replen_size;
+  DepositSweepResult* res;
+  DepositData* schedules;
+  atomic_bool failed;
+} SweepJob;
+
+static void SweepCalculate(void* arg, size_t worker, size_t begin, size_t end) {
+  SweepJob* job = (SweepJob*)arg;
+  (void)worker;
+  const DepositSweep* sweep = job->sweep;
+  for (size_t p = begin; p < end && !atomic_load_explicit(&job->failed, memory_order_relaxed); ++p) {
+    DepositConditions conds = *job->base;
+    size_t f = p % job->pay_freqs_size;
+    size_t t = p / job->pay_freqs_size % job->terms_size;
+    size_t r = p / job->pay_freqs_size / job->terms_size;
+    if (sweep->intr_rates) {
+      conds.intr_rate = sweep->intr_rates[r];
+    }
+    if (sweep->terms) {
+      conds.term = sweep->terms[t];
+    }
+    if (sweep->pay_freqs) {
+      conds.pay_freq = sweep->pay_freqs[f];
+    }
+    uint64_t start = CountersStart();
+    size_t days = 0;
+    // Without schedules the vectors stay NULL and no row is kept.
+    DepositData totals = {0};
+    DepositData* data = job->schedules ? job->schedules + p : &totals;
+    DepositCalcError error = job->schedules ? DepositDataAllocate(&conds, data) : kDepositCalcErrorSuccess;
+    if (error == kDepositCalcErrorSuccess) {
+      error = DepositCalculateShared(&conds, job->replen, job->replen_size, data, &days);
+    }
+    CountersEnd(kCalcStatsPhaseDeposit, start, error, days);
+    if (error != kDepositCalcErrorSuccess) {
+      atomic_store_explicit(&job->failed, true, memory_order_relaxed);
+      return;
+    }
+    job->res[p] = (DepositSweepResult){
+      .perc_sum = data->perc_sum,
+      .tax_sum = data->tax_sum,
+      .total = data->total,
+      .eff_rate = data->eff_rate
+    };
+  }
+}
+
+// Generates the replenishments once, up to the latest finish date of the
+// swept terms.
+static DepositPayout* SweepReplenishments(const DepositConditions* base, const DepositSweep* sweep) {
+  Date finish_date = DepositFinishDate(base);
+  for (size_t i = 0; sweep->terms && i < sweep->terms_size; ++i) {
+    DepositConditions conds = *base;
+    conds.term = sweep->terms[i];
+    Date date = DepositFinishDate(&conds);
+    if (i == 0 || DateGreater(&date, &finish_date)) {
+      finish_date = date;
+    }
+  }
+  DepositPayout* replen = VectorNew(DepositPayout);
+  if (replen && DepositReplenishments(base, finish_date, &replen) != kDepositCalcErrorSuccess) {
+    // A failed push leaves replen NULL.
+    if (replen) {
+      VectorDelete(replen);
+    }
+    return NULL;
+  }
+  return replen;
+}
+
+DepositCalcError CALL_CONV DepositCalculateSweep(const DepositConditions* base,
+                                                 const DepositSweep* sweep,
+                                                 DepositSweepResult* res,
+                                                 DepositData* schedules) {
+  size_t intr_rates_size = sweep->intr_rates ? sweep->intr_rates_size : 1;
+  SweepJob job = {
+    .base = base,
+    .sweep = sweep,
+    .terms_size = sweep->terms ? sweep->terms_size : 1,
+    .pay_freqs_size = sweep->pay_freqs ? sweep->pay_freqs_size : 1,
+    .res = res,
+    .schedules = schedules
+  };
+  atomic_init(&job.failed, false);
+  size_t size = intr_rates_size * job.terms_size * job.pay_freqs_size;
+  for (size_t i = 0; schedules && i < size; ++i) {
+    schedules[i] = (DepositData){0};
+  }
+  if (size == 0) {
+    return kDepositCalcErrorSuccess;
+  }
+  DepositPayout* replen = SweepReplenishments(base, sweep);
+  if (!replen) {
+    return kDepositCalcErrorAllocationFail;
+  }
+  job.replen = replen;
+  job.replen_size = VectorSize(replen);
+  size_t workers = CalcPoolAcquire(size >= kDepositSweepMinParallel);
+  CalcPoolRun(workers, SweepCalculate, &job, size, kDepositSweepChunk);
+  CalcPoolRelease(workers);
+  VectorDelete(replen);
+  if (atomic_load_explicit(&job.failed, memory_order_relaxed)) {
+    for (size_t i = 0; schedules && i < size; ++i) {
+      DepositDestroyData(schedules + i);
+    }
+    return kDepositCalcErrorAllocationFail;
+  }
+  return kDepositCalcErrorSuccess;
+}
@@ -0,0 +1,177 @@
+#include "counters.h"
+#include "thread.h"
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#   include <windows.h>
+#else
+#   include <time.h>
+#endif
+
+// Counters of one thread. Only the owner writes them, so an add is a
+// plain load and store, snapshots read them from any thread.
+typedef struct CountersBlock {
+  atomic_uint_fast64_t allocs;
+  atomic_uint_fast64_t alloc_bytes;
+  struct {
+    atomic_uint_fast64_t calls;
+    atomic_uint_fast64_t errors[kCalcStatsErrorCodes];
+    atomic_uint_fast64_t ns;
+    atomic_uint_fast64_t iterations;
+  } phases[kCalcStatsPhaseCount];
+  // Cleared when the thread exits, a new thread then takes the block
+  // over and keeps adding to what it holds.
+  atomic_bool owned;
+  struct CountersBlock* next;
+} CountersBlock;
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#   define COUNTERS_THREAD_LOCAL __declspec(thread)
+#else
+#   define COUNTERS_THREAD_LOCAL _Thread_local
+#endif
+
+atomic_bool counters_enabled = false;
+
+// The block of the calling thread. The key only has it for its destructor.
+static COUNTERS_THREAD_LOCAL CountersBlock* thread_block = NULL;
+
+static Once counters_once = ONCE_INIT;
+static bool counters_key_created = false;
+static ThreadKey counters_key;
+static Mutex counters_mutex;
+static CountersBlock* counters_blocks = NULL;
+static size_t counters_threads = 0;
+
+static void ReleaseBlock(void* block) {
+  atomic_store_explicit(&((CountersBlock*)block)->owned, false, memory_order_release);
+}
+
+static void InitCounters(void) {
+  MutexInit(&counters_mutex);
+  counters_key_created = ThreadKeyCreate(&counters_key, ReleaseBlock);
+}
+
+static CountersBlock* ClaimBlock(void) {
+  OnceCall(&counters_once, InitCounters);
+  if (!counters_key_created) {
+    return NULL;
+  }
+  MutexLock(&counters_mutex);
+  CountersBlock* block = counters_blocks;
+  while (block && atomic_load_explicit(&block->owned, memory_order_acquire)) {
+    block = block->next;
+  }
+  if (!block) {
+    // Not counted itself, the block is bookkeeping of the counters.
+    block = (CountersBlock*)calloc(1, sizeof(CountersBlock));
+    if (block) {
+      block->next = counters_blocks;
+      counters_blocks = block;
+    }
+  }
+  if (block) {
+    atomic_store_explicit(&block->owned, true, memory_order_relaxed);
+    ++counters_threads;
+  }
+  MutexUnlock(&counters_mutex);
+  if (block) {
+    ThreadKeySet(counters_key, block);
+    thread_block = block;
+  }
+  return block;
+}
+
+static inline CountersBlock* ThreadBlock(void) {
+  return thread_block ? thread_block : ClaimBlock();
+}
+
+static inline void Add(atomic_uint_fast64_t* counter, uint64_t value) {
+  atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+static inline uint64_t Load(atomic_uint_fast64_t* counter) {
+  return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+uint64_t CountersNow(void) {
+#ifdef _WIN32
+  static COUNTERS_THREAD_LOCAL LARGE_INTEGER freq;
+  LARGE_INTEGER now;
+  if (!freq.QuadPart) {
+    QueryPerformanceFrequency(&freq);
+  }
+  QueryPerformanceCounter(&now);
+  return (uint64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void CountersAddAlloc(size_t bytes) {
+  CountersBlock* block = ThreadBlock();
+  if (block) {
+    Add(&block->allocs, 1);
+    Add(&block->alloc_bytes, bytes);
+  }
+}
+
+void* CountersMalloc(size_t size) {
+  void* ptr = malloc(size);
+  if (ptr && CountersEnabled()) {
+    CountersAddAlloc(size);
+  }
+  return ptr;
+}
+
+void* CountersCalloc(size_t count, size_t size) {
+  void* ptr = calloc(count, size);
+  if (ptr && CountersEnabled()) {
+    CountersAddAlloc(count * size);
+  }
+  return ptr;
+}
+
+void* CountersRealloc(void* ptr, size_t size) {
+  void* new_ptr = realloc(ptr, size);
+  if (new_ptr && CountersEnabled()) {
+    CountersAddAlloc(size);
+  }
+  return new_ptr;
+}
+
+void CountersAddPhase(CalcStatsPhaseIdx phase, int error, uint64_t ns, uint64_t iterations) {
+  CountersBlock* block = ThreadBlock();
+  if (!block) {
+    return;
+  }
+  Add(&block->phases[phase].calls, 1);
+  if (error > 0 && error < kCalcStatsErrorCodes) {
+    Add(&block->phases[phase].errors[error], 1);
+  }
+  Add(&block->phases[phase].ns, ns);
+  Add(&block->phases[phase].iterations, iterations);
+}
+
+void CountersSum(CalcStats* stats) {
+  OnceCall(&counters_once, InitCounters);
+  MutexLock(&counters_mutex);
+  stats->threads += counters_threads;
+  for (CountersBlock* block = counters_blocks; block; block = block->next) {
+    stats->allocs += Load(&block->allocs);
+    stats->alloc_bytes += Load(&block->alloc_bytes);
+    for (size_t i = 0; i < kCalcStatsPhaseCount; ++i) {
+      CalcStatsPhase* phase = stats->phases + i;
+      phase->calls += Load(&block->phases[i].calls);
+      for (size_t j = 0; j < kCalcStatsErrorCodes; ++j) {
+        phase->errors[j] += Load(&block->phases[i].errors[j]);
+      }
+      phase->ns += Load(&block->phases[i].ns);
+      phase->iterations += Load(&block->phases[i].iterations);
+    }
+  }
+  MutexUnlock(&counters_mutex);
+}
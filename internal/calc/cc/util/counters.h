@@ -0,0 +1,52 @@
+#ifndef SMARTCALC_INTERNAL_UTIL_CC_CORE_COUNTERS_H_
+#define SMARTCALC_INTERNAL_UTIL_CC_CORE_COUNTERS_H_
+
+#include "../calc_stats.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+extern atomic_bool counters_enabled;
+
+extern uint64_t CountersNow(void);
+extern void CountersAddAlloc(size_t bytes);
+extern void CountersAddPhase(CalcStatsPhaseIdx phase, int error, uint64_t ns, uint64_t iterations);
+// Adds the blocks of all threads to stats.
+extern void CountersSum(CalcStats* stats);
+
+static inline bool CountersEnabled(void) {
+  return atomic_load_explicit(&counters_enabled, memory_order_relaxed);
+}
+
+// 0 when counting is off, the matching CountersEnd then does nothing.
+static inline uint64_t CountersStart(void) {
+  return CountersEnabled() ? CountersNow() : 0;
+}
+
+// Returns when the phase ended, so that a phase right after it can start
+// there without another clock read.
+static inline uint64_t CountersEnd(CalcStatsPhaseIdx phase, uint64_t start, int error, uint64_t iterations) {
+  if (!start) {
+    return 0;
+  }
+  uint64_t end = CountersNow();
+  CountersAddPhase(phase, error, end - start, iterations);
+  return end;
+}
+
+// For a phase that ended with the one that returned end.
+static inline void CountersEndAt(CalcStatsPhaseIdx phase, uint64_t start, uint64_t end, int error, uint64_t iterations) {
+  if (start) {
+    CountersAddPhase(phase, error, end - start, iterations);
+  }
+}
+
+// The allocator of the library, counting what succeeds. Kept out of
+// line, next to malloc the call costs nothing and callers stay small.
+extern void* CountersMalloc(size_t size);
+extern void* CountersCalloc(size_t count, size_t size);
+extern void* CountersRealloc(void* ptr, size_t size);
+
+#endif // SMARTCALC_INTERNAL_UTIL_CC_CORE_COUNTERS_H_
@@ -2,134 +2,141 @@
 #define SMARTCALC_INTERNAL_UTIL_CC_CORE_DATE_H_
 
 #include <stdbool.h>
-#include <time.h>
-#include <math.h>
+#include <stdint.h>
 
-typedef struct tm Date;
+// Days since 1970-01-01 in the proleptic Gregorian calendar. Dates are
+// plain numbers, only DateNew and the getters deal with years, months
+// and days, so nothing here depends on the time zone.
+typedef struct {
+  int32_t days;
+} Date;
 
-static const int kOneDay = 86400;
-static const int kOneHour = 3600;
-static const int kOneMinute = 60;
+typedef struct {
+  int year;
+  int month;
+  int day;
+} DateCivil;
 
 static inline bool IsLeapYear(int year) {
   return (year % 4 == 0 && year % 100 != 0) || (year % 400 == 0);
 }
 
-static inline Date DateNewCopy(const Date* date) {
-  Date copy = *date;
-  return copy;
-}
-
-static inline Date DateNewFromArray(const int array[3]) {
-  Date date = {
-      .tm_year = array[0] - 1900,
-      .tm_mon = array[1] - 1,
-      .tm_mday = array[2],
-      .tm_isdst = -1
+// Days from 1970-01-01 to the given day, eras of 400 years starting on
+// March 1st keep the leap day at the end of the year.
+static inline int32_t DateDaysFromCivil(int year, int month, int day) {
+  year -= month <= 2;
+  int era = (year >= 0 ? year : year - 399) / 400;
+  int year_of_era = year - era * 400;
+  int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  return era * 146097 + day_of_era - 719468;
+}
+
+static inline DateCivil DateToCivil(Date date) {
+  int32_t days = date.days + 719468;
+  int era = (days >= 0 ? days : days - 146096) / 146097;
+  int day_of_era = days - era * 146097;
+  int year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+  int day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  int month_of_year = (5 * day_of_year + 2) / 153;
+  DateCivil civil = {
+    .day = day_of_year - (153 * month_of_year + 2) / 5 + 1,
+    .month = month_of_year < 10 ? month_of_year + 3 : month_of_year - 9,
+    .year = year_of_era + era * 400
   };
-  mktime(&date);
-  return date;
+  civil.year += civil.month <= 2;
+  return civil;
 }
 
+// Out of range months and days carry over as mktime does, so Feb 31st
+// is Mar 3rd or Mar 2nd.
 static inline Date DateNew(int year, int month, int day) {
-  Date date = {
-    .tm_year = year - 1900,
-    .tm_mon = month - 1,
-    .tm_mday = day,
-    .tm_isdst = -1
-  };
-  mktime(&date);
-  return date;
+  int month_idx = month - 1;
+  year += month_idx >= 0 ? month_idx / 12 : (month_idx - 11) / 12;
+  month_idx -= (month_idx >= 0 ? month_idx / 12 : (month_idx - 11) / 12) * 12;
+  return (Date){DateDaysFromCivil(year, month_idx + 1, 1) + day - 1};
+}
+
+static inline Date DateNewFromArray(const int array[3]) {
+  return DateNew(array[0], array[1], array[2]);
 }
 
 static inline int DateGetYear(const Date* date) {
-  return date->tm_year + 1900;
+  return DateToCivil(*date).year;
 }
 
 static inline int DateGetMonth(const Date* date) {
-  return date->tm_mon + 1;
+  return DateToCivil(*date).month;
 }
 
 static inline int DateGetDay(const Date* date) {
-  return date->tm_mday;
+  return DateToCivil(*date).day;
+}
+
+static inline int DateDaysInYearOf(int year) {
+  return 365 + IsLeapYear(year);
 }
 
 static inline int DateDaysInMonth(const Date* date) {
   static const int month_days[] = {31, 28, 31, 30,
                                    31, 30, 31, 31,
                                    30, 31, 30, 31};
-  int month = DateGetMonth(date);
-  if (month == 2) {
-    return month_days[month - 1] + IsLeapYear(DateGetYear(date));
+  DateCivil civil = DateToCivil(*date);
+  if (civil.month == 2) {
+    return month_days[civil.month - 1] + IsLeapYear(civil.year);
   }
-  return month_days[month - 1];
+  return month_days[civil.month - 1];
 }
 
 static inline int DateDaysInYear(const Date* date) {
-  return 365 + IsLeapYear(DateGetYear(date));
+  return DateDaysInYearOf(DateGetYear(date));
 }
 
-static inline int DateDaysTo(Date* src, Date* dst) {
-  return (int)difftime(mktime(dst), mktime(src)) / (60 * 60 * 24);
+// Dec 31st of the year of date.
+static inline Date DateYearEnd(const Date* date) {
+  return (Date){DateDaysFromCivil(DateGetYear(date), 12, 31)};
 }
 
-static inline bool DateLess(Date* mdt, Date* odt) {
-  return mktime(mdt) < mktime(odt);
+static inline int DateDaysTo(const Date* src, const Date* dst) {
+  return dst->days - src->days;
 }
 
-static inline bool DateLessEqual(Date* mdt, Date* odt) {
-  return mktime(mdt) <= mktime(odt);
+static inline bool DateLess(const Date* mdt, const Date* odt) {
+  return mdt->days < odt->days;
 }
 
-static inline bool DateGreater(Date* mdt, Date* odt) {
-  return mktime(odt) < mktime(mdt);
+static inline bool DateLessEqual(const Date* mdt, const Date* odt) {
+  return mdt->days <= odt->days;
 }
 
-static inline bool DateGreaterEqual(Date* mdt, Date* odt) {
-  return mktime(odt) <= mktime(mdt);
+static inline bool DateGreater(const Date* mdt, const Date* odt) {
+  return mdt->days > odt->days;
 }
 
-static inline bool DateEqual(Date* mdt, Date* odt) {
-  return mktime(mdt) == mktime(odt);
+static inline bool DateGreaterEqual(const Date* mdt, const Date* odt) {
+  return mdt->days >= odt->days;
 }
 
-static inline bool DateNotEqual(Date* mdt, Date* odt) {
-  return mktime(mdt) != mktime(odt);
+static inline bool DateEqual(const Date* mdt, const Date* odt) {
+  return mdt->days == odt->days;
 }
 
-static inline void DateAddYears(Date* date, int nb_years) {
-  date->tm_year += nb_years;
+static inline bool DateNotEqual(const Date* mdt, const Date* odt) {
+  return mdt->days != odt->days;
 }
 
-static inline void DateAddMonths(Date* date, int nb_months) {
-  int nb_year = (int)(ceil(nb_months / 12));
-  int nb_months_final = nb_months % 12;
-
-  if (date->tm_mon + nb_months_final > 11) {
-    nb_year++;
-    nb_months_final = (date->tm_mon + nb_months_final) - 12;
-    date->tm_mon = nb_months_final;
-  } else {
-    date->tm_mon += nb_months_final;
-  }
-  date->tm_year += nb_year;
+static inline void DateAddYears(Date* date, int nb_years) {
+  DateCivil civil = DateToCivil(*date);
+  *date = DateNew(civil.year + nb_years, civil.month, civil.day);
 }
 
-static inline void DateAddSeconds(Date* date, int nb_seconds) {
-  time_t new_seconds = mktime(date) + nb_seconds;
-  *date = *localtime(&new_seconds);
+static inline void DateAddMonths(Date* date, int nb_months) {
+  DateCivil civil = DateToCivil(*date);
+  *date = DateNew(civil.year, civil.month + nb_months, civil.day);
 }
 
 static inline void DateAddDays(Date* date, int nb_days) {
-  DateAddSeconds(date, nb_days * kOneDay);
-}
-
-static inline void DateAddHours(Date* date, int nb_hours) {
-  DateAddSeconds(date, nb_hours * kOneHour);
-}
-
-static inline void DateAddMinutes(Date* date, int nb_minutes) {
-  DateAddSeconds(date, nb_minutes * kOneMinute);
+  date->days += nb_days;
 }
 
 #endif // SMARTCALC_INTERNAL_UTIL_CC_CORE_DATE_H_
\ No newline at end of file
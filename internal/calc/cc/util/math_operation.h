@@ -3,7 +3,29 @@
 
 #include <stdbool.h>
 
+enum MathOperationIdx {
+  kUnaryMinus = 0,
+  kUnaryPlus,
+  kSqrt,
+  kSin,
+  kCos,
+  kTan,
+  kAsin,
+  kAcos,
+  kAtan,
+  kLn,
+  kLog,
+  kPower,
+  kMultiply,
+  kDivision,
+  kFmod,
+  kPlus,
+  kMinus,
+  kOpenBrace
+};
+
 typedef struct {
+  enum MathOperationIdx idx;
   int priority;
   int type;
   union {
@@ -18,8 +40,14 @@ enum MathOperationPriority {
   kBrace,
   kSimple,
   kComplex,
+  kExponent,
   kFunction,
   kSign
 };
 
+// Unary operations and functions are listed before kPower in MathOperationIdx.
+static inline bool MathOperationIsUnary(enum MathOperationIdx idx) {
+  return idx < kPower;
+}
+
 #endif // SMARTCALC_INTERNAL_UTIL_CC_CORE_MATH_OPERATION_H_
\ No newline at end of file
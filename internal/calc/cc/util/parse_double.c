@@ -0,0 +1,673 @@
+#include "parse_double.h"
+#include "powers_of_five.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#   include <intrin.h>
+#endif
+
+enum {
+  // Digits that always fit a uint64_t.
+  kMaxFastDigits = 19,
+  // Exact powers of ten as doubles, for the Clinger fast path.
+  kMaxExactPow10 = 22,
+  kMantissaBits = 52,
+  kExponentBias = 1023,
+  kInfinityExp = 0x7FF,
+  // Decimal digits the slow path keeps, more only tell if it was exact.
+  kDecimalDigits = 800,
+  kMaxShift = 60,
+  kMaxExponent = 100000
+};
+
+static inline bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+static inline int HexDigit(char c) {
+  if (IsDigit(c)) {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+static inline char LowerAscii(char c) {
+  return c >= 'A' && c <= 'Z' ? (char)(c - 'A' + 'a') : c;
+}
+
+static inline bool IsSpaceAscii(char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Case-insensitive prefix test, word is lowercase.
+static bool HasPrefix(const char* str, const char* word) {
+  for (; *word; ++str, ++word) {
+    if (LowerAscii(*str) != *word) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static inline int CountLeadingZeros(uint64_t val) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_clzll(val);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanReverse64(&index, val);
+  return 63 - (int)index;
+#else
+  int count = 0;
+  for (uint64_t bit = 1ULL << 63; !(val & bit); bit >>= 1) {
+    ++count;
+  }
+  return count;
+#endif
+}
+
+static inline uint64_t Mul128(uint64_t lhs, uint64_t rhs, uint64_t* lo) {
+#if defined(__SIZEOF_INT128__)
+  unsigned __int128 product = (unsigned __int128)lhs * rhs;
+  *lo = (uint64_t)product;
+  return (uint64_t)(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  uint64_t hi;
+  *lo = _umul128(lhs, rhs, &hi);
+  return hi;
+#else
+  uint64_t lhs_lo = lhs & 0xFFFFFFFF, lhs_hi = lhs >> 32;
+  uint64_t rhs_lo = rhs & 0xFFFFFFFF, rhs_hi = rhs >> 32;
+  uint64_t lo_lo = lhs_lo * rhs_lo;
+  uint64_t hi_lo = lhs_hi * rhs_lo;
+  uint64_t lo_hi = lhs_lo * rhs_hi;
+  uint64_t hi_hi = lhs_hi * rhs_hi;
+  uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+  *lo = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+  return (hi_lo >> 32) + (cross >> 32) + hi_hi;
+#endif
+}
+
+static inline double FromBits(uint64_t bits) {
+  double val;
+  memcpy(&val, &bits, sizeof(val));
+  return val;
+}
+
+// Biased exponent and the mantissa without the implicit bit.
+typedef struct {
+  uint64_t mantissa;
+  int exp;
+} Binary64;
+
+static inline double Binary64Value(Binary64 bin, bool neg) {
+  uint64_t bits = (bin.mantissa & ((1ULL << kMantissaBits) - 1)) | (uint64_t)bin.exp << kMantissaBits;
+  return FromBits(bits | (uint64_t)neg << 63);
+}
+
+// Eisel-Lemire: w * 10^q from the truncated 128-bit significand of 5^q,
+// always exact for w below 10^19 (Mushtak and Lemire, 2023).
+static Binary64 EiselLemire(int q, uint64_t w) {
+  Binary64 res = {0, 0};
+  if (w == 0 || q < kPowersOfFiveMin) {
+    return res;
+  }
+  if (q > kPowersOfFiveMax) {
+    res.exp = kInfinityExp;
+    return res;
+  }
+  int lz = CountLeadingZeros(w);
+  w <<= lz;
+  const uint64_t* pow5 = kPowersOfFive[q - kPowersOfFiveMin];
+  uint64_t lo;
+  uint64_t hi = Mul128(w, pow5[0], &lo);
+  // The low word of 5^q only matters when the 55 bits kept could carry.
+  if ((hi & 0x1FF) == 0x1FF) {
+    uint64_t second_lo;
+    uint64_t second_hi = Mul128(w, pow5[1], &second_lo);
+    lo += second_hi;
+    if (second_hi > lo) {
+      ++hi;
+    }
+  }
+  int upper = (int)(hi >> 63);
+  int shift = upper + 64 - kMantissaBits - 3;
+  res.mantissa = hi >> shift;
+  // floor(log2(10^q)) + 63, 217706 / 2^16 being log2(10).
+  res.exp = (((152170 + 65536) * q) >> 16) + 63 + upper - lz + kExponentBias;
+  if (res.exp <= 0) {
+    if (-res.exp + 1 >= 64) {
+      return (Binary64){0, 0};
+    }
+    res.mantissa >>= -res.exp + 1;
+    res.mantissa += res.mantissa & 1;
+    res.mantissa >>= 1;
+    res.exp = res.mantissa < (1ULL << kMantissaBits) ? 0 : 1;
+    return res;
+  }
+  // Only these q can land exactly halfway, which rounds to even.
+  if (lo <= 1 && q >= -4 && q <= 23 && (res.mantissa & 3) == 1 && (res.mantissa << shift) == hi) {
+    res.mantissa &= ~1ULL;
+  }
+  res.mantissa += res.mantissa & 1;
+  res.mantissa >>= 1;
+  if (res.mantissa >= (2ULL << kMantissaBits)) {
+    res.mantissa = 1ULL << kMantissaBits;
+    ++res.exp;
+  }
+  if (res.exp >= kInfinityExp) {
+    res = (Binary64){0, kInfinityExp};
+  }
+  return res;
+}
+
+// Slow path for the rare inputs the fast one can't decide, digits are
+// shifted in decimal until the binary mantissa can be read off.
+typedef struct {
+  char d[kDecimalDigits];
+  int nd;
+  int dp;
+  // Nonzero digits were dropped past d[nd - 1].
+  bool trunc;
+} Decimal;
+
+typedef struct {
+  int delta;
+  const char* cutoff;
+} LeftCheat;
+
+// Digits a left shift by i adds, one less when the number is below 5^i.
+static const LeftCheat kLeftCheats[kMaxShift + 1] = {
+  {0, ""},
+  {1, "5"},
+  {1, "25"},
+  {1, "125"},
+  {2, "625"},
+  {2, "3125"},
+  {2, "15625"},
+  {3, "78125"},
+  {3, "390625"},
+  {3, "1953125"},
+  {4, "9765625"},
+  {4, "48828125"},
+  {4, "244140625"},
+  {4, "1220703125"},
+  {5, "6103515625"},
+  {5, "30517578125"},
+  {5, "152587890625"},
+  {6, "762939453125"},
+  {6, "3814697265625"},
+  {6, "19073486328125"},
+  {7, "95367431640625"},
+  {7, "476837158203125"},
+  {7, "2384185791015625"},
+  {7, "11920928955078125"},
+  {8, "59604644775390625"},
+  {8, "298023223876953125"},
+  {8, "1490116119384765625"},
+  {9, "7450580596923828125"},
+  {9, "37252902984619140625"},
+  {9, "186264514923095703125"},
+  {10, "931322574615478515625"},
+  {10, "4656612873077392578125"},
+  {10, "23283064365386962890625"},
+  {10, "116415321826934814453125"},
+  {11, "582076609134674072265625"},
+  {11, "2910383045673370361328125"},
+  {11, "14551915228366851806640625"},
+  {12, "72759576141834259033203125"},
+  {12, "363797880709171295166015625"},
+  {12, "1818989403545856475830078125"},
+  {13, "9094947017729282379150390625"},
+  {13, "45474735088646411895751953125"},
+  {13, "227373675443232059478759765625"},
+  {13, "1136868377216160297393798828125"},
+  {14, "5684341886080801486968994140625"},
+  {14, "28421709430404007434844970703125"},
+  {14, "142108547152020037174224853515625"},
+  {15, "710542735760100185871124267578125"},
+  {15, "3552713678800500929355621337890625"},
+  {15, "17763568394002504646778106689453125"},
+  {16, "88817841970012523233890533447265625"},
+  {16, "444089209850062616169452667236328125"},
+  {16, "2220446049250313080847263336181640625"},
+  {16, "11102230246251565404236316680908203125"},
+  {17, "55511151231257827021181583404541015625"},
+  {17, "277555756156289135105907917022705078125"},
+  {17, "1387778780781445675529539585113525390625"},
+  {18, "6938893903907228377647697925567626953125"},
+  {18, "34694469519536141888238489627838134765625"},
+  {18, "173472347597680709441192448139190673828125"},
+  {19, "867361737988403547205962240695953369140625"},};
+
+static void DecimalTrim(Decimal* a) {
+  while (a->nd > 0 && a->d[a->nd - 1] == '0') {
+    --a->nd;
+  }
+  if (a->nd == 0) {
+    a->dp = 0;
+  }
+}
+
+static void DecimalRightShift(Decimal* a, int k) {
+  int r = 0, w = 0;
+  uint64_t n = 0;
+  for (; (n >> k) == 0; ++r) {
+    if (r >= a->nd) {
+      if (n == 0) {
+        a->nd = 0;
+        return;
+      }
+      while ((n >> k) == 0) {
+        n *= 10;
+        ++r;
+      }
+      break;
+    }
+    n = n * 10 + (uint64_t)(a->d[r] - '0');
+  }
+  a->dp -= r - 1;
+  uint64_t mask = (1ULL << k) - 1;
+  for (; r < a->nd; ++r) {
+    uint64_t dig = n >> k;
+    n &= mask;
+    a->d[w++] = (char)('0' + dig);
+    n = n * 10 + (uint64_t)(a->d[r] - '0');
+  }
+  while (n > 0) {
+    uint64_t dig = n >> k;
+    n &= mask;
+    if (w < kDecimalDigits) {
+      a->d[w++] = (char)('0' + dig);
+    } else if (dig > 0) {
+      a->trunc = true;
+    }
+    n *= 10;
+  }
+  a->nd = w;
+  DecimalTrim(a);
+}
+
+static bool PrefixIsLess(const Decimal* a, const char* str) {
+  for (int i = 0; str[i]; ++i) {
+    if (i >= a->nd) {
+      return true;
+    }
+    if (a->d[i] != str[i]) {
+      return a->d[i] < str[i];
+    }
+  }
+  return false;
+}
+
+static void DecimalLeftShift(Decimal* a, int k) {
+  int delta = kLeftCheats[k].delta;
+  if (PrefixIsLess(a, kLeftCheats[k].cutoff)) {
+    --delta;
+  }
+  int r = a->nd, w = a->nd + delta;
+  uint64_t n = 0;
+  for (--r; r >= 0; --r) {
+    n += (uint64_t)(a->d[r] - '0') << k;
+    uint64_t quo = n / 10, rem = n - 10 * quo;
+    if (--w < kDecimalDigits) {
+      a->d[w] = (char)('0' + rem);
+    } else if (rem != 0) {
+      a->trunc = true;
+    }
+    n = quo;
+  }
+  while (n > 0) {
+    uint64_t quo = n / 10, rem = n - 10 * quo;
+    if (--w < kDecimalDigits) {
+      a->d[w] = (char)('0' + rem);
+    } else if (rem != 0) {
+      a->trunc = true;
+    }
+    n = quo;
+  }
+  a->nd += delta;
+  if (a->nd >= kDecimalDigits) {
+    a->nd = kDecimalDigits;
+  }
+  a->dp += delta;
+  DecimalTrim(a);
+}
+
+static void DecimalShift(Decimal* a, int k) {
+  if (a->nd == 0) {
+    return;
+  }
+  for (; k > kMaxShift; k -= kMaxShift) {
+    DecimalLeftShift(a, kMaxShift);
+  }
+  for (; k < -kMaxShift; k += kMaxShift) {
+    DecimalRightShift(a, kMaxShift);
+  }
+  if (k > 0) {
+    DecimalLeftShift(a, k);
+  } else if (k < 0) {
+    DecimalRightShift(a, -k);
+  }
+}
+
+static bool DecimalRoundsUp(const Decimal* a, int nd) {
+  if (nd < 0 || nd >= a->nd) {
+    return false;
+  }
+  if (a->d[nd] == '5' && nd + 1 == a->nd) {
+    // Exactly halfway unless digits were dropped, to even then.
+    return a->trunc || (nd > 0 && (a->d[nd - 1] - '0') % 2 != 0);
+  }
+  return a->d[nd] >= '5';
+}
+
+static uint64_t DecimalRoundedInteger(const Decimal* a) {
+  if (a->dp > 20) {
+    return UINT64_MAX;
+  }
+  int i = 0;
+  uint64_t n = 0;
+  for (; i < a->dp && i < a->nd; ++i) {
+    n = n * 10 + (uint64_t)(a->d[i] - '0');
+  }
+  for (; i < a->dp; ++i) {
+    n *= 10;
+  }
+  return n + DecimalRoundsUp(a, a->dp);
+}
+
+static Binary64 DecimalToBinary(Decimal* a) {
+  // Shift sizes that move the decimal point by a given number of digits.
+  static const int kPowTab[] = {1, 3, 6, 9, 13, 16, 19, 23, 26};
+  static const int kPowTabSize = sizeof(kPowTab) / sizeof(kPowTab[0]);
+  static const Binary64 kInfinity = {0, kInfinityExp};
+  if (a->nd == 0 || a->dp < -330) {
+    return (Binary64){0, 0};
+  }
+  if (a->dp > 310) {
+    return kInfinity;
+  }
+  // Scales into [0.5, 1).
+  int exp = 0;
+  while (a->dp > 0) {
+    int n = a->dp >= kPowTabSize ? 27 : kPowTab[a->dp];
+    DecimalShift(a, -n);
+    exp += n;
+  }
+  while (a->dp < 0 || (a->dp == 0 && a->d[0] < '5')) {
+    int n = -a->dp >= kPowTabSize ? 27 : kPowTab[-a->dp];
+    DecimalShift(a, n);
+    exp -= n;
+  }
+  // From [0.5, 1) to [1, 2), exp is now unbiased.
+  --exp;
+  if (exp < 1 - kExponentBias) {
+    int n = 1 - kExponentBias - exp;
+    DecimalShift(a, -n);
+    exp += n;
+  }
+  if (exp + kExponentBias >= kInfinityExp) {
+    return kInfinity;
+  }
+  DecimalShift(a, 1 + kMantissaBits);
+  uint64_t mantissa = DecimalRoundedInteger(a);
+  if (mantissa == 2ULL << kMantissaBits) {
+    mantissa >>= 1;
+    if (++exp + kExponentBias >= kInfinityExp) {
+      return kInfinity;
+    }
+  }
+  // Subnormal without the implicit bit.
+  if (!(mantissa & (1ULL << kMantissaBits))) {
+    return (Binary64){mantissa, 0};
+  }
+  return (Binary64){mantissa, exp + kExponentBias};
+}
+
+// digits spans the mantissa, point included, exp is the written exponent.
+static Binary64 SlowDecimal(const char* digits, const char* end, int exp) {
+  Decimal a = {.nd = 0};
+  bool saw_dot = false;
+  for (const char* ptr = digits; ptr < end; ++ptr) {
+    if (*ptr == '.') {
+      saw_dot = true;
+      a.dp = a.nd;
+    } else if (*ptr == '0' && a.nd == 0) {
+      --a.dp;
+    } else if (a.nd < kDecimalDigits) {
+      a.d[a.nd++] = *ptr;
+    } else if (*ptr != '0') {
+      a.trunc = true;
+    }
+  }
+  if (!saw_dot) {
+    a.dp = a.nd;
+  }
+  a.dp += exp;
+  return DecimalToBinary(&a);
+}
+
+static const char* ParseExponent(const char* ptr, char mark, char upper_mark, int* exp) {
+  if (*ptr != mark && *ptr != upper_mark) {
+    return ptr;
+  }
+  const char* digits = ptr + 1;
+  bool neg = *digits == '-';
+  if (*digits == '-' || *digits == '+') {
+    ++digits;
+  }
+  if (!IsDigit(*digits)) {
+    return ptr;
+  }
+  int val = 0;
+  for (; IsDigit(*digits); ++digits) {
+    if (val < kMaxExponent) {
+      val = val * 10 + (*digits - '0');
+    }
+  }
+  *exp = neg ? -val : val;
+  return digits;
+}
+
+// w * 10^q when w holds every digit of the number.
+static inline double FastDecimal(uint64_t w, int q) {
+#if FLT_EVAL_METHOD == 0
+  static const double kPow10[kMaxExactPow10 + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  if (w <= (1ULL << 53) && q >= -kMaxExactPow10 && q <= kMaxExactPow10) {
+    // Both operands and the result are exact or rounded once.
+    double val = (double)w;
+    return q < 0 ? val / kPow10[-q] : val * kPow10[q];
+  }
+#endif
+  return Binary64Value(EiselLemire(q, w), false);
+}
+
+static const char* ParseDecimal(const char* str, bool neg, double* res) {
+  const char* ptr = str;
+  uint64_t w = 0;
+  int digits = 0, q = 0;
+  bool any = false, truncated = false;
+  for (; IsDigit(*ptr); ++ptr, any = true) {
+    int d = *ptr - '0';
+    if (digits < kMaxFastDigits) {
+      w = w * 10 + (uint64_t)d;
+      digits += w != 0;
+    } else {
+      ++q;
+      truncated |= d != 0;
+    }
+  }
+  if (*ptr == '.') {
+    for (++ptr; IsDigit(*ptr); ++ptr, any = true) {
+      int d = *ptr - '0';
+      if (digits < kMaxFastDigits) {
+        w = w * 10 + (uint64_t)d;
+        digits += w != 0;
+        --q;
+      } else {
+        truncated |= d != 0;
+      }
+    }
+  }
+  if (!any) {
+    return NULL;
+  }
+  const char* digits_end = ptr;
+  int exp = 0;
+  ptr = ParseExponent(ptr, 'e', 'E', &exp);
+  q += exp;
+  if (!truncated) {
+    double val = FastDecimal(w, q);
+    *res = neg ? -val : val;
+    return ptr;
+  }
+  // The dropped digits put the value between w and w + 1.
+  Binary64 bin = EiselLemire(q, w);
+  Binary64 upper = EiselLemire(q, w + 1);
+  if (upper.exp != bin.exp || upper.mantissa != bin.mantissa) {
+    bin = SlowDecimal(str, digits_end, exp);
+  }
+  *res = Binary64Value(bin, neg);
+  return ptr;
+}
+
+static const char* ParseHex(const char* str, bool neg, double* res) {
+  const char* ptr = str;
+  uint64_t m = 0;
+  int digits = 0, e2 = 0;
+  bool any = false, sticky = false;
+  for (; HexDigit(*ptr) >= 0; ++ptr, any = true) {
+    int d = HexDigit(*ptr);
+    if (digits < 16) {
+      m = m * 16 + (uint64_t)d;
+      digits += m != 0;
+    } else {
+      e2 += 4;
+      sticky |= d != 0;
+    }
+  }
+  if (*ptr == '.') {
+    for (++ptr; HexDigit(*ptr) >= 0; ++ptr, any = true) {
+      int d = HexDigit(*ptr);
+      if (digits < 16) {
+        m = m * 16 + (uint64_t)d;
+        digits += m != 0;
+        e2 -= 4;
+      } else {
+        sticky |= d != 0;
+      }
+    }
+  }
+  if (!any) {
+    return NULL;
+  }
+  int exp = 0;
+  ptr = ParseExponent(ptr, 'p', 'P', &exp);
+  if (m == 0) {
+    *res = neg ? -0.0 : 0.0;
+    return ptr;
+  }
+  int lz = CountLeadingZeros(m);
+  m <<= lz;
+  // The value is m * 2^(e2 - 63) with the top bit of m set.
+  long top = (long)e2 + exp - lz + 63;
+  Binary64 bin;
+  if (top > kExponentBias) {
+    bin = (Binary64){0, kInfinityExp};
+  } else {
+    // 53 bits when normal, fewer as the value goes subnormal.
+    long keep = top >= 1 - kExponentBias ? kMantissaBits + 1 : top + kExponentBias + kMantissaBits;
+    uint64_t mantissa = 0;
+    if (keep >= 0) {
+      int shift = 64 - (int)keep;
+      mantissa = shift < 64 ? m >> shift : 0;
+      uint64_t rem = shift < 64 ? m & ((1ULL << shift) - 1) : m;
+      uint64_t half = 1ULL << (shift - 1);
+      if (rem > half || (rem == half && (sticky || (mantissa & 1)))) {
+        ++mantissa;
+      }
+    }
+    if (keep > kMantissaBits) {
+      bin = (Binary64){mantissa, (int)top + kExponentBias};
+      if (mantissa >> (kMantissaBits + 1)) {
+        bin = (Binary64){mantissa >> 1, bin.exp + 1};
+      }
+      if (bin.exp >= kInfinityExp) {
+        bin = (Binary64){0, kInfinityExp};
+      }
+    } else {
+      // A subnormal that rounds up to the smallest normal sets the
+      // exponent field by itself.
+      bin = (Binary64){mantissa, mantissa >> kMantissaBits ? 1 : 0};
+    }
+  }
+  *res = Binary64Value(bin, neg);
+  return ptr;
+}
+
+static const char* ParseSpecial(const char* ptr, bool neg, double* res) {
+  if (HasPrefix(ptr, "inf")) {
+    *res = neg ? -INFINITY : INFINITY;
+    return ptr + (HasPrefix(ptr, "infinity") ? 8 : 3);
+  }
+  if (HasPrefix(ptr, "nan")) {
+    *res = neg ? -NAN : NAN;
+    ptr += 3;
+    if (*ptr == '(') {
+      const char* close = ptr + 1;
+      while (IsDigit(*close) || (LowerAscii(*close) >= 'a' && LowerAscii(*close) <= 'z') || *close == '_') {
+        ++close;
+      }
+      if (*close == ')') {
+        ptr = close + 1;
+      }
+    }
+    return ptr;
+  }
+  return NULL;
+}
+
+double ParseDouble(const char* str, const char** end) {
+  const char* ptr = str;
+  while (IsSpaceAscii(*ptr)) {
+    ++ptr;
+  }
+  bool neg = *ptr == '-';
+  if (*ptr == '-' || *ptr == '+') {
+    ++ptr;
+  }
+  double res = 0.0;
+  const char* stop = NULL;
+  if (ptr[0] == '0' && LowerAscii(ptr[1]) == 'x') {
+    stop = ParseHex(ptr + 2, neg, &res);
+  }
+  if (!stop) {
+    // "0x" without hex digits is a zero followed by x.
+    stop = ParseDecimal(ptr, neg, &res);
+  }
+  if (!stop) {
+    stop = ParseSpecial(ptr, neg, &res);
+  }
+  if (end) {
+    *end = stop ? stop : str;
+  }
+  return stop ? res : 0.0;
+}
+
+double DecimalToDouble(uint64_t w, int q) {
+  return FastDecimal(w, q);
+}
@@ -0,0 +1,15 @@
+#ifndef SMARTCALC_INTERNAL_UTIL_CC_CORE_PARSE_DOUBLE_H_
+#define SMARTCALC_INTERNAL_UTIL_CC_CORE_PARSE_DOUBLE_H_
+
+#include <stdint.h>
+
+// Reads a number the way strtod does in the C locale, whatever the locale
+// of the process, and rounds it the same way. Accepts leading whitespace,
+// a sign, decimal and hexadecimal forms, inf, infinity and nan. end gets
+// the first unread character, or str when there is no number.
+extern double ParseDouble(const char* str, const char** end);
+// The value of w * 10^q rounded as ParseDouble rounds it, for callers that
+// read the digits themselves. w has to hold all of them, so at most 19.
+extern double DecimalToDouble(uint64_t w, int q);
+
+#endif // SMARTCALC_INTERNAL_UTIL_CC_CORE_PARSE_DOUBLE_H_
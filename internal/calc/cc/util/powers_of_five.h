@@ -0,0 +1,10 @@
+#ifndef SMARTCALC_INTERNAL_UTIL_CC_CORE_POWERS_OF_FIVE_H_
+#define SMARTCALC_INTERNAL_UTIL_CC_CORE_POWERS_OF_FIVE_H_
+
+#include <stdint.h>
+
+enum { kPowersOfFiveMin = -342, kPowersOfFiveMax = 308 };
+
+extern const uint64_t kPowersOfFive[kPowersOfFiveMax - kPowersOfFiveMin + 1][2];
+
+#endif // SMARTCALC_INTERNAL_UTIL_CC_CORE_POWERS_OF_FIVE_H_
@@ -0,0 +1,14 @@
+#ifndef SMARTCALC_INTERNAL_UTIL_CC_CORE_SIMD_H_
+#define SMARTCALC_INTERNAL_UTIL_CC_CORE_SIMD_H_
+
+// Functions marked SIMD_DISPATCH are compiled once per instruction set and
+// the best version for the running cpu (sse2 baseline, avx2 or avx512f)
+// is picked by the loader through an ifunc.
+// Plain loops over doubles get auto-vectorized in each clone.
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__ELF__)
+#   define SIMD_DISPATCH __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#   define SIMD_DISPATCH
+#endif
+
+#endif // SMARTCALC_INTERNAL_UTIL_CC_CORE_SIMD_H_
@@ -1,12 +1,12 @@
 #ifndef SMARTCALC_INTERNAL_UTIL_CC_CORE_STACK_H_
 #define SMARTCALC_INTERNAL_UTIL_CC_CORE_STACK_H_
 
-#include "stack_double.h"
 #include "stack_operation.h"
 
-#define StackNew(type) _Generic(((type){0}), double: StackDoubleNew, MathOperation: StackOperationNew)()
-#define StackPush(st, val) _Generic((st), StackDouble*: StackDoublePush, StackOperation*: StackOperationPush)(st,val)
-#define StackPop(st) _Generic((st), StackDouble**: StackDoublePop, StackOperation**: StackOperationPop)(st)
-#define StackDelete(st) _Generic((st), StackDouble*: StackDoubleDelete, StackOperation*: StackOperationDelete)(st)
+#define StackNew(type) _Generic(((type){0}), MathOperation: StackOperationNew)()
+#define StackPush(st, val) _Generic((st), StackOperation*: StackOperationPush)(st,val)
+#define StackPop(st) _Generic((st), StackOperation*: StackOperationPop)(st)
+#define StackTop(st) _Generic((st), StackOperation*: StackOperationTop)(st)
+#define StackDelete(st) _Generic((st), StackOperation*: StackOperationDelete)(st)
 
 #endif // SMARTCALC_INTERNAL_UTIL_CC_CORE_STACK_H_
\ No newline at end of file
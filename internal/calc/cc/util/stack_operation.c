@@ -1,52 +1,24 @@
 #include "stack_operation.h"
+#include "counters.h"
 
 #include <stdlib.h>
+#include <string.h>
 
-static inline StackOperation* StackOperationAllocate(void) {
-  return (StackOperation*)malloc(sizeof(StackOperation));
-}
-
-static inline void StackOperationDeallocate(StackOperation* stack) {
-  free(stack);
-}
-
-StackOperation* StackOperationNew(void) {
-  StackOperation* new_stack = StackOperationAllocate();
-  if (!new_stack) {
-    return NULL;
-  }
-  *new_stack = (StackOperation){0};
-  return new_stack;
-}
-
-StackOperation* StackOperationPush(StackOperation* stack, MathOperation val) {
-  StackOperation* new_stack = StackOperationAllocate();
-  if (!new_stack) {
-    return NULL;
+bool StackOperationGrow(StackOperation* stack) {
+  size_t cap = stack->cap * 2;
+  MathOperation* heap = (MathOperation*)CountersRealloc(stack->heap, cap * sizeof(MathOperation));
+  if (!heap) {
+    return false;
   }
-  *new_stack = (StackOperation) {
-      .prev = stack,
-      .top = val,
-      .size = stack->size + 1
-  };
-  return new_stack;
-}
-
-MathOperation StackOperationPop(StackOperation** stack) {
-  if ((*stack)->size == 0) {
-    *stack = NULL;
-    return (MathOperation){0};
+  if (!stack->heap) {
+    memcpy(heap, stack->buf, stack->size * sizeof(MathOperation));
   }
-  StackOperation* tmp = *stack;
-  MathOperation top_val = tmp->top;
-  *stack = (*stack)->prev;
-  StackOperationDeallocate(tmp);
-  return top_val;
+  stack->heap = heap;
+  stack->cap = cap;
+  return true;
 }
 
 void StackOperationDelete(StackOperation* stack) {
-  while(stack->size != 0) {
-    StackOperationPop(&stack);
-  }
-  StackOperationDeallocate(stack);
+  free(stack->heap);
+  *stack = StackOperationNew();
 }
\ No newline at end of file
@@ -3,17 +3,45 @@
 
 #include "math_operation.h"
 
+#include <stdbool.h>
 #include <stddef.h>
 
-typedef struct StackOperation {
-  struct StackOperation* prev;
-  MathOperation top;
+enum { kStackOperationBufSize = 64 };
+
+// Operations live in buf until it is full, then the stack moves to the
+// heap. The stack is meant to be a local variable, so a normal expression
+// does not allocate at all.
+typedef struct {
+  MathOperation* heap;
   size_t size;
+  size_t cap;
+  MathOperation buf[kStackOperationBufSize];
 } StackOperation;
 
-extern StackOperation* StackOperationNew(void);
-extern StackOperation* StackOperationPush(StackOperation* stack, MathOperation val);
-extern MathOperation StackOperationPop(StackOperation** stack);
+extern bool StackOperationGrow(StackOperation* stack);
 extern void StackOperationDelete(StackOperation* stack);
 
+static inline StackOperation StackOperationNew(void) {
+  return (StackOperation){.cap = kStackOperationBufSize};
+}
+
+static inline bool StackOperationPush(StackOperation* stack, MathOperation val) {
+  if (stack->size == stack->cap && !StackOperationGrow(stack)) {
+    return false;
+  }
+  (stack->heap ? stack->heap : stack->buf)[stack->size++] = val;
+  return true;
+}
+
+static inline MathOperation StackOperationPop(StackOperation* stack) {
+  if (stack->size == 0) {
+    return (MathOperation){0};
+  }
+  return (stack->heap ? stack->heap : stack->buf)[--stack->size];
+}
+
+static inline MathOperation StackOperationTop(const StackOperation* stack) {
+  return (stack->heap ? stack->heap : stack->buf)[stack->size - 1];
+}
+
 #endif // SMARTCALC_INTERNAL_UTIL_CC_CORE_STACK_OPERATION_H_
\ No newline at end of file
@@ -0,0 +1,202 @@
+#ifndef SMARTCALC_INTERNAL_UTIL_CC_CORE_THREAD_H_
+#define SMARTCALC_INTERNAL_UTIL_CC_CORE_THREAD_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef _WIN32
+#   include <windows.h>
+#   include <stdlib.h>
+#else
+#   include <pthread.h>
+#   include <unistd.h>
+#endif
+
+typedef void* (*ThreadFn)(void* arg);
+
+#ifdef _WIN32
+
+typedef SRWLOCK Mutex;
+typedef CONDITION_VARIABLE Cond;
+typedef INIT_ONCE Once;
+typedef HANDLE Thread;
+typedef DWORD ThreadKey;
+
+#define ONCE_INIT INIT_ONCE_STATIC_INIT
+
+static inline void MutexInit(Mutex* mutex) {
+  InitializeSRWLock(mutex);
+}
+
+static inline void MutexLock(Mutex* mutex) {
+  AcquireSRWLockExclusive(mutex);
+}
+
+static inline bool MutexTryLock(Mutex* mutex) {
+  return TryAcquireSRWLockExclusive(mutex) != 0;
+}
+
+static inline void MutexUnlock(Mutex* mutex) {
+  ReleaseSRWLockExclusive(mutex);
+}
+
+static inline void MutexDestroy(Mutex* mutex) {
+  (void)mutex;
+}
+
+static inline void CondInit(Cond* cond) {
+  InitializeConditionVariable(cond);
+}
+
+static inline void CondWait(Cond* cond, Mutex* mutex) {
+  SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
+}
+
+static inline void CondSignal(Cond* cond) {
+  WakeConditionVariable(cond);
+}
+
+static inline void CondBroadcast(Cond* cond) {
+  WakeAllConditionVariable(cond);
+}
+
+static inline void CondDestroy(Cond* cond) {
+  (void)cond;
+}
+
+static inline BOOL CALLBACK OnceTrampoline(PINIT_ONCE once, PVOID fn, PVOID* ctx) {
+  (void)once;
+  (void)ctx;
+  ((void (*)(void))fn)();
+  return TRUE;
+}
+
+static inline void OnceCall(Once* once, void (*fn)(void)) {
+  InitOnceExecuteOnce(once, OnceTrampoline, (PVOID)fn, NULL);
+}
+
+typedef struct {
+  ThreadFn fn;
+  void* arg;
+} ThreadStart;
+
+static inline DWORD WINAPI ThreadTrampoline(LPVOID param) {
+  ThreadStart start = *(ThreadStart*)param;
+  free(param);
+  start.fn(start.arg);
+  return 0;
+}
+
+static inline bool ThreadCreate(Thread* thread, ThreadFn fn, void* arg) {
+  ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+  if (!start) {
+    return false;
+  }
+  *start = (ThreadStart){.fn = fn, .arg = arg};
+  *thread = CreateThread(NULL, 0, ThreadTrampoline, start, 0, NULL);
+  if (!*thread) {
+    free(start);
+    return false;
+  }
+  return true;
+}
+
+static inline void ThreadJoin(Thread thread) {
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+}
+
+// Fiber local storage is the one with a destructor, run as the thread exits.
+static inline bool ThreadKeyCreate(ThreadKey* key, void (*destructor)(void*)) {
+  *key = FlsAlloc((PFLS_CALLBACK_FUNCTION)destructor);
+  return *key != FLS_OUT_OF_INDEXES;
+}
+
+static inline void ThreadKeySet(ThreadKey key, void* value) {
+  FlsSetValue(key, value);
+}
+
+static inline size_t ThreadHardwareConcurrency(void) {
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors ? info.dwNumberOfProcessors : 1;
+}
+
+#else
+
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t Cond;
+typedef pthread_once_t Once;
+typedef pthread_t Thread;
+typedef pthread_key_t ThreadKey;
+
+#define ONCE_INIT PTHREAD_ONCE_INIT
+
+static inline void MutexInit(Mutex* mutex) {
+  pthread_mutex_init(mutex, NULL);
+}
+
+static inline void MutexLock(Mutex* mutex) {
+  pthread_mutex_lock(mutex);
+}
+
+static inline bool MutexTryLock(Mutex* mutex) {
+  return pthread_mutex_trylock(mutex) == 0;
+}
+
+static inline void MutexUnlock(Mutex* mutex) {
+  pthread_mutex_unlock(mutex);
+}
+
+static inline void MutexDestroy(Mutex* mutex) {
+  pthread_mutex_destroy(mutex);
+}
+
+static inline void CondInit(Cond* cond) {
+  pthread_cond_init(cond, NULL);
+}
+
+static inline void CondWait(Cond* cond, Mutex* mutex) {
+  pthread_cond_wait(cond, mutex);
+}
+
+static inline void CondSignal(Cond* cond) {
+  pthread_cond_signal(cond);
+}
+
+static inline void CondBroadcast(Cond* cond) {
+  pthread_cond_broadcast(cond);
+}
+
+static inline void CondDestroy(Cond* cond) {
+  pthread_cond_destroy(cond);
+}
+
+static inline void OnceCall(Once* once, void (*fn)(void)) {
+  pthread_once(once, fn);
+}
+
+static inline bool ThreadCreate(Thread* thread, ThreadFn fn, void* arg) {
+  return pthread_create(thread, NULL, fn, arg) == 0;
+}
+
+static inline void ThreadJoin(Thread thread) {
+  pthread_join(thread, NULL);
+}
+
+static inline bool ThreadKeyCreate(ThreadKey* key, void (*destructor)(void*)) {
+  return pthread_key_create(key, destructor) == 0;
+}
+
+static inline void ThreadKeySet(ThreadKey key, void* value) {
+  pthread_setspecific(key, value);
+}
+
+static inline size_t ThreadHardwareConcurrency(void) {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (size_t)count : 1;
+}
+
+#endif // _WIN32
+
+#endif // SMARTCALC_INTERNAL_UTIL_CC_CORE_THREAD_H_
@@ -4,6 +4,13 @@
 #include <stddef.h>
 #include <stdlib.h>
 
+// The library defines both before the include to count its allocations,
+// the bindings build vectors with the plain allocator.
+#ifndef VECTOR_MALLOC
+#   define VECTOR_MALLOC malloc
+#   define VECTOR_REALLOC realloc
+#endif
+
 static inline size_t* GetHeader(void* vec) {
   return ((size_t*)vec - 3);
 }
@@ -16,8 +23,8 @@ static inline size_t VectorCap(void* vec) {
   return GetHeader(vec)[1];
 }
 
-static void* VectorInit(size_t member_size) {
-  void* ptr = malloc(3 * sizeof(size_t) + 1);
+static inline void* VectorInit(size_t member_size) {
+  void* ptr = VECTOR_MALLOC(3 * sizeof(size_t) + 1);
   if (!ptr) {
     return NULL;
   }
@@ -27,11 +34,15 @@ static void* VectorInit(size_t member_size) {
   return (void*)(header + 3);
 }
 
+static inline void VectorClear(void* vec) {
+  GetHeader(vec)[0] = 0;
+}
+
 static inline void VectorDelete(void* vec) {
   free(GetHeader(vec));
 }
 
-static void* VectorRealloc(void* vec, size_t member_size) {
+static inline void* VectorRealloc(void* vec, size_t member_size) {
   size_t* header = GetHeader(vec);
   size_t* size = header;
   size_t* cap = header + 1;
@@ -40,7 +51,7 @@ static void* VectorRealloc(void* vec, size_t member_size) {
   }
   if (*size == *cap) {
     *cap = (*cap * 2) + 1;
-    void* new_ptr = realloc(header, 3 * sizeof(size_t) + (*cap * member_size));
+    void* new_ptr = VECTOR_REALLOC(header, 3 * sizeof(size_t) + (*cap * member_size));
     if (!new_ptr) {
       return NULL;
     }
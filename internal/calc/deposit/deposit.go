@@ -5,8 +5,21 @@ package depositcalc
   #include "../cc/deposit_calc.h"
   #include "../cc/util/vector.h"
 
+  #include <stdint.h>
+  #include <stdlib.h>
+
   typedef typeof(&DepositCalculate) DepositCalcFnPtr;
   typedef typeof(&DepositDestroyData) DepositDestroyDataFnPtr;
+  typedef typeof(&DepositCalculateBatch) DepositCalcBatchFnPtr;
+  typedef typeof(&DepositDestroyBatch) DepositDestroyBatchFnPtr;
+  typedef typeof(&DepositCalculateSweep) DepositCalcSweepFnPtr;
+  typedef typeof(&DepositCalculateStream) DepositCalcStreamFnPtr;
+
+  extern void depositSinkGo(uintptr_t handle, DepositRow* row);
+
+  static void DepositSinkTrampoline(void* ctx, const DepositRow* row) {
+		depositSinkGo((uintptr_t)ctx, (DepositRow*)row);
+  }
 
   static inline DepositCalcError CallDepositCalcFnPtr(DepositCalcFnPtr fn_ptr, DepositConditions* conds, DepositData* data) {
 		return fn_ptr(conds, data);
@@ -14,6 +27,18 @@ package depositcalc
   static inline void CallDepositDestroyDataFnPtr(DepositDestroyDataFnPtr fn_ptr, DepositData* data) {
 		return fn_ptr(data);
   }
+  static inline DepositCalcError CallDepositCalcBatchFnPtr(DepositCalcBatchFnPtr fn_ptr, DepositConditions* conds, size_t size, bool flows, DepositBatch* batch) {
+		return fn_ptr(conds, size, flows, batch);
+  }
+  static inline void CallDepositDestroyBatchFnPtr(DepositDestroyBatchFnPtr fn_ptr, DepositBatch* batch) {
+		return fn_ptr(batch);
+  }
+  static inline DepositCalcError CallDepositCalcSweepFnPtr(DepositCalcSweepFnPtr fn_ptr, DepositConditions* base, DepositSweep* sweep, DepositSweepResult* res, DepositData* schedules) {
+		return fn_ptr(base, sweep, res, schedules);
+  }
+  static inline DepositCalcError CallDepositCalcStreamFnPtr(DepositCalcStreamFnPtr fn_ptr, DepositConditions* conds, uintptr_t handle, DepositData* data) {
+		return fn_ptr(conds, DepositSinkTrampoline, (void*)handle, data);
+  }
 
   static inline DepositTransaction* VectorNewTransactionWrap(void) {
 		return VectorNew(DepositTransaction);
@@ -31,10 +56,16 @@ import (
 	"errors"
 	"github.com/pancakeswya/GoSmartCalc/pkg/cconv"
 	"github.com/pancakeswya/GoSmartCalc/pkg/dll"
+	"runtime/cgo"
 	"unsafe"
 )
 
-type CalcFn func(Conditions) (Data, error)
+type (
+	CalcFn       func(Conditions) (Data, error)
+	CalcBatchFn  func([]Conditions, bool) (Batch, error)
+	CalcSweepFn  func(Conditions, Sweep, bool) ([]SweepResult, []Data, error)
+	CalcStreamFn func(Conditions, func(Row)) (Data, error)
+)
 
 type (
 	Payout struct {
@@ -71,15 +102,66 @@ type (
 		Fund         []Transaction
 		Wth          []Transaction
 	}
+	// Flow is the money moving on one date over a whole portfolio.
+	Flow struct {
+		Date     [3]int
+		Interest float64
+		Tax      float64
+		Replen   float64
+	}
+	Batch struct {
+		Data    []Data
+		PercSum float64
+		TaxSum  float64
+		Total   float64
+		// Flows are ascending by date, nil unless asked for.
+		Flows []Flow
+	}
+	// Sweep holds the values swept over, a nil slice keeps the one of
+	// the base conditions.
+	Sweep struct {
+		IntrRates []float64
+		Terms     []int
+		PayFreqs  []int
+	}
+	// Row is one row of a schedule, Sum is a payment, a replenishment
+	// or withdrawal, or a tax as Type says.
+	Row struct {
+		Type int
+		Date [3]int
+		Sum  float64
+	}
+	SweepResult struct {
+		PercSum float64
+		TaxSum  float64
+		Total   float64
+		EffRate float64
+	}
 	Calc struct {
 		Calculate CalcFn
+		// CalculateBatch calculates every deposit on the library's
+		// thread pool and sums them up, with the merged cash flows
+		// when flows is set.
+		CalculateBatch CalcBatchFn
+		// CalculateSweep calculates the base conditions for every
+		// combination of the swept values, results indexed as
+		// (rate*len(Terms)+term)*len(PayFreqs)+payFreq. The schedule of
+		// every point comes along when schedules is set.
+		CalculateSweep CalcSweepFn
+		// CalculateStream hands every row of the schedule to sink as
+		// it is produced and returns Data with the totals only.
+		CalculateStream CalcStreamFn
 	}
 )
 
 // functions api name
 const (
-	calculateFuncName   = "DepositCalculate"
-	destroyDataFuncName = "DepositDestroyData"
+	calculateFuncName       = "DepositCalculate"
+	destroyDataFuncName     = "DepositDestroyData"
+	calculateBatchFuncName  = "DepositCalculateBatch"
+	destroyBatchFuncName    = "DepositDestroyBatch"
+	calculateSweepFuncName  = "DepositCalculateSweep"
+	calculateStreamFuncName = "DepositCalculateStream"
 )
 
 // transaction payout frequency
@@ -102,6 +184,13 @@ const (
 	PayFreqEvYear     = int(C.kDepositPayFreqEvYear)
 )
 
+// schedule row type
+const (
+	RowPayment = int(C.kDepositRowPayment)
+	RowReplen  = int(C.kDepositRowReplen)
+	RowTax     = int(C.kDepositRowTax)
+)
+
 // deposit term type
 const (
 	TermTypeDay   = int(C.kDepositTermTypeDay)
@@ -132,31 +221,34 @@ func New(dl dll.Dll) (*Calc, error) {
 	}
 	DepositDestroyDataFnPtr := C.DepositDestroyDataFnPtr(ptr)
 
+	ptr, err = dl.GetSymbolPtr(calculateBatchFuncName)
+	if err != nil {
+		return nil, err
+	}
+	depositCalcBatchFnPtr := C.DepositCalcBatchFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(destroyBatchFuncName)
+	if err != nil {
+		return nil, err
+	}
+	depositDestroyBatchFnPtr := C.DepositDestroyBatchFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(calculateSweepFuncName)
+	if err != nil {
+		return nil, err
+	}
+	depositCalcSweepFnPtr := C.DepositCalcSweepFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(calculateStreamFuncName)
+	if err != nil {
+		return nil, err
+	}
+	depositCalcStreamFnPtr := C.DepositCalcStreamFnPtr(ptr)
+
 	dc := &Calc{
 		Calculate: func(conds Conditions) (Data, error) {
-			cconds := C.DepositConditions{
-				term_type: C.DepositTermType(conds.TermType),
-				term:      C.ushort(conds.Term),
-				capt:      C.int(conds.Cap),
-				pay_freq:  C.DepositPayFreq(conds.PayFreq),
-
-				tax_rate:       C.double(conds.TaxRate),
-				key_rate:       C.double(conds.KeyRate),
-				sum:            C.double(conds.Sum),
-				intr_rate:      C.double(conds.IntrRate),
-				non_taking_rem: C.double(conds.NonTakingRem),
-
-				start_date: C.DateNew(
-					C.int(conds.StartDate[0]),
-					C.int(conds.StartDate[1]),
-					C.int(conds.StartDate[2])),
-			}
-			var errCode C.DepositCalcError
-			cconds.fund, errCode = goTransaction2C(conds.Fund)
-			if errCode != C.kDepositCalcErrorSuccess {
-				return Data{}, errDepositCalcErrs[errCode]
-			}
-			cconds.wth, errCode = goTransaction2C(conds.Wth)
+			cconds, errCode := goConditions2C(conds)
+			defer freeCConditions(&cconds)
 			if errCode != C.kDepositCalcErrorSuccess {
 				return Data{}, errDepositCalcErrs[errCode]
 			}
@@ -166,34 +258,229 @@ func New(dl dll.Dll) (*Calc, error) {
 			if errCode != C.kDepositCalcErrorSuccess {
 				return Data{}, errDepositCalcErrs[errCode]
 			}
+			defer C.CallDepositDestroyDataFnPtr(DepositDestroyDataFnPtr, &cdata)
+			return cData2Go(&cdata), nil
+		},
+		CalculateBatch: func(conds []Conditions, flows bool) (Batch, error) {
+			if len(conds) == 0 {
+				return Batch{Data: []Data{}}, nil
+			}
+			cconds := make([]C.DepositConditions, len(conds))
 			defer func() {
-				C.VectorDelete(unsafe.Pointer(cconds.fund))
-				C.VectorDelete(unsafe.Pointer(cconds.wth))
-				C.CallDepositDestroyDataFnPtr(DepositDestroyDataFnPtr, &cdata)
+				for i := range cconds {
+					freeCConditions(&cconds[i])
+				}
 			}()
-			return Data{
-				Replen:   cPayout2Go(cdata.replen, C.VectorSize(unsafe.Pointer(cdata.replen))),
-				PayDates: cDatesArray2Go(unsafe.Pointer(cdata.pay_dates), C.VectorSize(unsafe.Pointer(cdata.pay_dates))),
-				Payment:  cconv.CDoubleArray2Go(unsafe.Pointer(cdata.payments), uint64(C.VectorSize(unsafe.Pointer(cdata.payments)))),
-				Tax:      cconv.CDoubleArray2Go(unsafe.Pointer(cdata.taxes), uint64(C.VectorSize(unsafe.Pointer(cdata.taxes)))),
-				StartDate: [3]int{
-					int(C.DateGetYear(&cdata.start_date)),
-					int(C.DateGetMonth(&cdata.start_date)),
-					int(C.DateGetDay(&cdata.start_date))},
-				FinishDate: [3]int{
-					int(C.DateGetYear(&cdata.finish_date)),
-					int(C.DateGetMonth(&cdata.finish_date)),
-					int(C.DateGetDay(&cdata.finish_date))},
-				EffRate: float64(cdata.eff_rate),
-				PercSum: float64(cdata.perc_sum),
-				TaxSum:  float64(cdata.tax_sum),
-				Total:   float64(cdata.total),
-			}, nil
+			for i, cond := range conds {
+				var errCode C.DepositCalcError
+				cconds[i], errCode = goConditions2C(cond)
+				if errCode != C.kDepositCalcErrorSuccess {
+					return Batch{}, errDepositCalcErrs[errCode]
+				}
+			}
+
+			var cbatch C.DepositBatch
+			errCode := C.CallDepositCalcBatchFnPtr(depositCalcBatchFnPtr, &cconds[0], C.size_t(len(cconds)), C.bool(flows), &cbatch)
+			if errCode != C.kDepositCalcErrorSuccess {
+				return Batch{}, errDepositCalcErrs[errCode]
+			}
+			defer C.CallDepositDestroyBatchFnPtr(depositDestroyBatchFnPtr, &cbatch)
+			batch := Batch{
+				Data:    make([]Data, len(conds)),
+				PercSum: float64(cbatch.perc_sum),
+				TaxSum:  float64(cbatch.tax_sum),
+				Total:   float64(cbatch.total),
+			}
+			for i, cdata := range unsafe.Slice(cbatch.data, cbatch.size) {
+				batch.Data[i] = cData2Go(&cdata)
+			}
+			if flows {
+				batch.Flows = cFlows2Go(cbatch.flows, cbatch.flows_size)
+			}
+			return batch, nil
+		},
+		CalculateSweep: func(base Conditions, sweep Sweep, schedules bool) ([]SweepResult, []Data, error) {
+			cbase, errCode := goConditions2C(base)
+			defer freeCConditions(&cbase)
+			if errCode != C.kDepositCalcErrorSuccess {
+				return nil, nil, errDepositCalcErrs[errCode]
+			}
+			// The sweep is read by C, so its arrays live in C memory.
+			csweep := C.DepositSweep{
+				intr_rates:      (*C.double)(goSlice2C(sweep.IntrRates, func(v float64) C.double { return C.double(v) })),
+				intr_rates_size: C.size_t(len(sweep.IntrRates)),
+				terms:           (*C.ushort)(goSlice2C(sweep.Terms, func(v int) C.ushort { return C.ushort(v) })),
+				terms_size:      C.size_t(len(sweep.Terms)),
+				pay_freqs:       (*C.DepositPayFreq)(goSlice2C(sweep.PayFreqs, func(v int) C.DepositPayFreq { return C.DepositPayFreq(v) })),
+				pay_freqs_size:  C.size_t(len(sweep.PayFreqs)),
+			}
+			defer freeCSweep(&csweep)
+			size := 1
+			if sweep.IntrRates != nil {
+				size *= len(sweep.IntrRates)
+			}
+			if sweep.Terms != nil {
+				size *= len(sweep.Terms)
+			}
+			if sweep.PayFreqs != nil {
+				size *= len(sweep.PayFreqs)
+			}
+			if size == 0 {
+				return []SweepResult{}, nil, nil
+			}
+
+			cres := make([]C.DepositSweepResult, size)
+			var cschedules []C.DepositData
+			var cschedulesPtr *C.DepositData
+			if schedules {
+				cschedules = make([]C.DepositData, size)
+				cschedulesPtr = &cschedules[0]
+			}
+			errCode = C.CallDepositCalcSweepFnPtr(depositCalcSweepFnPtr, &cbase, &csweep, &cres[0], cschedulesPtr)
+			if errCode != C.kDepositCalcErrorSuccess {
+				return nil, nil, errDepositCalcErrs[errCode]
+			}
+			res := make([]SweepResult, size)
+			for i, r := range cres {
+				res[i] = SweepResult{
+					PercSum: float64(r.perc_sum),
+					TaxSum:  float64(r.tax_sum),
+					Total:   float64(r.total),
+					EffRate: float64(r.eff_rate),
+				}
+			}
+			if !schedules {
+				return res, nil, nil
+			}
+			data := make([]Data, size)
+			for i := range cschedules {
+				data[i] = cData2Go(&cschedules[i])
+				C.CallDepositDestroyDataFnPtr(DepositDestroyDataFnPtr, &cschedules[i])
+			}
+			return res, data, nil
+		},
+		CalculateStream: func(conds Conditions, sink func(Row)) (Data, error) {
+			cconds, errCode := goConditions2C(conds)
+			defer freeCConditions(&cconds)
+			if errCode != C.kDepositCalcErrorSuccess {
+				return Data{}, errDepositCalcErrs[errCode]
+			}
+
+			handle := cgo.NewHandle(sink)
+			defer handle.Delete()
+			var cdata C.DepositData
+			errCode = C.CallDepositCalcStreamFnPtr(depositCalcStreamFnPtr, &cconds, C.uintptr_t(handle), &cdata)
+			if errCode != C.kDepositCalcErrorSuccess {
+				return Data{}, errDepositCalcErrs[errCode]
+			}
+			return cData2Go(&cdata), nil
 		},
 	}
 	return dc, nil
 }
 
+func goConditions2C(conds Conditions) (C.DepositConditions, C.DepositCalcError) {
+	cconds := C.DepositConditions{
+		term_type: C.DepositTermType(conds.TermType),
+		term:      C.ushort(conds.Term),
+		capt:      C.int(conds.Cap),
+		pay_freq:  C.DepositPayFreq(conds.PayFreq),
+
+		tax_rate:       C.double(conds.TaxRate),
+		key_rate:       C.double(conds.KeyRate),
+		sum:            C.double(conds.Sum),
+		intr_rate:      C.double(conds.IntrRate),
+		non_taking_rem: C.double(conds.NonTakingRem),
+
+		start_date: C.DateNew(
+			C.int(conds.StartDate[0]),
+			C.int(conds.StartDate[1]),
+			C.int(conds.StartDate[2])),
+	}
+	var errCode C.DepositCalcError
+	cconds.fund, errCode = goTransaction2C(conds.Fund)
+	if errCode != C.kDepositCalcErrorSuccess {
+		return cconds, errCode
+	}
+	cconds.wth, errCode = goTransaction2C(conds.Wth)
+	return cconds, errCode
+}
+
+func freeCConditions(cconds *C.DepositConditions) {
+	if cconds.fund != nil {
+		C.VectorDelete(unsafe.Pointer(cconds.fund))
+	}
+	if cconds.wth != nil {
+		C.VectorDelete(unsafe.Pointer(cconds.wth))
+	}
+}
+
+// goSlice2C copies values to C memory, a nil slice gives NULL.
+func goSlice2C[T, U any](values []T, conv func(T) U) unsafe.Pointer {
+	if values == nil {
+		return nil
+	}
+	// One spare element keeps the pointer valid for an empty slice.
+	cvalues := make([]U, len(values)+1)
+	for i, value := range values {
+		cvalues[i] = conv(value)
+	}
+	return C.CBytes(unsafe.Slice((*byte)(unsafe.Pointer(&cvalues[0])), len(cvalues)*int(unsafe.Sizeof(cvalues[0]))))
+}
+
+func freeCSweep(csweep *C.DepositSweep) {
+	C.free(unsafe.Pointer(csweep.intr_rates))
+	C.free(unsafe.Pointer(csweep.terms))
+	C.free(unsafe.Pointer(csweep.pay_freqs))
+}
+
+// cVectorSize is 0 for the NULL vectors of a streamed calculation.
+func cVectorSize(vec unsafe.Pointer) C.size_t {
+	if vec == nil {
+		return 0
+	}
+	return C.VectorSize(vec)
+}
+
+func cData2Go(cdata *C.DepositData) Data {
+	return Data{
+		Replen:   cPayout2Go(cdata.replen, cVectorSize(unsafe.Pointer(cdata.replen))),
+		PayDates: cDatesArray2Go(unsafe.Pointer(cdata.pay_dates), cVectorSize(unsafe.Pointer(cdata.pay_dates))),
+		Payment:  cconv.CDoubleArray2Go(unsafe.Pointer(cdata.payments), uint64(cVectorSize(unsafe.Pointer(cdata.payments)))),
+		Tax:      cconv.CDoubleArray2Go(unsafe.Pointer(cdata.taxes), uint64(cVectorSize(unsafe.Pointer(cdata.taxes)))),
+		StartDate: [3]int{
+			int(C.DateGetYear(&cdata.start_date)),
+			int(C.DateGetMonth(&cdata.start_date)),
+			int(C.DateGetDay(&cdata.start_date))},
+		FinishDate: [3]int{
+			int(C.DateGetYear(&cdata.finish_date)),
+			int(C.DateGetMonth(&cdata.finish_date)),
+			int(C.DateGetDay(&cdata.finish_date))},
+		EffRate: float64(cdata.eff_rate),
+		PercSum: float64(cdata.perc_sum),
+		TaxSum:  float64(cdata.tax_sum),
+		Total:   float64(cdata.total),
+	}
+}
+
+func cFlows2Go(cFlows *C.DepositFlow, len C.size_t) []Flow {
+	flows := unsafe.Slice(cFlows, len)
+	goFlows := make([]Flow, len)
+	for i := range flows {
+		goFlows[i] = Flow{
+			Date: [3]int{
+				int(C.DateGetYear(&flows[i].date)),
+				int(C.DateGetMonth(&flows[i].date)),
+				int(C.DateGetDay(&flows[i].date)),
+			},
+			Interest: float64(flows[i].interest),
+			Tax:      float64(flows[i].tax),
+			Replen:   float64(flows[i].replen),
+		}
+	}
+	return goFlows
+}
+
 func cDatesArray2Go(cDates unsafe.Pointer, len C.size_t) [][]int {
 	dates := unsafe.Slice((*C.Date)(cDates), len)
 	goArray2d := make([][]int, len)
@@ -0,0 +1,26 @@
+package depositcalc
+
+/*
+  #include <stdint.h>
+
+  #include "../cc/deposit_calc.h"
+*/
+import "C"
+import "runtime/cgo"
+
+// depositSinkGo gets the rows of DepositCalculateStream, a file with an
+// export can only declare in its preamble, so it lives apart.
+//
+//export depositSinkGo
+func depositSinkGo(handle C.uintptr_t, crow *C.DepositRow) {
+	sink := cgo.Handle(handle).Value().(func(Row))
+	sink(Row{
+		Type: int(crow._type),
+		Date: [3]int{
+			int(C.DateGetYear(&crow.date)),
+			int(C.DateGetMonth(&crow.date)),
+			int(C.DateGetDay(&crow.date)),
+		},
+		Sum: float64(crow.sum),
+	})
+}
@@ -0,0 +1,180 @@
+package calcstats
+
+/*
+  #include "../cc/calc_stats.h"
+
+  typedef typeof(&CalcStatsEnable) CalcStatsEnableFnPtr;
+  typedef typeof(&CalcStatsSnapshot) CalcStatsSnapshotFnPtr;
+  typedef typeof(&CalcStatsReset) CalcStatsResetFnPtr;
+
+  static inline void CallCalcStatsEnablePtr(CalcStatsEnableFnPtr fn_ptr, bool enabled) {
+	 fn_ptr(enabled);
+  }
+
+  static inline void CallCalcStatsSnapshotPtr(CalcStatsSnapshotFnPtr fn_ptr, CalcStats* stats) {
+	 fn_ptr(stats);
+  }
+
+  static inline void CallCalcStatsResetPtr(CalcStatsResetFnPtr fn_ptr) {
+	 fn_ptr();
+  }
+*/
+import "C"
+import (
+	"fmt"
+	"github.com/pancakeswya/GoSmartCalc/pkg/dll"
+	"io"
+	"strings"
+	"time"
+)
+
+type (
+	EnableFn   func(bool)
+	SnapshotFn func() Snapshot
+	ResetFn    func()
+)
+
+// Phase holds the counters of one kind of work done by the library.
+// Errors maps the error codes of the calculator behind the phase,
+// as returned by basiccalc.ErrorCode for instance, to their counts.
+// Iterations are cache hits for Calculate, tokens for Compile,
+// instructions for Eval, payments for Credit and days for Deposit.
+type Phase struct {
+	Calls      uint64
+	Errors     map[int]uint64
+	Time       time.Duration
+	Iterations uint64
+}
+
+// Snapshot is the sum of the counters of every thread of the library.
+type Snapshot struct {
+	Enabled    bool
+	Threads    int
+	Allocs     uint64
+	AllocBytes uint64
+	Calculate  Phase
+	Compile    Phase
+	Eval       Phase
+	Credit     Phase
+	Deposit    Phase
+}
+
+// Stats reads the counters of the library. They are off until
+// Enable(true) and Reset starts them over from zero.
+type Stats struct {
+	Enable   EnableFn
+	Snapshot SnapshotFn
+	Reset    ResetFn
+}
+
+const (
+	enableFuncName   = "CalcStatsEnable"
+	snapshotFuncName = "CalcStatsSnapshot"
+	resetFuncName    = "CalcStatsReset"
+)
+
+func newPhase(phase *C.CalcStatsPhase) Phase {
+	p := Phase{
+		Calls:      uint64(phase.calls),
+		Errors:     make(map[int]uint64),
+		Time:       time.Duration(phase.ns),
+		Iterations: uint64(phase.iterations),
+	}
+	for code, count := range phase.errors {
+		if count != 0 {
+			p.Errors[code] = uint64(count)
+		}
+	}
+	return p
+}
+
+func New(dl dll.Dll) (*Stats, error) {
+	ptr, err := dl.GetSymbolPtr(enableFuncName)
+	if err != nil {
+		return nil, err
+	}
+	enableFnPtr := C.CalcStatsEnableFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(snapshotFuncName)
+	if err != nil {
+		return nil, err
+	}
+	snapshotFnPtr := C.CalcStatsSnapshotFnPtr(ptr)
+
+	ptr, err = dl.GetSymbolPtr(resetFuncName)
+	if err != nil {
+		return nil, err
+	}
+	resetFnPtr := C.CalcStatsResetFnPtr(ptr)
+
+	return &Stats{
+		Enable: func(enabled bool) {
+			C.CallCalcStatsEnablePtr(enableFnPtr, C.bool(enabled))
+		},
+		Snapshot: func() Snapshot {
+			var stats C.CalcStats
+			C.CallCalcStatsSnapshotPtr(snapshotFnPtr, &stats)
+			return Snapshot{
+				Enabled:    bool(stats.enabled),
+				Threads:    int(stats.threads),
+				Allocs:     uint64(stats.allocs),
+				AllocBytes: uint64(stats.alloc_bytes),
+				Calculate:  newPhase(&stats.phases[C.kCalcStatsPhaseCalculate]),
+				Compile:    newPhase(&stats.phases[C.kCalcStatsPhaseCompile]),
+				Eval:       newPhase(&stats.phases[C.kCalcStatsPhaseEval]),
+				Credit:     newPhase(&stats.phases[C.kCalcStatsPhaseCredit]),
+				Deposit:    newPhase(&stats.phases[C.kCalcStatsPhaseDeposit]),
+			}
+		},
+		Reset: func() {
+			C.CallCalcStatsResetPtr(resetFnPtr)
+		},
+	}, nil
+}
+
+// WritePrometheus writes the snapshot in the Prometheus text format,
+// every metric name starting with prefix.
+func (s Snapshot) WritePrometheus(w io.Writer, prefix string) error {
+	phases := []struct {
+		name  string
+		phase *Phase
+	}{
+		{"calculate", &s.Calculate},
+		{"compile", &s.Compile},
+		{"eval", &s.Eval},
+		{"credit", &s.Credit},
+		{"deposit", &s.Deposit},
+	}
+	var b strings.Builder
+	metric := func(name, kind string) {
+		fmt.Fprintf(&b, "# TYPE %s_%s %s\n", prefix, name, kind)
+	}
+	metric("threads_total", "counter")
+	fmt.Fprintf(&b, "%s_threads_total %d\n", prefix, s.Threads)
+	metric("allocs_total", "counter")
+	fmt.Fprintf(&b, "%s_allocs_total %d\n", prefix, s.Allocs)
+	metric("alloc_bytes_total", "counter")
+	fmt.Fprintf(&b, "%s_alloc_bytes_total %d\n", prefix, s.AllocBytes)
+	metric("calls_total", "counter")
+	for _, p := range phases {
+		fmt.Fprintf(&b, "%s_calls_total{phase=%q} %d\n", prefix, p.name, p.phase.Calls)
+	}
+	metric("errors_total", "counter")
+	for _, p := range phases {
+		for code := 0; code < C.kCalcStatsErrorCodes; code++ {
+			if count, ok := p.phase.Errors[code]; ok {
+				fmt.Fprintf(&b, "%s_errors_total{phase=%q,code=\"%d\"} %d\n", prefix, p.name, code, count)
+			}
+		}
+	}
+	metric("seconds_total", "counter")
+	for _, p := range phases {
+		fmt.Fprintf(&b, "%s_seconds_total{phase=%q} %g\n", prefix, p.name, p.phase.Time.Seconds())
+	}
+	metric("iterations_total", "counter")
+	for _, p := range phases {
+		fmt.Fprintf(&b, "%s_iterations_total{phase=%q} %d\n", prefix, p.name, p.phase.Iterations)
+	}
+	_, err := io.WriteString(w, b.String())
+	return err
+}